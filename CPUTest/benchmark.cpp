@@ -0,0 +1,156 @@
+#include "cpu.h"
+#include "../RoughNES/tile_decoder.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace CPUTests
+{
+  //  Raw interpreter throughput. These are disabled so they stay out of the
+  //  regular test run; use --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+  struct CPUBenchmark : CPUTest
+  {
+    static const size_t Instructions = 20000000;
+
+    void run(const char* name, const std::vector<uint8_t>& program, bool jit = false)
+    {
+      cpu->load_rom(program);
+
+      if (jit && !cpu->enable_jit(true))
+      {
+        return;
+      }
+
+      cpu->step(Instructions / 100);  //  Warm up
+
+      auto start = std::chrono::steady_clock::now();
+      cpu->step(Instructions);
+      auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      auto ips = Instructions / elapsed;
+      std::cout << "[ BENCHMARK] " << name << ": " << static_cast<uint64_t>(ips) << " instructions/s" << std::endl;
+      RecordProperty("instructions_per_second", static_cast<int>(ips));
+    }
+  };
+
+  const std::vector<uint8_t> LoadStoreLoop = {
+    0xA2, 0x00,       //  LDX #$00
+    0xBD, 0x00, 0x03, //  LDA $0300,X
+    0x69, 0x01,       //  ADC #$01
+    0x9D, 0x00, 0x03, //  STA $0300,X
+    0xE8,             //  INX
+    0x8D, 0x00, 0x02, //  STA $0200
+    0xAE, 0x00, 0x02, //  LDX $0200
+    0xB8,             //  CLV
+    0x50, 0xEE };     //  BVC $EE
+
+  const std::vector<uint8_t> BranchLoop = {
+    0xA0, 0x10,     //  LDY #$10
+    0xA2, 0x00,     //  LDX #$00
+    0xCA,           //  DEX
+    0xD0, 0xFD,     //  BNE $FD
+    0x88,           //  DEY
+    0xD0, 0xF8,     //  BNE $F8
+    0xF0, 0xF4 };   //  BEQ $F4
+
+  const std::vector<uint8_t> ArithmeticLoop = {
+    0xA9, 0x40,     //  LDA #$40
+    0x38,           //  SEC
+    0xE9, 0x01,     //  SBC #$01
+    0x0A,           //  ASL A
+    0x6A,           //  ROR A
+    0x48,           //  PHA
+    0x68,           //  PLA
+    0xC9, 0x20,     //  CMP #$20
+    0x29, 0x7F,     //  AND #$7F
+    0x18,           //  CLC
+    0x90, 0xF0 };   //  BCC $F0
+
+  const std::vector<uint8_t> SpinLoop = {
+    0xAD, 0x00, 0x02, //  LDA $0200
+    0x10, 0xFB };     //  BPL $FB
+
+  TEST_F(CPUBenchmark, DISABLED_LoadStoreLoop)
+  {
+    run("LoadStoreLoop", LoadStoreLoop);
+  }
+
+  TEST_F(CPUBenchmark, DISABLED_BranchLoop)
+  {
+    run("BranchLoop", BranchLoop);
+  }
+
+  TEST_F(CPUBenchmark, DISABLED_ArithmeticLoop)
+  {
+    run("ArithmeticLoop", ArithmeticLoop);
+  }
+
+  TEST_F(CPUBenchmark, DISABLED_SpinLoop)
+  {
+    run("SpinLoop", SpinLoop);
+  }
+
+  TEST_F(CPUBenchmark, DISABLED_JitLoadStoreLoop)
+  {
+    run("JitLoadStoreLoop", LoadStoreLoop, true);
+  }
+
+  TEST_F(CPUBenchmark, DISABLED_JitBranchLoop)
+  {
+    run("JitBranchLoop", BranchLoop, true);
+  }
+
+  TEST_F(CPUBenchmark, DISABLED_JitArithmeticLoop)
+  {
+    run("JitArithmeticLoop", ArithmeticLoop, true);
+  }
+
+  //  A background scanline's worth of tiles decoded over and over, bit at a
+  //  time and with the vectorized decoder, from the same input.
+  struct TileBenchmark : testing::Test
+  {
+    static const size_t Tiles = 34;
+    static const size_t Scanlines = 2000000;
+
+    std::vector<uint8_t> low, high, palettes, pixels;
+
+    TileBenchmark() : low(Tiles), high(Tiles), palettes(Tiles), pixels(Tiles * 8)
+    {
+      for (size_t tile = 0; tile < Tiles; ++tile)
+      {
+        low[tile] = static_cast<uint8_t>(tile * 37 + 5);
+        high[tile] = static_cast<uint8_t>(tile * 91 + 3);
+        palettes[tile] = static_cast<uint8_t>((tile % 4) << 2);
+      }
+    }
+
+    template<typename Decoder>
+    void run(const char* name, Decoder decode)
+    {
+      uint32_t checksum = 0;
+      auto start = std::chrono::steady_clock::now();
+
+      for (size_t line = 0; line < Scanlines; ++line)
+      {
+        low[line % Tiles] ^= 1;
+        decode(low.data(), high.data(), palettes.data(), Tiles, pixels.data());
+        checksum += pixels[line % pixels.size()];
+      }
+
+      auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      auto lines = Scanlines / elapsed;
+      std::cout << "[ BENCHMARK] " << name << ": " << static_cast<uint64_t>(lines) << " scanlines/s (" << checksum << ")" << std::endl;
+      RecordProperty("scanlines_per_second", static_cast<int>(lines));
+    }
+  };
+
+  TEST_F(TileBenchmark, DISABLED_TileDecoderReference)
+  {
+    run("TileDecoderReference", &decode_tile_rows_reference);
+  }
+
+  TEST_F(TileBenchmark, DISABLED_TileDecoder)
+  {
+    run("TileDecoder", &decode_tile_rows);
+  }
+}
@@ -0,0 +1,83 @@
+#include "cpu.h"
+
+namespace CPUTests
+{
+  struct IORegisters
+  {
+    uint8_t last_write = 0;
+    uint16_t last_address = 0;
+    int reads = 0;
+  };
+
+  static uint8_t read_register(void* owner, uint16_t address)
+  {
+    ++static_cast<IORegisters*>(owner)->reads;
+    return static_cast<uint8_t>(address);
+  }
+
+  static void write_register(void* owner, uint8_t value, uint16_t address)
+  {
+    static_cast<IORegisters*>(owner)->last_write = value;
+    static_cast<IORegisters*>(owner)->last_address = address;
+  }
+
+  TEST(BusTest, BusMirrorsMemory)
+  {
+    Bus bus;
+    std::vector<uint8_t> ram(0x800);
+
+    for (uint16_t address = 0; address < 0x2000; address += 0x800)
+    {
+      bus.map(address, ram.size(), ram.data());
+    }
+
+    bus.write(0x42, 0x1801);
+    EXPECT_EQ(0x42, ram[1]);
+    EXPECT_EQ(0x42, bus.read(0x0001));
+    EXPECT_EQ(0x42, bus.read(0x0801));
+  }
+
+  TEST(BusTest, BusSendsRegisterPagesToHandlers)
+  {
+    Bus bus;
+    IORegisters registers;
+    std::vector<uint8_t> rom(0x100, 0xEA);
+
+    bus.map(0x4000, 0x100, Bus::Handler{ &read_register, &write_register, &registers });
+    bus.map(0x8000, 0x100, Bus::Handler{ &read_register, &write_register, &registers });
+    bus.map(0x8000, rom.size(), static_cast<const uint8_t*>(rom.data()));
+
+    EXPECT_EQ(0x16, bus.read(0x4016));
+    EXPECT_EQ(1, registers.reads);
+
+    //  ROM is read directly but writes still reach the handler.
+    EXPECT_EQ(0xEA, bus.read(0x8010));
+    bus.write(0x07, 0x8010);
+    EXPECT_EQ(1, registers.reads);
+    EXPECT_EQ(0x07, registers.last_write);
+    EXPECT_EQ(0x8010, registers.last_address);
+    EXPECT_EQ(0xEA, rom[0x10]);
+
+    bus.unmap(0x4000, 0x100);
+    EXPECT_EQ(0, bus.read(0x4016));
+    EXPECT_EQ(1, registers.reads);
+  }
+
+  TEST_F(CPUTest, CPUDropsCodeOnRemappedPages)
+  {
+    std::vector<uint8_t> inx = { 0xE8, 0xB8, 0x50, 0xFC };  //  INX, CLV, BVC $FC
+    std::vector<uint8_t> iny = { 0xC8, 0xB8, 0x50, 0xFC };  //  INY, CLV, BVC $FC
+    inx.resize(0x100);
+    iny.resize(0x100);
+
+    cpu->bus().map(0x0000, inx.size(), inx.data());
+    cpu->step(30);
+    EXPECT_EQ(10, cpu->get_registers().x);
+
+    //  Swapping a bank in under the PC must not keep running the old code.
+    cpu->bus().map(0x0000, iny.size(), static_cast<const uint8_t*>(iny.data()));
+    cpu->step(30);
+    EXPECT_EQ(10, cpu->get_registers().x);
+    EXPECT_EQ(10, cpu->get_registers().y);
+  }
+}
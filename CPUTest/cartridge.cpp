@@ -0,0 +1,411 @@
+#include "gtest/gtest.h"
+#include "../RoughNES/cartridge.h"
+#include "../RoughNES/crc32.h"
+#include "../RoughNES/header_fixups.h"
+#include "../RoughNES/nes.h"
+#include "../RoughNES/rom_library.h"
+#include "../RoughNES/rom_registry.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CPUTests
+{
+  //  One PRG bank and one CHR bank, each starting with its own marker.
+  static std::vector<uint8_t> make_image()
+  {
+    std::vector<uint8_t> image = { 'N', 'E', 'S', 0x1A, 1, 1 };
+    image.resize(NESHeader::Size + 0x4000 + 0x2000);
+    image[NESHeader::Size] = 0x11;
+    image[NESHeader::Size + 0x4000] = 0x22;
+    return image;
+  }
+
+  static void write_file(const char* filename, const std::vector<uint8_t>& data)
+  {
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+  }
+
+  static void expect_image(const Cartridge& cart)
+  {
+    ASSERT_EQ(0x4000, cart.prg_rom().size);
+    ASSERT_EQ(0x2000, cart.chr_rom().size);
+    EXPECT_EQ(0x11, cart.prg_rom().data[0]);
+    EXPECT_EQ(0x22, cart.chr_rom().data[0]);
+  }
+
+  TEST(CartridgeTest, CartridgeMapsROMFile)
+  {
+    const char* filename = "cartridge_test.nes";
+    auto image = make_image();
+    write_file(filename, image);
+
+    {
+      MappedFile file(filename);
+      EXPECT_TRUE(file.mapped());
+      EXPECT_EQ(image.size(), file.size());
+      EXPECT_TRUE(std::equal(std::begin(image), std::end(image), file.data()));
+
+      expect_image(Cartridge(filename));
+    }
+
+    std::remove(filename);
+  }
+
+#if !defined(_WIN32)
+  TEST(CartridgeTest, CartridgeReadsROMFromPipe)
+  {
+    const char* filename = "cartridge_test.fifo";
+    auto image = make_image();
+    std::remove(filename);
+    ASSERT_EQ(0, mkfifo(filename, 0600));
+
+    std::thread writer([&] { write_file(filename, image); });
+
+    {
+      MappedFile file(filename);
+      writer.join();
+
+      EXPECT_FALSE(file.mapped());
+      EXPECT_EQ(image.size(), file.size());
+      EXPECT_TRUE(std::equal(std::begin(image), std::end(image), file.data()));
+    }
+
+    std::remove(filename);
+  }
+#endif
+
+  TEST(CartridgeTest, CartridgeRejectsShortImage)
+  {
+    auto image = make_image();
+    image[4] = 2;
+
+    EXPECT_THROW(Cartridge{ image }, std::invalid_argument);
+    EXPECT_THROW(Cartridge{ std::vector<uint8_t>(4) }, std::invalid_argument);
+    expect_image(Cartridge(make_image()));
+  }
+
+  TEST(CartridgeTest, CartridgeLaysOutTrainerAndMiscROM)
+  {
+    auto image = make_image();
+    image[6] = 0x04;
+    image.insert(std::begin(image) + NESHeader::Size, NESHeader::TrainerSize, 0x77);
+    image.insert(std::end(image), 0x10, 0x33);
+
+    Cartridge cart(image);
+    expect_image(cart);
+    EXPECT_EQ(NESHeader::Size + 0x200, cart.layout().prg_offset);
+    ASSERT_EQ(0x200, cart.trainer().size);
+    EXPECT_EQ(0x77, cart.trainer().data[0x1FF]);
+    ASSERT_EQ(0x10, cart.misc_rom().size);
+    EXPECT_EQ(0x33, cart.misc_rom().data[0]);
+
+    //  The trainer goes into PRG RAM at $7000.
+    NES nes;
+    nes.load_cartridge(cart);
+    EXPECT_EQ(0x00, nes.cpu().read_byte(0x6FFF));
+    EXPECT_EQ(0x77, nes.cpu().read_byte(0x7000));
+    EXPECT_EQ(0x77, nes.cpu().read_byte(0x71FF));
+    EXPECT_EQ(0x00, nes.cpu().read_byte(0x7200));
+
+    //  Without its flag the trainer is taken for the start of PRG.
+    image[6] = 0;
+    EXPECT_EQ(0x77, Cartridge(image).prg_rom().data[0]);
+    EXPECT_EQ(0x210, Cartridge(image).misc_rom().size);
+  }
+
+  TEST(CartridgeTest, CRC32MatchesCheckValue)
+  {
+    std::string check = "123456789";
+    auto data = reinterpret_cast<const uint8_t*>(check.data());
+
+    EXPECT_EQ(0xCBF43926, crc32(data, check.size()));
+    EXPECT_EQ(0xCBF43926, crc32(data + 4, check.size() - 4, crc32(data, 4)));
+    EXPECT_EQ(0, crc32(data, 0));
+  }
+
+  TEST(CartridgeTest, CRC32MatchesBitwiseCRC)
+  {
+    auto reference = [](const uint8_t* data, size_t size)
+    {
+      uint32_t crc = ~0u;
+
+      for (size_t i = 0; i < size; ++i)
+      {
+        crc ^= data[i];
+
+        for (int bit = 0; bit < 8; ++bit)
+        {
+          crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+      }
+
+      return ~crc;
+    };
+
+    std::vector<uint8_t> data(0x1000);
+
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+      data[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+    }
+
+    //  Every length around the block sizes the folding loop works in, from
+    //  unaligned starts.
+    for (size_t offset = 0; offset < 4; ++offset)
+    {
+      for (size_t size = 0; size < 300; ++size)
+      {
+        ASSERT_EQ(reference(data.data() + offset, size), crc32(data.data() + offset, size)) << offset << " " << size;
+      }
+    }
+
+    EXPECT_EQ(reference(data.data(), data.size()), crc32(data.data(), data.size()));
+    EXPECT_EQ(reference(data.data(), data.size()), crc32(data.data() + 100, data.size() - 100, crc32(data.data(), 100)));
+  }
+
+  TEST(CartridgeTest, HeaderReadsINESDefaults)
+  {
+    const uint8_t ines[16] = { 'N', 'E', 'S', 0x1A, 2, 0, 0x13, 0x40, 0, 1 };
+    NESHeader header(ines);
+
+    EXPECT_FALSE(header.is_nes2());
+    EXPECT_EQ(0x41, header.mapper());
+    EXPECT_EQ(0x8000, header.prg_rom_size());
+    EXPECT_EQ(0, header.chr_rom_size());
+    EXPECT_EQ(0, header.prg_ram_size());
+    EXPECT_EQ(0x2000, header.prg_nvram_size());
+    EXPECT_EQ(0x2000, header.chr_ram_size());
+    EXPECT_TRUE(header.battery());
+    EXPECT_TRUE(header.vertical_mirroring());
+    EXPECT_TRUE(header.timing() == NESHeader::Timing::PAL);
+
+    //  Junk at the end of the header discards bytes 7-9.
+    const uint8_t signed_header[16] = { 'N', 'E', 'S', 0x1A, 2, 1, 0x10, 'D', 'i', 's', 'k', 'D', 'u', 'd', 'e', '!' };
+    NESHeader old(signed_header);
+
+    EXPECT_FALSE(old.is_nes2());
+    EXPECT_EQ(1, old.mapper());
+    EXPECT_EQ(0x2000, old.prg_ram_size());
+    EXPECT_TRUE(old.timing() == NESHeader::Timing::NTSC);
+  }
+
+  TEST(CartridgeTest, HeaderReadsNES2Fields)
+  {
+    const uint8_t nes2[16] = { 'N', 'E', 'S', 0x1A, 0x02, 0x07, 0x08, 0x18, 0x31, 0xF1, 0x70, 0x07, 0x03 };
+    NESHeader header(nes2);
+
+    EXPECT_TRUE(header.is_nes2());
+    EXPECT_EQ(0x110, header.mapper());
+    EXPECT_EQ(3, header.submapper());
+    EXPECT_EQ(0x102 * 0x4000, header.prg_rom_size());
+    EXPECT_EQ(0x102, header.prg_pages());
+    EXPECT_EQ(2 * 7, header.chr_rom_size());   //  Exponent 1, multiplier 3
+    EXPECT_EQ(0, header.prg_ram_size());
+    EXPECT_EQ(0x2000, header.prg_nvram_size());
+    EXPECT_EQ(0x2000, header.chr_ram_size());
+    EXPECT_EQ(0, header.chr_nvram_size());
+    EXPECT_TRUE(header.four_screen());
+    EXPECT_TRUE(header.timing() == NESHeader::Timing::Dendy);
+  }
+
+  TEST(CartridgeTest, CartridgeAppliesHeaderFixups)
+  {
+    //  Claims one bank of PRG and one of CHR, but the dump has two of PRG.
+    auto image = make_image();
+    image.insert(std::begin(image) + NESHeader::Size, 0x4000, 0x44);
+    EXPECT_EQ(0x44, Cartridge(image).prg_rom().data[0]);
+
+    HeaderFixups::Header fixed = { 'N', 'E', 'S', 0x1A, 2, 1, 0x00, 0x08 };
+    auto crc = Cartridge(image).crc();
+    HeaderFixups::add(crc, fixed);
+
+    {
+      Cartridge cart(image);
+      EXPECT_TRUE(cart.header().is_nes2());
+      EXPECT_EQ(0x8000, cart.prg_rom().size);
+      EXPECT_EQ(0x11, cart.prg_rom().data[0x4000]);
+      EXPECT_EQ(0x22, cart.chr_rom().data[0]);
+    }
+
+    //  The database is shared by the whole process, so leave it as found.
+    HeaderFixups::remove(crc);
+
+    Cartridge cart(image);
+    EXPECT_FALSE(cart.header().is_nes2());
+    EXPECT_EQ(0x44, cart.prg_rom().data[0]);
+  }
+
+  TEST(CartridgeTest, CartridgesShareROMImages)
+  {
+    auto shared = ROMRegistry::size();
+    auto image = make_image();
+    auto other = make_image();
+    other[NESHeader::Size + 1] = 0x33;
+
+    {
+      Cartridge first(image);
+      Cartridge second(image);
+      Cartridge third(other);
+
+      EXPECT_EQ(first.crc(), second.crc());
+      EXPECT_NE(first.crc(), third.crc());
+      EXPECT_EQ(first.prg_rom().data, second.prg_rom().data);
+      EXPECT_EQ(first.chr_rom().data, second.chr_rom().data);
+      EXPECT_NE(first.prg_rom().data, third.prg_rom().data);
+      EXPECT_EQ(shared + 2, ROMRegistry::size());
+    }
+
+    EXPECT_EQ(shared, ROMRegistry::size());
+  }
+
+  static std::vector<uint8_t> read_file(const char* filename)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  TEST(CartridgeTest, SaveFileKeepsContents)
+  {
+    const char* filename = "save_file_test.sav";
+
+    for (bool mapped : { true, false })
+    {
+      std::remove(filename);
+
+      {
+        SaveFile save(filename, 0x2000, mapped);
+        EXPECT_EQ(mapped, save.mapped());
+        EXPECT_EQ(0, save.data()[0x1FFF]);
+        save.data()[0x10] = 0x42;
+        save.data()[0x1FFF] = 0x43;
+        save.flush();
+      }
+
+      auto contents = read_file(filename);
+      ASSERT_EQ(0x2000, contents.size());
+      EXPECT_EQ(0x42, contents[0x10]);
+      EXPECT_EQ(0x43, contents[0x1FFF]);
+
+      SaveFile save(filename, 0x2000, mapped);
+      EXPECT_EQ(0x42, save.data()[0x10]);
+    }
+
+    std::remove(filename);
+    EXPECT_EQ("roms/game.sav", SaveFile::path_for("roms/game.nes"));
+    EXPECT_EQ("roms.d/game.sav", SaveFile::path_for("roms.d/game"));
+  }
+
+  TEST(CartridgeTest, NESMapsBatteryRAMToSaveFile)
+  {
+    const char* filename = "battery_test.nes";
+    const char* save_filename = "battery_test.sav";
+    auto image = make_image();
+    image[6] = 0x02;
+    image[NESHeader::Size + 0x3FFC] = 0x00;   //  Reset vector at $8000
+    image[NESHeader::Size + 0x3FFD] = 0x80;
+    write_file(filename, image);
+    std::remove(save_filename);
+
+    {
+      NES nes(filename);
+      nes.cpu().write_byte(0x5A, 0x6001);
+      EXPECT_EQ(0x5A, nes.cpu().read_byte(0x6001));
+    }
+
+    auto contents = read_file(save_filename);
+    ASSERT_EQ(0x2000, contents.size());
+    EXPECT_EQ(0x5A, contents[1]);
+
+    //  Comes back on the next run, and ROMs without a battery don't get a file.
+    {
+      NES nes(filename);
+      EXPECT_EQ(0x5A, nes.cpu().read_byte(0x6001));
+
+      nes.load_cartridge(Cartridge(make_image()));
+      EXPECT_EQ(0, nes.cpu().read_byte(0x6001));
+    }
+
+    std::remove(filename);
+    std::remove(save_filename);
+  }
+
+  static void make_directory(const std::string& path)
+  {
+#if defined(_WIN32)
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0700);
+#endif
+  }
+
+  static void remove_directory(const std::string& path)
+  {
+#if defined(_WIN32)
+    _rmdir(path.c_str());
+#else
+    rmdir(path.c_str());
+#endif
+  }
+
+  TEST(CartridgeTest, ROMLibraryIndexesDirectoryTree)
+  {
+    auto mmc1 = make_image();
+    mmc1[6] = 0x12;
+
+    make_directory("library_test");
+    make_directory("library_test/sub");
+    write_file("library_test/a.nes", make_image());
+    write_file("library_test/notes.txt", { 1, 2, 3 });
+    write_file("library_test/sub/b.NES", mmc1);
+    write_file("library_test/sub/c.nes", { 'N', 'E', 'S', 0x1A });
+
+    auto paths = ROMLibrary::find("library_test");
+    auto roms = ROMLibrary::scan(paths, 2);
+
+    ASSERT_EQ(3, roms.size());
+    EXPECT_EQ("library_test/a.nes", roms[0].path);
+    EXPECT_EQ("library_test/sub/b.NES", roms[1].path);
+    EXPECT_EQ("library_test/sub/c.nes", roms[2].path);
+
+    EXPECT_TRUE(roms[0].valid());
+    EXPECT_EQ(Cartridge(make_image()).crc(), roms[0].crc);
+    EXPECT_EQ(crc32(make_image().data() + NESHeader::Size, 0x4000), roms[0].prg_crc);
+    EXPECT_EQ(1, roms[1].mapper);
+    EXPECT_TRUE(roms[1].battery);
+    EXPECT_TRUE(roms[1].supported);
+    EXPECT_FALSE(roms[2].valid());
+
+    std::ostringstream index;
+    ROMLibrary::write_index(index, roms);
+
+    std::istringstream lines(index.str());
+    std::string line;
+    std::getline(lines, line);
+    EXPECT_EQ(26, line.find("\t0.0\tines\t16384\t8192\tS\tntsc\tlibrary_test/a.nes", 26)) << line;
+    std::getline(lines, line);
+    EXPECT_NE(std::string::npos, line.find("\t1.0\tines\t16384\t8192\tBS\tntsc\t")) << line;
+    std::getline(lines, line);
+    EXPECT_EQ(0, line.find("error\t")) << line;
+
+    for (auto file : { "a.nes", "notes.txt", "sub/b.NES", "sub/c.nes" })
+    {
+      std::remove((std::string("library_test/") + file).c_str());
+    }
+
+    remove_directory("library_test/sub");
+    remove_directory("library_test");
+  }
+}
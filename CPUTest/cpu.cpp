@@ -155,4 +155,160 @@ namespace CPUTests
     auto address = cpu->get_address(Instruction::AddressMode::ZeroPageY);
     ASSERT_EQ(0x03, address);
   }
+
+  TEST_F(CPUTest, CPUBlockCacheSeesSelfModifyingCode)
+  {
+    cpu->load_rom({ 0xA9, 0xE8,         //  LDA #$E8
+                    0x8D, 0x06, 0x00,   //  STA $0006
+                    0xEA,               //  NOP
+                    0xEA });            //  NOP, overwritten with INX
+    cpu->step(4);
+
+    EXPECT_EQ(1, cpu->get_registers().x);
+  }
+
+  TEST_F(CPUTest, CPUBlockCacheSeesExternalWrites)
+  {
+    cpu->load_rom({ 0xA2, 0x01 });      //  LDX #$01
+    cpu->step();
+
+    cpu->write_bytes({ 0xA0, 0x02 }, 0);  //  LDY #$02
+    auto regs = cpu->get_registers();
+    regs.pc = 0;
+    cpu->set_registers(regs);
+    cpu->step();
+
+    EXPECT_EQ(1, cpu->get_registers().x);
+    EXPECT_EQ(2, cpu->get_registers().y);
+  }
+
+  TEST_F(CPUTest, CPUBlockCacheMatchesInterpreter)
+  {
+    std::vector<uint8_t> program = {
+      0xA9, 0x40,         //  LDA #$40
+      0x38,               //  SEC
+      0xE9, 0x01,         //  SBC #$01
+      0x9D, 0x00, 0x03,   //  STA $0300,X
+      0xE8,               //  INX
+      0x48,               //  PHA
+      0x68,               //  PLA
+      0x6A,               //  ROR A
+      0x18,               //  CLC
+      0x90, 0xF1 };       //  BCC $F1
+
+    CPU interpreter;
+    interpreter.enable_block_cache(false);
+    interpreter.load_rom(program);
+    cpu->load_rom(program);
+
+    for (auto i = 0; i < 100; ++i)
+    {
+      ASSERT_EQ(interpreter.step(7), cpu->step(7));
+      ASSERT_EQ(interpreter.get_registers(), cpu->get_registers());
+    }
+
+    EXPECT_EQ(interpreter.read_bytes(0, CPU::MemorySize), cpu->read_bytes(0, CPU::MemorySize));
+  }
+
+  TEST_F(CPUTest, CPURunUntilStopsOnFirstInstructionPastTarget)
+  {
+    std::vector<uint8_t> program = {
+      0xA2, 0x00,         //  LDX #$00
+      0xBD, 0xC0, 0x02,   //  LDA $02C0,X
+      0xE8,               //  INX
+      0xEA,               //  NOP
+      0xB8,               //  CLV
+      0x50, 0xF8 };       //  BVC $F8
+
+    for (auto blocks : { true, false })
+    {
+      CPU reference;
+      reference.load_rom(program);
+      reference.enable_block_cache(false);
+      cpu = std::make_unique<CPU>();
+      cpu->load_rom(program);
+      cpu->enable_block_cache(blocks);
+
+      for (uint64_t target : { 1, 10, 250, 251, 1000, 5000 })
+      {
+        while (reference.cycles() < target)
+        {
+          reference.step();
+        }
+
+        cpu->run_until(target);
+        ASSERT_EQ(reference.cycles(), cpu->cycles());
+        ASSERT_EQ(reference.get_registers(), cpu->get_registers());
+      }
+    }
+  }
+
+  TEST_F(CPUTest, CPURunUntilChargesStalls)
+  {
+    cpu->load_rom({ 0xEA, 0xB8, 0x50, 0xFC });  //  NOP, CLV, BVC $FC
+
+    cpu->stall(513);
+    EXPECT_EQ(513, cpu->run_until(100));
+    EXPECT_EQ(0, cpu->get_registers().pc);
+
+    EXPECT_EQ(2, cpu->run_until(514));
+    EXPECT_EQ(1, cpu->get_registers().pc);
+  }
+
+  TEST_F(CPUTest, CPUSkipsIdleLoops)
+  {
+    std::vector<uint8_t> program = {
+      0xAD, 0x00, 0x02,   //  LDA $0200
+      0x10, 0xFB,         //  BPL $FB
+      0xE8,               //  INX
+      0xB8,               //  CLV
+      0x50, 0xF7 };       //  BVC $F7
+
+    CPU reference;
+    reference.load_rom(program);
+    reference.enable_block_cache(false);
+    cpu->load_rom(program);
+
+    for (uint64_t target : { 3, 100, 101, 102, 50000, 50001, 400000 })
+    {
+      while (reference.cycles() < target)
+      {
+        reference.step();
+      }
+
+      cpu->run_until(target);
+      ASSERT_EQ(reference.cycles(), cpu->cycles());
+      ASSERT_EQ(reference.get_registers(), cpu->get_registers());
+
+      //  Leave the loop once and spin again
+      auto flag = static_cast<uint8_t>(target % 2 ? 0x80 : 0x00);
+      reference.write_byte(flag, 0x0200);
+      cpu->write_byte(flag, 0x0200);
+    }
+
+    for (size_t times : { 1, 2, 5, 999, 100000 })
+    {
+      EXPECT_EQ(reference.step(times), cpu->step(times));
+      ASSERT_EQ(reference.get_registers(), cpu->get_registers());
+    }
+  }
+
+  TEST_F(CPUTest, CPUSkipsJumpToSelf)
+  {
+    //  JMP takes its target from the word at its operand.
+    cpu->load_rom({ 0xE8, 0x4C, 0x04, 0x00, 0x01, 0x00 });  //  INX, JMP $0004 -> $0001
+
+    cpu->run_until(100);
+    EXPECT_EQ(1, cpu->get_registers().x);
+    EXPECT_EQ(0x0001, cpu->get_registers().pc);
+
+    //  Far more passes than could be run one at a time, each three cycles
+    EXPECT_EQ(3000000000000ull, cpu->step(1000000000000ull));
+    EXPECT_EQ(0x0001, cpu->get_registers().pc);
+
+    auto cycles = cpu->cycles();
+    cpu->run_until(cycles + (1ull << 40));
+    EXPECT_LE(cycles + (1ull << 40), cpu->cycles());
+    EXPECT_GT(cycles + (1ull << 40) + 3, cpu->cycles());
+  }
 }
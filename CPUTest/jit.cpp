@@ -0,0 +1,363 @@
+#include "cpu.h"
+
+#include <cstring>
+#include <random>
+
+namespace CPUTests
+{
+  //  A register page that reads back the low address byte and logs writes.
+  static uint8_t read_io(void*, uint16_t address)
+  {
+    return static_cast<uint8_t>(address);
+  }
+
+  static void write_io(void* log, uint8_t value, uint16_t address)
+  {
+    static_cast<std::vector<uint32_t>*>(log)->push_back(address << 8 | value);
+  }
+
+  //  A register that raises an NMI when $80 is written and an IRQ on every
+  //  other multiple of 32.
+  static void write_interrupt(void* cpu, uint8_t value, uint16_t)
+  {
+    if (value == 0x80)
+    {
+      static_cast<CPU*>(cpu)->trigger_nmi();
+    }
+    else if ((value & 0x1F) == 0)
+    {
+      static_cast<CPU*>(cpu)->trigger_irq();
+    }
+  }
+
+  //  Runs the same program on the interpreter and on translated code and
+  //  expects identical state after every slice.
+  struct CPUJitTest : CPUTest
+  {
+    std::unique_ptr<CPU> jit;
+
+    CPUJitTest()
+    {
+      jit = std::make_unique<CPU>();
+    }
+
+    bool start(const std::vector<uint8_t>& program, uint32_t threshold = 0)
+    {
+      cpu->load_rom(program);
+      jit->load_rom(program);
+      return jit->enable_jit(true, threshold);
+    }
+
+    void expect_same(size_t times)
+    {
+      EXPECT_EQ(cpu->step(times), jit->step(times));
+      EXPECT_TRUE(cpu->get_registers() == jit->get_registers());
+    }
+
+    void expect_same_until(uint64_t cycles)
+    {
+      EXPECT_EQ(cpu->run_until(cpu->cycles() + cycles), jit->run_until(jit->cycles() + cycles));
+      EXPECT_TRUE(cpu->get_registers() == jit->get_registers());
+    }
+
+    void expect_same_memory()
+    {
+      EXPECT_TRUE(cpu->read_bytes(0, CPU::MemorySize) == jit->read_bytes(0, CPU::MemorySize));
+    }
+
+    void write_bytes(const std::vector<uint8_t>& data, uint16_t start)
+    {
+      for (size_t i = 0; i < data.size(); ++i)
+      {
+        cpu->bus().write(data[i], static_cast<uint16_t>(start + i));
+        jit->bus().write(data[i], static_cast<uint16_t>(start + i));
+      }
+    }
+
+    //  Points both vectors at handler. Interrupted instructions still run
+    //  after the vector is loaded, so the handler is padded with NOPs.
+    void set_handler(const std::vector<uint8_t>& handler, uint16_t start)
+    {
+      write_bytes({ static_cast<uint8_t>(start), static_cast<uint8_t>(start >> 8) }, 0xFFFA);
+      write_bytes({ static_cast<uint8_t>(start), static_cast<uint8_t>(start >> 8) }, 0xFFFE);
+      write_bytes(std::vector<uint8_t>(16, 0xEA), start - 12);
+      write_bytes(handler, start + 4);
+    }
+  };
+
+  TEST_F(CPUJitTest, CPUJitMatchesInterpreterOnLoops)
+  {
+    if (!start({
+      0xA0, 0x10,       //  LDY #$10
+      0xA2, 0x00,       //  LDX #$00
+      0xBD, 0x00, 0x03, //  LDA $0300,X
+      0x69, 0x01,       //  ADC #$01
+      0x9D, 0x00, 0x03, //  STA $0300,X
+      0xCA,             //  DEX
+      0xD0, 0xF5,       //  BNE $F5
+      0x88,             //  DEY
+      0xD0, 0xF0,       //  BNE $F0
+      0xF0, 0xEC }))    //  BEQ $EC
+    {
+      return;
+    }
+
+    for (size_t times : { 1, 3, 7, 100, 1000, 50000 })
+    {
+      expect_same(times);
+    }
+
+    for (uint64_t cycles : { 1, 5, 17, 400, 6000, 100000 })
+    {
+      expect_same_until(cycles);
+    }
+
+    expect_same_memory();
+  }
+
+  TEST_F(CPUJitTest, CPUJitSeesSelfModifyingCode)
+  {
+    if (!start({
+      0xA9, 0xE8,       //  LDA #$E8 (INX)
+      0x8D, 0x07, 0x00, //  STA $0007
+      0xA0, 0x00,       //  LDY #$00
+      0xEA,             //  NOP, replaced by INX on the first pass
+      0xC8,             //  INY
+      0xB8,             //  CLV
+      0x50, 0xF4 }))    //  BVC $F4
+    {
+      return;
+    }
+
+    for (size_t times : { 2, 5, 20, 200 })
+    {
+      expect_same(times);
+    }
+
+    expect_same_memory();
+  }
+
+  TEST_F(CPUJitTest, CPUJitLeavesIORegistersToInterpreter)
+  {
+    if (!start({
+      0xA2, 0x00,       //  LDX #$00
+      0xBD, 0xFE, 0x1F, //  LDA $1FFE,X
+      0x9D, 0x00, 0x20, //  STA $2000,X
+      0xE8,             //  INX
+      0xB8,             //  CLV
+      0x50, 0xF6 }))    //  BVC $F6
+    {
+      return;
+    }
+
+    std::vector<uint32_t> interpreted;
+    std::vector<uint32_t> translated;
+    cpu->bus().map(0x2000, Bus::PageSize, Bus::Handler{ &read_io, &write_io, &interpreted });
+    jit->bus().map(0x2000, Bus::PageSize, Bus::Handler{ &read_io, &write_io, &translated });
+
+    for (size_t times : { 4, 40, 400 })
+    {
+      expect_same(times);
+    }
+
+    EXPECT_FALSE(translated.empty());
+    EXPECT_TRUE(interpreted == translated);
+    expect_same_memory();
+  }
+
+  TEST_F(CPUJitTest, CPUJitCanInterpretSingleBlock)
+  {
+    std::vector<uint8_t> program = {
+      0xA2, 0x00,     //  LDX #$00
+      0xE8,           //  INX
+      0xD0, 0xFE };   //  BNE $FE
+
+    if (!start(program))
+    {
+      return;
+    }
+
+    jit->interpret_block(0x0002);
+
+    expect_same(600);
+  }
+
+  TEST_F(CPUJitTest, CPUJitTakesHeldIRQWhenInterruptsAreEnabled)
+  {
+    std::vector<std::vector<uint8_t>> programs = {
+      {
+        0x78,             //  SEI
+        0xA2, 0x00,       //  LDX #$00
+        0x58,             //  CLI
+        0xE8,             //  INX
+        0xB8,             //  CLV
+        0x50, 0xFC },     //  BVC $FC
+      {
+        0x78,             //  SEI
+        0xA9, 0x00,       //  LDA #$00
+        0x48,             //  PHA
+        0x28,             //  PLP
+        0xE8,             //  INX
+        0xB8,             //  CLV
+        0x50, 0xFC } };   //  BVC $FC
+
+    for (const auto& program : programs)
+    {
+      cpu = std::make_unique<CPU>();
+      jit = std::make_unique<CPU>();
+
+      if (!start(program))
+      {
+        return;
+      }
+
+      set_handler({
+        0xC8,             //  INY
+        0xB8,             //  CLV
+        0x50, 0xFC },     //  BVC $FC
+        0x0020);
+
+      expect_same(1);
+      cpu->trigger_irq();
+      jit->trigger_irq();
+
+      for (size_t times : { 1, 4, 4, 10, 100 })
+      {
+        expect_same(times);
+        EXPECT_EQ(cpu->cycles(), jit->cycles());
+      }
+
+      EXPECT_LE(0x14, jit->get_registers().pc);
+      expect_same_until(5000);
+      expect_same_memory();
+    }
+  }
+
+  TEST_F(CPUJitTest, CPUJitMatchesInterpreterOnInterrupts)
+  {
+    if (!start({
+      0xA2, 0x00,       //  LDX #$00
+      0xE8,             //  INX
+      0x8E, 0x00, 0x20, //  STX $2000
+      0xB8,             //  CLV
+      0x50, 0xF9 }))    //  BVC $F9
+    {
+      return;
+    }
+
+    //  Counts interrupts in Y and goes back to the loop with IRQs enabled.
+    set_handler({
+      0xC8,             //  INY
+      0x58,             //  CLI
+      0xB8,             //  CLV
+      0x50, 0xC9 },     //  BVC $C9
+      0x0030);
+
+    cpu->bus().map(0x2000, Bus::PageSize, Bus::Handler{ &read_io, &write_interrupt, cpu.get() });
+    jit->bus().map(0x2000, Bus::PageSize, Bus::Handler{ &read_io, &write_interrupt, jit.get() });
+
+    //  Interrupts raised by writes inside translated blocks, and NMIs and
+    //  IRQs raised between slices while the tight loop runs.
+    for (int slice = 0; slice < 200; ++slice)
+    {
+      if (slice % 7 == 3)
+      {
+        cpu->trigger_nmi();
+        jit->trigger_nmi();
+      }
+      else if (slice % 5 == 1)
+      {
+        cpu->trigger_irq();
+        jit->trigger_irq();
+      }
+
+      if (slice % 2)
+      {
+        expect_same(1 + slice % 37);
+      }
+      else
+      {
+        expect_same_until(1 + slice * 13 % 300);
+      }
+
+      EXPECT_EQ(cpu->cycles(), jit->cycles());
+    }
+
+    EXPECT_NE(0, jit->get_registers().y);
+    expect_same_memory();
+  }
+
+  TEST_F(CPUJitTest, CPUJitMatchesInterpreterOnRandomPrograms)
+  {
+    std::vector<uint8_t> opcodes;
+    const char* supported[] = {
+      "LDA", "LDX", "LDY", "STA", "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+      "INC", "INX", "INY", "DEC", "DEX", "DEY", "AND", "EOR", "ORA", "BIT", "ADC", "SBC",
+      "CMP", "CPX", "CPY", "ASL", "LSR", "ROL", "ROR", "CLC", "CLD", "CLI", "CLV", "SEC",
+      "SED", "SEI", "PHA", "PHP", "PLA", "PLP", "NOP", "BCC", "BCS", "BEQ", "BMI", "BNE",
+      "BPL", "BVC", "BVS" };
+
+    for (int i = 0; i < 256; ++i)
+    {
+      for (auto name : supported)
+      {
+        if (std::strcmp(name, Instruction::Names[i]) == 0 && Instruction::Table[i].size > 0)
+        {
+          opcodes.push_back(static_cast<uint8_t>(i));
+        }
+      }
+    }
+
+    std::mt19937 random(6502);
+
+    for (int program = 0; program < 40; ++program)
+    {
+      std::vector<uint8_t> memory(CPU::MemorySize);
+
+      for (size_t i = 0; i < memory.size();)
+      {
+        auto opcode = opcodes[random() % opcodes.size()];
+        memory[i++] = opcode;
+
+        for (int operand = 1; operand < Instruction::Table[opcode].size && i < memory.size(); ++operand)
+        {
+          memory[i++] = static_cast<uint8_t>(random());
+        }
+      }
+
+      if (!start(memory, program % 3))
+      {
+        return;
+      }
+
+      //  Random programs settle into short loops, so restart from a fresh
+      //  state every few slices to cover more of the code.
+      for (int restart = 0; restart < 100; ++restart)
+      {
+        Registers regs;
+        regs.a = static_cast<int8_t>(random());
+        regs.x = static_cast<int8_t>(random());
+        regs.y = static_cast<int8_t>(random());
+        regs.s = static_cast<uint8_t>(random());
+        regs.p = static_cast<uint8_t>(random());
+        regs.pc = static_cast<uint16_t>(random());
+        cpu->set_registers(regs);
+        jit->set_registers(regs);
+
+        for (int slice = 0; slice < 20; ++slice)
+        {
+          if (slice % 2)
+          {
+            expect_same(1 + random() % 64);
+          }
+          else
+          {
+            expect_same_until(1 + random() % 200);
+          }
+        }
+      }
+
+      expect_same_memory();
+    }
+  }
+}
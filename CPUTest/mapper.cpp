@@ -0,0 +1,213 @@
+#include "gtest/gtest.h"
+#include "../RoughNES/nes.h"
+
+#include <stdexcept>
+
+namespace CPUTests
+{
+  struct MapperTest : testing::Test
+  {
+    NES nes;
+
+    //  Every 8K PRG bank and 1K CHR bank starts with its own number. The
+    //  program goes in the last PRG bank at $F000, which all of the boards
+    //  map there at power on, and interrupts go to $0300.
+    void load(uint8_t mapper, uint8_t prg_pages, uint8_t chr_pages, const std::vector<uint8_t>& program = {})
+    {
+      std::vector<uint8_t> image = { 'N', 'E', 'S', 0x1A, prg_pages, chr_pages,
+        static_cast<uint8_t>(mapper << 4), static_cast<uint8_t>(mapper & 0xF0) };
+      image.resize(NESHeader::Size + prg_pages * 0x4000 + chr_pages * 0x2000);
+
+      auto prg = std::begin(image) + NESHeader::Size;
+      auto chr = prg + prg_pages * 0x4000;
+
+      for (int bank = 0; bank < prg_pages * 2; ++bank)
+      {
+        prg[bank * 0x2000] = static_cast<uint8_t>(bank);
+      }
+
+      for (int bank = 0; bank < chr_pages * 8; ++bank)
+      {
+        chr[bank * 0x400] = static_cast<uint8_t>(bank);
+      }
+
+      auto last = prg + prg_pages * 0x4000 - 0x2000;
+      std::copy(std::begin(program), std::end(program), last + 0x1000);
+
+      const uint8_t vectors[] = { 0x00, 0x03, 0x00, 0xF0, 0x00, 0x03 };
+      std::copy(std::begin(vectors), std::end(vectors), last + 0x1FFA);
+
+      nes.load_cartridge(Cartridge(image));
+    }
+
+    uint8_t read(uint16_t address)
+    {
+      return nes.cpu().read_byte(address);
+    }
+
+    void write(uint8_t value, uint16_t address)
+    {
+      nes.cpu().write_byte(value, address);
+    }
+
+    //  The first read after setting the address comes from the buffer.
+    uint8_t read_chr(uint16_t address)
+    {
+      write(address >> 8, 0x2006);
+      write(address & 0xFF, 0x2006);
+      read(0x2007);
+      return read(0x2007);
+    }
+  };
+
+  TEST_F(MapperTest, MapperRejectsUnknownBoards)
+  {
+    EXPECT_THROW(load(0x55, 1, 1), std::invalid_argument);
+  }
+
+  TEST_F(MapperTest, MapperUxROMSwitchesLowBank)
+  {
+    load(2, 4, 0);
+    EXPECT_EQ(0, read(0x8000));
+    EXPECT_EQ(6, read(0xC000));
+
+    write(2, 0x8000);
+    EXPECT_EQ(4, read(0x8000));
+    EXPECT_EQ(6, read(0xC000));
+  }
+
+  TEST_F(MapperTest, MapperCNROMSwitchesCHR)
+  {
+    load(3, 2, 4);
+    EXPECT_EQ(0, read_chr(0x0000));
+
+    write(1, 0x8000);
+    EXPECT_EQ(8, read_chr(0x0000));
+    EXPECT_EQ(2, read(0xC000));
+  }
+
+  TEST_F(MapperTest, MapperMMC1LoadsRegistersSerially)
+  {
+    auto load_register = [this](uint8_t value, uint16_t address)
+    {
+      for (int bit = 0; bit < 5; ++bit)
+      {
+        write((value >> bit) & 1, address);
+      }
+    };
+
+    load(1, 8, 2);
+    EXPECT_EQ(0, read(0x8000));
+    EXPECT_EQ(14, read(0xC000));
+
+    load_register(3, 0xE000);
+    EXPECT_EQ(6, read(0x8000));
+    EXPECT_EQ(14, read(0xC000));
+
+    //  Fixed first bank, switched $C000 and 4K CHR banks
+    load_register(0x18, 0x8000);
+    load_register(3, 0xA000);
+    load_register(1, 0xC000);
+    EXPECT_EQ(0, read(0x8000));
+    EXPECT_EQ(6, read(0xC000));
+    EXPECT_EQ(12, read_chr(0x0000));
+    EXPECT_EQ(4, read_chr(0x1000));
+
+    //  Resetting the shift register goes back to a fixed last bank.
+    write(1, 0x8000);
+    write(0x80, 0x8000);
+    EXPECT_EQ(6, read(0x8000));
+    EXPECT_EQ(14, read(0xC000));
+  }
+
+  TEST_F(MapperTest, MapperMMC3SwitchesBanks)
+  {
+    load(4, 4, 8);
+    EXPECT_EQ(0, read(0x8000));
+    EXPECT_EQ(1, read(0xA000));
+    EXPECT_EQ(6, read(0xC000));
+    EXPECT_EQ(7, read(0xE000));
+
+    write(6, 0x8000);
+    write(3, 0x8001);
+    EXPECT_EQ(3, read(0x8000));
+
+    write(0x46, 0x8000);
+    EXPECT_EQ(6, read(0x8000));
+    EXPECT_EQ(3, read(0xC000));
+
+    write(0x00, 0x8000);
+    write(9, 0x8001);
+    EXPECT_EQ(8, read_chr(0x0000));
+    EXPECT_EQ(9, read_chr(0x0400));
+
+    write(0x80, 0x8000);
+    EXPECT_EQ(8, read_chr(0x1000));
+  }
+
+  TEST_F(MapperTest, MapperMMC3RaisesScanlineIRQ)
+  {
+    load(4, 2, 1, {
+      0xA9, 0x0A,         //  LDA #$0A
+      0x8D, 0x00, 0xC0,   //  STA $C000
+      0x8D, 0x01, 0xC0,   //  STA $C001
+      0x8D, 0x01, 0xE0,   //  STA $E001
+      0xA9, 0x18,         //  LDA #$18
+      0x8D, 0x01, 0x20,   //  STA $2001
+      0x58,               //  CLI
+      0xB8,               //  CLV
+      0x50, 0xFC });      //  BVC $FC
+
+    //  The handler allows IRQs again and spins as well, so every IRQ moves
+    //  the stack pointer by two.
+    nes.cpu().write_bytes({ 0xB8, 0x58, 0xB8, 0x50, 0xFC }, 0x0300);  //  CLV, CLI, CLV, BVC $FC
+
+    //  The counter reloads on the pre-render line and reaches zero every
+    //  eleven scanline clocks after that, 241 clocks to a frame.
+    while (nes.cpu().get_registers().s == 0xFD)
+    {
+      nes.step();
+    }
+
+    EXPECT_EQ(9, nes.ppu().scanline());
+
+    nes.run_frame();
+    EXPECT_EQ(0xFD - 2 * 21, nes.cpu().get_registers().s);
+
+    nes.run_frame();
+    EXPECT_EQ(0xFD - 2 * 43, nes.cpu().get_registers().s);
+
+    //  Disabled, no more are raised.
+    write(0, 0xE000);
+    nes.run_frame();
+    EXPECT_EQ(0xFD - 2 * 43, nes.cpu().get_registers().s);
+  }
+
+  TEST_F(MapperTest, MapperMMC3IRQWaitsForInterruptFlag)
+  {
+    //  Interrupts stay disabled from reset until $10 is set.
+    load(4, 2, 1, {
+      0xA9, 0x0A,         //  LDA #$0A
+      0x8D, 0x00, 0xC0,   //  STA $C000
+      0x8D, 0x01, 0xC0,   //  STA $C001
+      0x8D, 0x01, 0xE0,   //  STA $E001
+      0xA9, 0x18,         //  LDA #$18
+      0x8D, 0x01, 0x20,   //  STA $2001
+      0xA5, 0x10,         //  LDA $10
+      0xF0, 0xFC,         //  BEQ $FC
+      0x58,               //  CLI
+      0xB8,               //  CLV
+      0x50, 0xFD });      //  BVC $FD
+
+    nes.cpu().write_bytes({ 0xB8, 0xB8, 0x50, 0xFD }, 0x0300);
+
+    nes.run_frame();
+    nes.run_frame();
+    EXPECT_EQ(0xFD, nes.cpu().get_registers().s);
+
+    //  The IRQ held off is taken on CLI, and the handler keeps I set.
+    write(1, 0x0010);
+    nes.run_frame();
+    EXPECT_EQ(0xFD - 2, nes.cpu().get_registers().s);
+  }
+}
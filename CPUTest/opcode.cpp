@@ -5,9 +5,17 @@ namespace Opcodes
 {
   TEST(OpcodeTest, OpcodeDataStoresCorrectly)
   {
-    EXPECT_EQ(0, Instruction::Table[0].opcode);
     EXPECT_EQ(1, Instruction::Table[0].size);
+    EXPECT_EQ(7, Instruction::Table[0].cycles);
     EXPECT_EQ(Instruction::AddressMode::Implied, Instruction::Table[0].mode);
-    EXPECT_EQ("BRK", Instruction::Table[0].name);
+    EXPECT_STREQ("BRK", Instruction::Names[0]);
   }
-}
\ No newline at end of file
+
+  TEST(OpcodeTest, OpcodeTableCoversEveryOpcode)
+  {
+    EXPECT_EQ(256, sizeof(Instruction::Table) / sizeof(Instruction::Table[0]));
+    EXPECT_EQ(256, sizeof(Instruction::Names) / sizeof(Instruction::Names[0]));
+    EXPECT_STREQ("ISC", Instruction::Names[0xFF]);
+    EXPECT_EQ(Instruction::AddressMode::AbsoluteX, Instruction::Table[0xFF].mode);
+  }
+}
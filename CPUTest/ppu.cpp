@@ -0,0 +1,369 @@
+#include "gtest/gtest.h"
+#include "../RoughNES/nes.h"
+#include "../RoughNES/tile_decoder.h"
+
+namespace CPUTests
+{
+  struct PPUTest : testing::Test
+  {
+    PPU ppu;
+
+    //  Tile 1 is colour 1 throughout and tile 2 colour 2. Nametable 0 is tile
+    //  1 and nametable 1 tile 2, side by side, and the top left 16x16 uses
+    //  palette 1.
+    PPUTest()
+    {
+      ppu.set_mirroring(PPU::Mirroring::Vertical);
+
+      set_address(0x0010);
+      write_repeated(0xFF, 8);
+      write_repeated(0x00, 8);
+      write_repeated(0x00, 8);
+      write_repeated(0xFF, 8);
+
+      set_address(0x2000);
+      write_repeated(1, 0x3C0);
+      write(0x01, 0x2007);
+      set_address(0x2400);
+      write_repeated(2, 0x3C0);
+
+      set_address(0x3F00);
+      for (uint8_t color : { 0x0F, 0x16, 0x2A, 0x00, 0x0F, 0x11 })
+      {
+        write(color, 0x2007);
+      }
+
+      //  Scroll to the top left and show the background everywhere.
+      write(0x00, 0x2000);
+      write(0x00, 0x2005);
+      write(0x00, 0x2005);
+      write(0x0A, 0x2001);
+    }
+
+    void write(uint8_t value, uint16_t address)
+    {
+      ppu.write_register(value, address);
+    }
+
+    void write_repeated(uint8_t value, size_t count)
+    {
+      for (size_t i = 0; i < count; ++i)
+      {
+        write(value, 0x2007);
+      }
+    }
+
+    void set_address(uint16_t address)
+    {
+      write(address >> 8, 0x2006);
+      write(address & 0xFF, 0x2006);
+    }
+
+    //  First CPU cycle at or after a dot of the first frame.
+    static uint64_t cycle_at(uint32_t line, uint32_t dot)
+    {
+      return (PPU::DotsPerScanline * (line + 1) + dot - 1 + 2) / PPU::DotsPerCycle;
+    }
+
+    uint8_t pixel(uint32_t x, uint32_t y) const
+    {
+      return ppu.frame_buffer()[y * PPU::ScreenWidth + x];
+    }
+
+    void write_sprite(uint8_t index, uint8_t y, uint8_t tile, uint8_t attributes, uint8_t x)
+    {
+      write(index * 4, 0x2003);
+
+      for (auto value : { y, tile, attributes, x })
+      {
+        write(value, 0x2004);
+      }
+    }
+
+    //  Every entry off screen, Y and tile both past the last line.
+    void clear_sprites()
+    {
+      write(0x00, 0x2003);
+
+      for (int i = 0; i < 0x100; ++i)
+      {
+        write(0xF0, 0x2004);
+      }
+    }
+
+    uint8_t status()
+    {
+      return ppu.read_register(0x2002) & 0x60;
+    }
+  };
+
+  TEST_F(PPUTest, PPURendersBackground)
+  {
+    ppu.catch_up(ppu.next_frame_end());
+
+    EXPECT_EQ(0x11, pixel(0, 0));
+    EXPECT_EQ(0x11, pixel(15, 15));
+    EXPECT_EQ(0x16, pixel(16, 0));
+    EXPECT_EQ(0x16, pixel(255, 239));
+
+    //  Clipping the left column leaves the backdrop there.
+    write(0x08, 0x2001);
+    ppu.catch_up(ppu.next_frame_end());
+
+    EXPECT_EQ(0x0F, pixel(7, 100));
+    EXPECT_EQ(0x16, pixel(8, 100));
+  }
+
+  TEST_F(PPUTest, PPUSplitsScanlineAtRegisterWrite)
+  {
+    auto cycle = cycle_at(100, 130);
+    auto split = (cycle * PPU::DotsPerCycle + 1) % PPU::DotsPerScanline - 1;
+
+    ppu.catch_up(cycle);
+    write(0x00, 0x2001);
+    ppu.catch_up(ppu.next_frame_end());
+
+    EXPECT_EQ(0x16, pixel(0, 99));
+    EXPECT_EQ(0x16, pixel(255, 99));
+    EXPECT_EQ(0x16, pixel(static_cast<uint32_t>(split - 1), 100));
+    EXPECT_EQ(0x0F, pixel(static_cast<uint32_t>(split), 100));
+    EXPECT_EQ(0x0F, pixel(0, 101));
+  }
+
+  TEST_F(PPUTest, PPUTakesNametableFromNextLine)
+  {
+    //  Only t changes mid-line. v picks up the new nametable at dot 257.
+    ppu.catch_up(cycle_at(100, 60));
+    write(0x01, 0x2000);
+    ppu.catch_up(ppu.next_frame_end());
+
+    EXPECT_EQ(0x16, pixel(60, 100));
+    EXPECT_EQ(0x16, pixel(255, 100));
+    EXPECT_EQ(0x2A, pixel(0, 101));
+    EXPECT_EQ(0x2A, pixel(255, 101));
+    EXPECT_EQ(0x2A, pixel(255, 239));
+  }
+
+  TEST_F(PPUTest, PPUCachesDecodedTiles)
+  {
+    //  Tile 1 fills nametable 0, and the last fetches of each line reach tile
+    //  2 in nametable 1.
+    ppu.catch_up(ppu.next_frame_end());
+    EXPECT_EQ(2, ppu.tile_decodes());
+    ppu.catch_up(ppu.next_frame_end());
+    EXPECT_EQ(2, ppu.tile_decodes());
+
+    //  Clearing the top row of tile 1 in CHR RAM drops it from the cache.
+    write(0x00, 0x2001);
+    set_address(0x0010);
+    write(0x00, 0x2007);
+    write(0x00, 0x2000);
+    write(0x00, 0x2005);
+    write(0x00, 0x2005);
+    write(0x0A, 0x2001);
+    ppu.catch_up(ppu.next_frame_end());
+
+    EXPECT_EQ(3, ppu.tile_decodes());
+    EXPECT_EQ(0x0F, pixel(16, 0));
+    EXPECT_EQ(0x16, pixel(16, 1));
+
+    //  Mapping the same banks again keeps the tiles, a different bank doesn't.
+    ppu.map_chr_ram();
+    ppu.catch_up(ppu.next_frame_end());
+    EXPECT_EQ(3, ppu.tile_decodes());
+
+    std::vector<uint8_t> rom(0x400);
+    std::fill(std::begin(rom) + 0x18, std::begin(rom) + 0x20, 0xFF);
+    ppu.map_chr(0x0000, rom.size(), rom.data());
+    ppu.catch_up(ppu.next_frame_end());
+
+    EXPECT_EQ(5, ppu.tile_decodes());
+    EXPECT_EQ(0x2A, pixel(16, 0));
+  }
+
+  TEST_F(PPUTest, PPUDrawsSpritesInPriorityOrder)
+  {
+    //  Tile 3 is opaque in its left column only.
+    set_address(0x0030);
+    write_repeated(0x80, 8);
+    write_repeated(0x00, 8);
+
+    set_address(0x3F11);
+    write(0x30, 0x2007);
+    set_address(0x3F15);
+    write(0x27, 0x2007);
+
+    clear_sprites();
+    write_sprite(0, 49, 1, 0x00, 100);
+    write_sprite(1, 49, 1, 0x01, 104);
+    write_sprite(2, 49, 1, 0x20, 150);
+    write_sprite(3, 49, 3, 0x40, 200);
+    write(0x00, 0x2000);
+    write(0x00, 0x2005);
+    write(0x00, 0x2005);
+    write(0x1E, 0x2001);
+    ppu.catch_up(ppu.next_frame_end());
+
+    //  Sprites show on the line after their Y.
+    EXPECT_EQ(0x16, pixel(100, 49));
+    EXPECT_EQ(0x30, pixel(100, 50));
+    EXPECT_EQ(0x30, pixel(107, 57));
+    EXPECT_EQ(0x16, pixel(100, 58));
+
+    //  Lower OAM indices win where sprites overlap.
+    EXPECT_EQ(0x30, pixel(104, 50));
+    EXPECT_EQ(0x27, pixel(108, 50));
+
+    //  Behind the opaque background, and flipped across.
+    EXPECT_EQ(0x16, pixel(150, 50));
+    EXPECT_EQ(0x16, pixel(200, 50));
+    EXPECT_EQ(0x30, pixel(207, 50));
+  }
+
+  TEST_F(PPUTest, PPUSetsSpriteOverflow)
+  {
+    //  Nine sprites on line 100: the ninth isn't drawn and overflow is set
+    //  during evaluation on line 99, after eight sprites have been copied.
+    clear_sprites();
+
+    for (uint8_t i = 0; i < 9; ++i)
+    {
+      write_sprite(i, 99, 1, 0x00, i * 10);
+    }
+
+    write(0x1E, 0x2001);
+
+    auto overflow = ppu.next_sprite_event();
+    EXPECT_EQ(cycle_at(99, 130), overflow);
+
+    ppu.catch_up(overflow - 1);
+    EXPECT_EQ(0x00, status() & 0x20);
+    ppu.catch_up(cycle_at(240, 0));
+    EXPECT_EQ(0x20, status() & 0x20);
+
+    EXPECT_NE(pixel(70, 100), pixel(80, 100));
+    EXPECT_EQ(pixel(80, 99), pixel(80, 100));
+  }
+
+  TEST_F(PPUTest, PPUReproducesSpriteOverflowBug)
+  {
+    //  Past eight sprites evaluation steps into the next byte of each entry
+    //  it misses, so the tile number of sprite 9 is taken as its Y...
+    clear_sprites();
+
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+      write_sprite(i, 99, 1, 0x00, i * 10);
+    }
+
+    write_sprite(9, 0xF0, 99, 0x00, 0);
+    write(0x1E, 0x2001);
+    ppu.catch_up(cycle_at(240, 0));
+    EXPECT_EQ(0x20, status() & 0x20);
+
+    //  ...and a ninth sprite that really is in range can be missed.
+    ppu.catch_up(ppu.next_frame_end());
+    write_sprite(9, 99, 1, 0x00, 0);
+    ppu.catch_up(ppu.next_frame_end() + cycle_at(240, 0));
+    EXPECT_EQ(0x00, status() & 0x20);
+  }
+
+  TEST_F(PPUTest, PPUSchedulesSpriteZeroHit)
+  {
+    //  A blank tile under the left half of sprite 0 on its first line
+    set_address(0x2000 + 6 * 32 + 12);
+    write(0x00, 0x2007);
+
+    clear_sprites();
+    write_sprite(0, 49, 1, 0x00, 100);
+    write(0x00, 0x2000);
+    write(0x00, 0x2005);
+    write(0x00, 0x2005);
+    write(0x1E, 0x2001);
+
+    //  Ahead of the line only sprite 0 is known, at x = 100. From the line
+    //  itself the background is read ahead and the hit is at x = 104, drawn
+    //  on dot 105.
+    EXPECT_EQ(cycle_at(50, 102), ppu.next_sprite_event());
+    ppu.catch_up(cycle_at(50, 102));
+    EXPECT_EQ(0x00, status());
+
+    auto hit = ppu.next_sprite_event();
+    EXPECT_EQ(cycle_at(50, 106), hit);
+    ppu.catch_up(hit - 1);
+    EXPECT_EQ(0x00, status());
+    ppu.catch_up(hit);
+    EXPECT_EQ(0x40, status());
+    EXPECT_EQ(uint64_t{ Scheduler::Never }, ppu.next_sprite_event());
+
+    //  Cleared with the other flags at the end of the frame.
+    ppu.catch_up(ppu.next_frame_end());
+    EXPECT_EQ(0x00, status());
+  }
+
+  TEST_F(PPUTest, PPUKeepsSpriteZeroHitWhenHeadless)
+  {
+    set_address(0x2000 + 6 * 32 + 12);
+    write(0x00, 0x2007);
+
+    clear_sprites();
+    write_sprite(0, 49, 1, 0x00, 100);
+    write(0x00, 0x2000);
+    write(0x00, 0x2005);
+    write(0x00, 0x2005);
+    write(0x1E, 0x2001);
+
+    //  Nothing is drawn, and the hit is still on the first opaque pixel of
+    //  the background under sprite 0.
+    ppu.set_headless(true);
+    EXPECT_TRUE(ppu.headless());
+
+    auto hit = cycle_at(50, 106);
+    ppu.catch_up(hit - 1);
+    EXPECT_EQ(0x00, status());
+    ppu.catch_up(hit);
+    EXPECT_EQ(0x40, status());
+
+    //  Switching back waits for the next frame.
+    ppu.set_headless(false);
+    ppu.catch_up(ppu.next_frame_end());
+    EXPECT_EQ(0x00, pixel(100, 50));
+    EXPECT_FALSE(ppu.headless());
+
+    ppu.catch_up(ppu.next_frame_end());
+    EXPECT_EQ(0x16, pixel(100, 40));
+  }
+
+  TEST(TileDecoderTest, TileDecoderMatchesReference)
+  {
+    std::vector<uint8_t> low(64);
+    std::vector<uint8_t> high(64);
+    std::vector<uint8_t> palettes(64);
+
+    for (size_t tile = 0; tile < low.size(); ++tile)
+    {
+      low[tile] = static_cast<uint8_t>(tile * 37 + 5);
+      high[tile] = static_cast<uint8_t>(tile * 91 + 3);
+      palettes[tile] = static_cast<uint8_t>((tile % 4) << 2);
+    }
+
+    low[0] = high[0] = 0;
+    palettes[0] = 12;
+
+    //  Counts that leave each vector width a remainder
+    for (size_t count = 0; count <= low.size(); ++count)
+    {
+      std::vector<uint8_t> expected(count * 8 + 1, 0xEE);
+      std::vector<uint8_t> pixels(count * 8 + 1, 0xEE);
+
+      decode_tile_rows_reference(low.data(), high.data(), palettes.data(), count, expected.data());
+      decode_tile_rows(low.data(), high.data(), palettes.data(), count, pixels.data());
+      ASSERT_EQ(expected, pixels) << count;
+    }
+
+    uint8_t pixels[8];
+    uint8_t low_row = 0xA5, high_row = 0x0F, palette = 8;
+    decode_tile_rows(&low_row, &high_row, &palette, 1, pixels);
+    EXPECT_EQ(std::vector<uint8_t>({ 9, 0, 9, 0, 10, 11, 10, 11 }), std::vector<uint8_t>(pixels, pixels + 8));
+  }
+}
@@ -166,4 +166,54 @@ namespace RegisterTests
     regs.set_overflow(0x01 + 0x7Fu, 0x01, 0x7Fu);
     EXPECT_EQ(true, regs.get_flag(Status::Overflow));
   }
-};
\ No newline at end of file
+
+  TEST_F(RegisterTest, LazyStatusRoundTripsEveryStatusByte)
+  {
+    LazyStatus status;
+    EXPECT_EQ(regs.p, status.pack());
+
+    for (int p = 0; p < 0x100; ++p)
+    {
+      status.load(static_cast<uint8_t>(p));
+      EXPECT_EQ(p, status.pack());
+    }
+  }
+
+  TEST_F(RegisterTest, LazyStatusMatchesRegisters)
+  {
+    LazyStatus status;
+
+    for (int value = 0; value < 0x100; ++value)
+    {
+      regs.set_zn(static_cast<int8_t>(value));
+      status.set_zn(static_cast<int8_t>(value));
+      EXPECT_EQ(regs.p, status.pack());
+
+      regs.set_nv(static_cast<int8_t>(value));
+      status.set_nv(static_cast<int8_t>(value));
+      EXPECT_EQ(regs.p, status.pack());
+
+      regs.set_overflow(static_cast<int8_t>(value), static_cast<int8_t>(value * 7), static_cast<uint8_t>(value * 13));
+      status.set_overflow(static_cast<int8_t>(value), static_cast<int8_t>(value * 7), static_cast<uint8_t>(value * 13));
+      EXPECT_EQ(regs.p, status.pack());
+    }
+  }
+
+  TEST_F(RegisterTest, LazyStatusCanSetEveryFlag)
+  {
+    LazyStatus status;
+
+    for (auto flag : { Carry, Zero, Interrupt, Decimal, Break, Unused, Overflow, Negative })
+    {
+      regs.set_flag(flag, true);
+      status.set_flag(flag, true);
+      EXPECT_EQ(true, status.get_flag(flag));
+      EXPECT_EQ(regs.p, status.pack());
+
+      regs.set_flag(flag, false);
+      status.set_flag(flag, false);
+      EXPECT_EQ(false, status.get_flag(flag));
+      EXPECT_EQ(regs.p, status.pack());
+    }
+  }
+};
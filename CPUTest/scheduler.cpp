@@ -0,0 +1,320 @@
+#include "cpu.h"
+#include "../RoughNES/nes.h"
+
+#include <type_traits>
+
+namespace CPUTests
+{
+  struct NESTest : testing::Test
+  {
+    NES nes;
+    NES stepped;
+
+    //  Runs the program from a single 16K bank at $8000, with NMIs going to
+    //  nmi_handler.
+    void load(const std::vector<uint8_t>& program, uint16_t nmi_handler = 0x8000)
+    {
+      std::vector<uint8_t> image = { 'N', 'E', 'S', 0x1A, 1, 0 };
+      image.resize(NESHeader::Size + 0x4000);
+      std::copy(std::begin(program), std::end(program), std::begin(image) + NESHeader::Size);
+
+      auto vectors = std::begin(image) + NESHeader::Size + 0x3FFA;
+      vectors[0] = nmi_handler & 0xFF;
+      vectors[1] = nmi_handler >> 8;
+      vectors[3] = 0x80;
+
+      nes.load_cartridge(Cartridge(image));
+      stepped.load_cartridge(Cartridge(image));
+    }
+
+    //  Brings the stepped console to the same frame one instruction at a time
+    //  and expects it to agree with the one run in slices.
+    void expect_same_as_stepped()
+    {
+      while (stepped.ppu().frame() < nes.ppu().frame())
+      {
+        stepped.step();
+      }
+
+      EXPECT_EQ(stepped.cpu().cycles(), nes.cpu().cycles());
+      EXPECT_EQ(stepped.cpu().get_registers(), nes.cpu().get_registers());
+    }
+  };
+
+  TEST(SchedulerTest, SchedulerPopsEventsInOrder)
+  {
+    Scheduler scheduler;
+    EXPECT_EQ(uint64_t{ Scheduler::Never }, scheduler.next());
+
+    scheduler.schedule(Scheduler::FrameEnd, 100);
+    scheduler.schedule(Scheduler::DMA, 50);
+    scheduler.schedule(Scheduler::VBlank, 50);
+    EXPECT_EQ(50, scheduler.next());
+
+    EXPECT_EQ(Scheduler::None, scheduler.pop(49));
+    EXPECT_EQ(Scheduler::VBlank, scheduler.pop(60));
+    EXPECT_EQ(Scheduler::DMA, scheduler.pop(60));
+    EXPECT_EQ(Scheduler::None, scheduler.pop(60));
+    EXPECT_EQ(100, scheduler.next());
+
+    scheduler.cancel(Scheduler::FrameEnd);
+    EXPECT_EQ(uint64_t{ Scheduler::Never }, scheduler.next());
+    EXPECT_EQ(Scheduler::None, scheduler.pop(1000));
+  }
+
+  TEST_F(NESTest, NESHoldsComponentsInline)
+  {
+    static_assert(!std::is_copy_constructible<NES>::value, "Components point back at their console");
+    static_assert(!std::is_move_constructible<NES>::value, "Components point back at their console");
+
+    auto begin = reinterpret_cast<uintptr_t>(&nes);
+    auto end = begin + sizeof(NES);
+
+    for (auto component : { reinterpret_cast<uintptr_t>(&nes.cpu()), reinterpret_cast<uintptr_t>(&nes.ppu()) })
+    {
+      EXPECT_LE(begin, component);
+      EXPECT_GT(end, component);
+    }
+  }
+
+  TEST_F(NESTest, NESMapsMemory)
+  {
+    load({ 0xEA });
+
+    auto& cpu = nes.cpu();
+    EXPECT_EQ(0x8000, cpu.get_registers().pc);
+    EXPECT_EQ(0xFD, cpu.get_registers().s);
+
+    //  2K of RAM mirrored up to $1FFF
+    cpu.write_byte(0x42, 0x1801);
+    EXPECT_EQ(0x42, cpu.read_byte(0x0001));
+
+    //  PRG RAM, then ROM that ignores writes and repeats its only bank
+    cpu.write_byte(0x24, 0x6000);
+    EXPECT_EQ(0x24, cpu.read_byte(0x6000));
+    cpu.write_byte(0x00, 0x8000);
+    EXPECT_EQ(0xEA, cpu.read_byte(0x8000));
+    EXPECT_EQ(0xEA, cpu.read_byte(0xC000));
+
+    //  PPU registers repeat every eight bytes
+    cpu.write_byte(0x3F, 0x2006);
+    cpu.write_byte(0x00, 0x3FFE);
+    cpu.write_byte(0x21, 0x2007);
+    cpu.write_byte(0x3F, 0x3006);
+    cpu.write_byte(0x00, 0x2006);
+    EXPECT_EQ(0x21, cpu.read_byte(0x2007));
+
+    //  No CHR ROM, so the pattern tables are RAM
+    cpu.write_byte(0x00, 0x2006);
+    cpu.write_byte(0x10, 0x2006);
+    cpu.write_byte(0x5A, 0x2007);
+    cpu.write_byte(0x00, 0x2006);
+    cpu.write_byte(0x10, 0x2006);
+    cpu.read_byte(0x2007);
+    EXPECT_EQ(0x5A, cpu.read_byte(0x2007));
+  }
+
+  TEST_F(NESTest, NESMapsCartridgeInPlace)
+  {
+    std::vector<uint8_t> image = { 'N', 'E', 'S', 0x1A, 2, 1 };
+    image.resize(NESHeader::Size + 2 * 0x4000 + 0x2000);
+    image[NESHeader::Size] = 0x11;
+    image[NESHeader::Size + 0x4000] = 0x22;
+    image[NESHeader::Size + 0x8000 + 0x10] = 0x33;
+    nes.load_cartridge(Cartridge(image));
+
+    //  The bus points straight at the cartridge's buffer.
+    auto prg = nes.cartridge().prg_rom();
+    auto& cpu = nes.cpu();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(prg.data), cpu.bus().read_pages()[0x80] + 0x8000);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(prg.data + 0x4000), cpu.bus().read_pages()[0xC0] + 0xC000);
+    EXPECT_EQ(0x11, cpu.read_byte(0x8000));
+    EXPECT_EQ(0x22, cpu.read_byte(0xC000));
+
+    //  CHR ROM ignores writes
+    cpu.write_byte(0x00, 0x2006);
+    cpu.write_byte(0x10, 0x2006);
+    cpu.write_byte(0x5A, 0x2007);
+    cpu.write_byte(0x00, 0x2006);
+    cpu.write_byte(0x10, 0x2006);
+    cpu.read_byte(0x2007);
+    EXPECT_EQ(0x33, cpu.read_byte(0x2007));
+  }
+
+  TEST_F(NESTest, NESRunsWholeFrames)
+  {
+    load({ 0xB8, 0x50, 0xFD });  //  CLV, BVC $FD
+
+    uint64_t total = 0;
+
+    for (uint64_t frame = 1; frame <= 4; ++frame)
+    {
+      total += nes.run_frame();
+      EXPECT_EQ(frame, nes.ppu().frame());
+      EXPECT_EQ(uint32_t{ PPU::PreRenderScanline }, nes.ppu().scanline());
+
+      //  262 scanlines of 341 dots, three dots to a CPU cycle
+      auto expected = frame * PPU::ScanlinesPerFrame * PPU::DotsPerScanline / PPU::DotsPerCycle;
+      EXPECT_LE(expected, total);
+      EXPECT_GT(expected + 8, total);
+    }
+
+    expect_same_as_stepped();
+  }
+
+  TEST_F(NESTest, NESWaitsForVBlank)
+  {
+    load({
+      0xAD, 0x02, 0x20,   //  LDA $2002
+      0x10, 0xFB,         //  BPL $FB
+      0xE8,               //  INX
+      0xB8,               //  CLV
+      0x50, 0xF7 });      //  BVC $F7
+
+    for (int frame = 0; frame < 3; ++frame)
+    {
+      nes.run_frame();
+    }
+
+    EXPECT_EQ(3, nes.cpu().get_registers().x);
+    expect_same_as_stepped();
+
+    nes.run_until(nes.cpu().cycles() + 10000);
+    EXPECT_EQ(3, nes.cpu().get_registers().x);
+  }
+
+  //  An opaque tile 0 fills the background, and sprite 0 sits on it at line
+  //  100. The program polls for the hit, then counts in X.
+  static const std::vector<uint8_t> SpriteZeroProgram = {
+    0xA9, 0x00,         //  LDA #$00
+    0x8D, 0x06, 0x20,   //  STA $2006
+    0x8D, 0x06, 0x20,   //  STA $2006
+    0xA9, 0xFF,         //  LDA #$FF
+    0xA2, 0x08,         //  LDX #$08
+    0x8D, 0x07, 0x20,   //  STA $2007
+    0xCA,               //  DEX
+    0xD0, 0xFA,         //  BNE $FA
+    0xA9, 0x63,         //  LDA #$63
+    0x8D, 0x04, 0x20,   //  STA $2004
+    0xA9, 0x03,         //  LDA #$03
+    0x8D, 0x03, 0x20,   //  STA $2003
+    0xA9, 0x80,         //  LDA #$80
+    0x8D, 0x04, 0x20,   //  STA $2004
+    0xA9, 0x1E,         //  LDA #$1E
+    0x8D, 0x01, 0x20,   //  STA $2001
+    0x2C, 0x02, 0x20,   //  BIT $2002
+    0x50, 0xFB,         //  BVC $FB
+    0xE8,               //  INX
+    0xB8,               //  CLV
+    0x50, 0xFC };       //  BVC $FC
+
+  TEST_F(NESTest, NESWaitsForSpriteZeroHit)
+  {
+    //  The polling loop is skipped ahead, so the hit has to be an event for
+    //  the count after it to come out the same.
+    load(SpriteZeroProgram);
+    nes.run_frame();
+    expect_same_as_stepped();
+  }
+
+  TEST_F(NESTest, NESRunsHeadlessFramesTheSame)
+  {
+    load(SpriteZeroProgram);
+    nes.ppu().set_headless(true);
+
+    for (int frame = 0; frame < 3; ++frame)
+    {
+      nes.run_frame();
+      expect_same_as_stepped();
+    }
+
+    EXPECT_EQ(std::vector<uint8_t>(PPU::ScreenWidth * PPU::ScreenHeight), nes.ppu().frame_buffer());
+  }
+
+  TEST_F(NESTest, NESSkipsFramesExactly)
+  {
+    load(SpriteZeroProgram);
+    nes.set_frame_skip(3);
+
+    for (uint64_t frame = 1; frame <= 7; ++frame)
+    {
+      nes.run_frame();
+      expect_same_as_stepped();
+      EXPECT_EQ(frame, nes.frames_emulated());
+    }
+
+    //  Frames 0, 3 and 6
+    EXPECT_EQ(3, nes.frames_rendered());
+    EXPECT_EQ(7, stepped.frames_rendered());
+
+    //  Frame 7 has started headless by now, so drawing resumes on frame 8.
+    nes.set_frame_skip(1);
+    nes.run_frame();
+    nes.run_frame();
+    EXPECT_EQ(4, nes.frames_rendered());
+  }
+
+  TEST_F(NESTest, NESRaisesNMIAtVBlank)
+  {
+    load({
+      0xA9, 0x80,         //  LDA #$80
+      0x8D, 0x00, 0x20,   //  STA $2000
+      0xB8,               //  CLV
+      0x50, 0xFD },       //  BVC $FD
+      0x0300);
+
+    //  The handler spins as well and never returns.
+    for (auto console : { &nes, &stepped })
+    {
+      console->cpu().write_bytes({ 0xB8, 0xB8, 0x50, 0xFD }, 0x0300);
+    }
+
+    for (int frame = 0; frame < 3; ++frame)
+    {
+      nes.run_frame();
+    }
+
+    //  Every NMI taken moves the stack pointer by two
+    EXPECT_EQ(0xF7, nes.cpu().get_registers().s);
+    expect_same_as_stepped();
+  }
+
+  TEST_F(NESTest, NESStallsForOAMDMA)
+  {
+    load({
+      0xA9, 0x02,         //  LDA #$02
+      0x8D, 0x14, 0x40,   //  STA $4014
+      0xEA });            //  NOP
+
+    nes.step();
+
+    //  The store can take a cycle more for the page it lands on.
+    auto cycles = nes.step();
+    EXPECT_LE(4 + 513, cycles);
+    EXPECT_GE(5 + 514, cycles);
+  }
+
+  TEST_F(NESTest, NESCopiesOAMBeforeCPUContinues)
+  {
+    //  The page changes straight after the transfer, which must not reach OAM.
+    load({
+      0xA9, 0x55,         //  LDA #$55
+      0x8D, 0x00, 0x02,   //  STA $0200
+      0xA9, 0x02,         //  LDA #$02
+      0x8D, 0x14, 0x40,   //  STA $4014
+      0xA9, 0x00,         //  LDA #$00
+      0x8D, 0x00, 0x02,   //  STA $0200
+      0xB8,               //  CLV
+      0x50, 0xFD });      //  BVC $FD
+
+    nes.run_frame();
+    expect_same_as_stepped();
+
+    for (auto console : { &nes, &stepped })
+    {
+      console->cpu().write_byte(0x00, 0x2003);
+      EXPECT_EQ(0x55, console->cpu().read_byte(0x2004));
+      EXPECT_EQ(0x00, console->cpu().read_byte(0x0200));
+    }
+  }
+}
@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../RoughNES/rom_library.h"
+
+//  Scans a ROM library and writes its index:
+//
+//    ROMScan <directory> [index] [-j threads]
+//
+//  The index goes to standard output without a filename. A summary goes to
+//  standard error either way.
+int main(int argc, char *argv[])
+{
+  std::string root;
+  std::string index;
+  unsigned threads = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string argument = argv[i];
+
+    if (argument == "-j" && i + 1 < argc)
+    {
+      threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+    }
+    else if (root.empty())
+    {
+      root = argument;
+    }
+    else if (index.empty())
+    {
+      index = argument;
+    }
+    else
+    {
+      root.clear();
+      break;
+    }
+  }
+
+  if (root.empty())
+  {
+    std::cerr << "Usage: ROMScan <directory> [index] [-j threads]" << std::endl;
+    return 2;
+  }
+
+  auto roms = ROMLibrary::scan(ROMLibrary::find(root), threads);
+
+  if (index.empty())
+  {
+    ROMLibrary::write_index(std::cout, roms);
+  }
+  else
+  {
+    std::ofstream out(index, std::ios::binary);
+    ROMLibrary::write_index(out, roms);
+
+    if (!out)
+    {
+      std::cerr << "Could not write " << index << std::endl;
+      return 1;
+    }
+  }
+
+  size_t invalid = 0;
+  size_t unsupported = 0;
+
+  for (const auto& rom : roms)
+  {
+    invalid += rom.valid() ? 0 : 1;
+    unsupported += rom.valid() && !rom.supported ? 1 : 0;
+  }
+
+  std::cerr << roms.size() << " ROMs, " << invalid << " invalid, " << unsupported << " with unsupported mappers" << std::endl;
+  return invalid ? 1 : 0;
+}
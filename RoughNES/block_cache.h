@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//  Predecoded basic blocks keyed by their entry address. Each block is
+//  registered with every 256 byte page it was decoded from, so a write only
+//  has to look at the blocks on the page it touched and drops the ones that
+//  cover the written byte. Pages that never held code cost a single flag test
+//  per write. Data is carried alongside each block for whoever executes it.
+struct NoBlockData
+{
+};
+
+template<typename Decoded, typename Data = NoBlockData>
+class BlockCache
+{
+public:
+  static const size_t PageSize = 0x100;
+  static const size_t PageCount = 0x100;
+
+  struct Block
+  {
+    uint16_t start;             //  Address of the first instruction
+    uint16_t end;               //  Address one past the last decoded byte
+    std::vector<Decoded> code;
+    Data data;
+  };
+
+  BlockCache();
+
+  inline Block* find(uint16_t pc) const;
+  Block& insert(uint16_t start, uint16_t end, std::vector<Decoded> code);
+
+  inline void invalidate(uint16_t address);
+  void invalidate_pages(uint8_t first, uint8_t last);
+  void clear();
+
+  //  Changes whenever a block is dropped, so a caller walking a block can
+  //  tell that it has to stop.
+  inline uint32_t generation() const { return m_generation; }
+
+private:
+  typedef std::array<std::unique_ptr<Block>, PageSize> Page;
+
+  std::array<std::unique_ptr<Page>, PageCount> m_lookup;
+  std::array<std::vector<uint16_t>, PageCount> m_page_blocks;
+  std::array<bool, PageCount> m_code_pages;
+  uint32_t m_generation;
+
+  void invalidate_page(uint16_t address);
+  void unregister(uint16_t start, uint16_t end, uint8_t skip_page);
+};
+
+template<typename Decoded, typename Data>
+BlockCache<Decoded, Data>::BlockCache() : m_generation(0)
+{
+  m_code_pages.fill(false);
+}
+
+template<typename Decoded, typename Data>
+typename BlockCache<Decoded, Data>::Block* BlockCache<Decoded, Data>::find(uint16_t pc) const
+{
+  auto& page = m_lookup[pc >> 8];
+  return page ? (*page)[pc & 0xFF].get() : nullptr;
+}
+
+template<typename Decoded, typename Data>
+typename BlockCache<Decoded, Data>::Block& BlockCache<Decoded, Data>::insert(uint16_t start, uint16_t end, std::vector<Decoded> code)
+{
+  auto& page = m_lookup[start >> 8];
+
+  if (!page)
+  {
+    page.reset(new Page());
+  }
+
+  auto& block = (*page)[start & 0xFF];
+  block.reset(new Block{ start, end, std::move(code), Data() });
+
+  //  Register with every page the block spans, wrapping at the top of memory.
+  uint8_t first = start >> 8;
+  uint8_t last = static_cast<uint16_t>(end - 1) >> 8;
+
+  for (uint8_t i = first;; ++i)
+  {
+    m_page_blocks[i].push_back(start);
+    m_code_pages[i] = true;
+
+    if (i == last)
+    {
+      break;
+    }
+  }
+
+  return *block;
+}
+
+template<typename Decoded, typename Data>
+void BlockCache<Decoded, Data>::invalidate(uint16_t address)
+{
+  if (m_code_pages[address >> 8])
+  {
+    invalidate_page(address);
+  }
+}
+
+template<typename Decoded, typename Data>
+void BlockCache<Decoded, Data>::invalidate_page(uint16_t address)
+{
+  auto& starts = m_page_blocks[address >> 8];
+  size_t kept = 0;
+  bool dropped = false;
+
+  for (auto start : starts)
+  {
+    auto& lookup = m_lookup[start >> 8];
+    auto block = lookup ? (*lookup)[start & 0xFF].get() : nullptr;
+
+    if (!block)
+    {
+      continue;
+    }
+
+    //  Offsets from the block start handle blocks that wrap past $FFFF.
+    if (static_cast<uint16_t>(address - start) < static_cast<uint16_t>(block->end - start))
+    {
+      unregister(start, block->end, address >> 8);
+      (*lookup)[start & 0xFF].reset();
+      dropped = true;
+    }
+    else
+    {
+      starts[kept++] = start;
+    }
+  }
+
+  starts.resize(kept);
+  m_code_pages[address >> 8] = kept > 0;
+
+  if (dropped)
+  {
+    ++m_generation;
+  }
+}
+
+//  Drops every block decoded from the given pages, e.g. when they are mapped
+//  to different memory.
+template<typename Decoded, typename Data>
+void BlockCache<Decoded, Data>::invalidate_pages(uint8_t first, uint8_t last)
+{
+  bool dropped = false;
+
+  for (uint8_t i = first;; ++i)
+  {
+    auto starts = std::move(m_page_blocks[i]);
+    m_page_blocks[i].clear();
+    m_code_pages[i] = false;
+
+    for (auto start : starts)
+    {
+      auto& lookup = m_lookup[start >> 8];
+
+      if (lookup && (*lookup)[start & 0xFF])
+      {
+        unregister(start, (*lookup)[start & 0xFF]->end, i);
+        (*lookup)[start & 0xFF].reset();
+        dropped = true;
+      }
+    }
+
+    if (i == last)
+    {
+      break;
+    }
+  }
+
+  if (dropped)
+  {
+    ++m_generation;
+  }
+}
+
+template<typename Decoded, typename Data>
+void BlockCache<Decoded, Data>::unregister(uint16_t start, uint16_t end, uint8_t skip_page)
+{
+  uint8_t first = start >> 8;
+  uint8_t last = static_cast<uint16_t>(end - 1) >> 8;
+
+  for (uint8_t i = first;; ++i)
+  {
+    if (i != skip_page)
+    {
+      auto& starts = m_page_blocks[i];
+      starts.erase(std::remove(std::begin(starts), std::end(starts), start), std::end(starts));
+      m_code_pages[i] = !starts.empty();
+    }
+
+    if (i == last)
+    {
+      break;
+    }
+  }
+}
+
+template<typename Decoded, typename Data>
+void BlockCache<Decoded, Data>::clear()
+{
+  for (auto& page : m_lookup)
+  {
+    page.reset();
+  }
+
+  for (auto& blocks : m_page_blocks)
+  {
+    blocks.clear();
+  }
+
+  m_code_pages.fill(false);
+  ++m_generation;
+}
@@ -0,0 +1,85 @@
+#include "bus.h"
+
+namespace
+{
+  //  Nothing drives the data bus on unmapped pages.
+  uint8_t read_open_bus(void*, uint16_t)
+  {
+    return 0;
+  }
+
+  void write_open_bus(void*, uint8_t, uint16_t)
+  {
+  }
+}
+
+Bus::Bus() : m_remap(nullptr), m_remap_owner(nullptr)
+{
+  m_read.fill(0);
+  m_write.fill(0);
+  m_handlers.fill(Handler{ &read_open_bus, &write_open_bus, nullptr });
+}
+
+void Bus::map(uint16_t address, size_t size, uint8_t* memory)
+{
+  map(address, size, static_cast<const uint8_t*>(memory));
+
+  for (size_t offset = 0; offset < size; offset += PageSize)
+  {
+    m_write[(address + offset) >> 8] = reinterpret_cast<uintptr_t>(memory + offset) - (address + offset);
+  }
+}
+
+void Bus::map(uint16_t address, size_t size, const uint8_t* memory)
+{
+  bool changed = false;
+
+  for (size_t offset = 0; offset < size; offset += PageSize)
+  {
+    auto page = (address + offset) >> 8;
+    auto entry = reinterpret_cast<uintptr_t>(memory + offset) - (address + offset);
+
+    changed = changed || m_read[page] != entry || m_write[page] != 0;
+    m_read[page] = entry;
+    m_write[page] = 0;
+  }
+
+  //  Mappers often write a bank register with the bank that is already in,
+  //  which shouldn't cost the code decoded from it.
+  if (changed)
+  {
+    remapped(address, size);
+  }
+}
+
+void Bus::map(uint16_t address, size_t size, const Handler& handler)
+{
+  for (size_t offset = 0; offset < size; offset += PageSize)
+  {
+    auto page = (address + offset) >> 8;
+    m_read[page] = 0;
+    m_write[page] = 0;
+    m_handlers[page] = handler;
+  }
+
+  remapped(address, size);
+}
+
+void Bus::unmap(uint16_t address, size_t size)
+{
+  map(address, size, Handler{ &read_open_bus, &write_open_bus, nullptr });
+}
+
+void Bus::on_remap(void* owner, RemapHandler handler)
+{
+  m_remap_owner = owner;
+  m_remap = handler;
+}
+
+void Bus::remapped(uint16_t address, size_t size) const
+{
+  if (m_remap && size > 0)
+  {
+    m_remap(m_remap_owner, address >> 8, static_cast<uint8_t>((address + size - 1) >> 8));
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//  CPU address space in 256 byte pages. A page is either backed by host memory
+//  and accessed with a single indexed load, or handed to a handler for
+//  registers and anything else with side effects. Pages can be readable memory
+//  and still send writes to a handler, as ROM with mapper registers does.
+//
+//  Memory pages are stored as the host address of the page minus the CPU
+//  address it is mapped at, so a lookup adds the full CPU address without
+//  masking. Zero marks a page that goes to its handler.
+class Bus
+{
+public:
+  static const size_t PageSize = 0x100;
+  static const size_t PageCount = 0x100;
+
+  typedef uint8_t(*ReadHandler)(void* owner, uint16_t address);
+  typedef void(*WriteHandler)(void* owner, uint8_t value, uint16_t address);
+  typedef void(*RemapHandler)(void* owner, uint8_t first_page, uint8_t last_page);
+
+  struct Handler
+  {
+    ReadHandler read;
+    WriteHandler write;
+    void* owner;
+  };
+
+  Bus();
+
+  Bus(const Bus&) = delete;
+  Bus& operator=(const Bus&) = delete;
+
+  //  Maps size bytes of host memory at address. Both must be page aligned.
+  //  Read-only memory leaves writes with whatever handler the pages have.
+  void map(uint16_t address, size_t size, uint8_t* memory);
+  void map(uint16_t address, size_t size, const uint8_t* memory);
+  void map(uint16_t address, size_t size, const Handler& handler);
+
+  //  Leaves pages to open bus, which reads as zero and ignores writes.
+  void unmap(uint16_t address, size_t size);
+
+  //  Told about every change to the page table, e.g. to drop decoded code.
+  void on_remap(void* owner, RemapHandler handler);
+
+  inline uint8_t read(uint16_t address) const;
+  inline void write(uint8_t value, uint16_t address) const;
+
+  //  Page tables for translated code, in the format described above.
+  inline const uintptr_t* read_pages() const { return m_read.data(); }
+  inline const uintptr_t* write_pages() const { return m_write.data(); }
+
+private:
+  std::array<uintptr_t, PageCount> m_read;
+  std::array<uintptr_t, PageCount> m_write;
+  std::array<Handler, PageCount> m_handlers;
+
+  RemapHandler m_remap;
+  void* m_remap_owner;
+
+  void remapped(uint16_t address, size_t size) const;
+};
+
+uint8_t Bus::read(uint16_t address) const
+{
+  auto page = m_read[address >> 8];
+
+  if (page)
+  {
+    return *reinterpret_cast<const uint8_t*>(page + address);
+  }
+
+  const auto& handler = m_handlers[address >> 8];
+  return handler.read(handler.owner, address);
+}
+
+void Bus::write(uint8_t value, uint16_t address) const
+{
+  auto page = m_write[address >> 8];
+
+  if (page)
+  {
+    *reinterpret_cast<uint8_t*>(page + address) = value;
+    return;
+  }
+
+  const auto& handler = m_handlers[address >> 8];
+  handler.write(handler.owner, value, address);
+}
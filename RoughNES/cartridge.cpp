@@ -1,43 +1,54 @@
 #include "cartridge.h"
+#include "crc32.h"
+#include "header_fixups.h"
+#include "rom_registry.h"
 
-#include <fstream>
-#include <iterator>
+#include <stdexcept>
 
-Cartridge::Cartridge(std::string filename)
+Cartridge::Cartridge(std::string filename) : m_filename(filename)
 {
-  std::ifstream ifs(filename, std::ios::binary);
+  load(std::make_shared<MappedFile>(filename));
+}
+
+Cartridge::Cartridge(std::vector<uint8_t> image)
+{
+  load(std::make_shared<MappedFile>(std::move(image)));
+}
 
-  if (!ifs.is_open())
+void Cartridge::load(std::shared_ptr<const MappedFile> image)
+{
+  if (image->size() < NESHeader::Size)
   {
-    throw std::invalid_argument("Could not open file");
+    throw std::invalid_argument("Not a valid NES ROM: File is too short.");
   }
-  
-  ifs.unsetf(std::ios::skipws);
-
-  ifs.seekg(0, std::ios::end);
-  auto filesize = static_cast<size_t>(ifs.tellg());
-  ifs.seekg(0, std::ios::beg);
-
-  std::vector<uint8_t> rom(filesize);
 
-  rom.insert(std::begin(rom),
-    std::istream_iterator<uint8_t>(ifs),
-    std::istream_iterator<uint8_t>());
+  //  The hash leaves the header out so a fixed header still finds its entry.
+  m_crc = crc32(image->data() + NESHeader::Size, image->size() - NESHeader::Size);
 
-  m_header = NESHeader(rom);
+  HeaderFixups::Header fixed;
+  m_header = HeaderFixups::find(m_crc, fixed) ? NESHeader(fixed.data()) : NESHeader(image->data());
 
-  auto prg_size = m_header.prg_pages() * PRGSize;
-  auto chr_size = m_header.chr_pages() * CHRSize;
-
-  m_prgrom.resize(prg_size);
-  m_chrrom.resize(chr_size);
+  m_layout = Layout::of(m_header, image->size());
+  m_image = ROMRegistry::share(std::move(image), m_crc);
+}
 
-  std::copy(std::begin(rom) + NESHeader::Size,
-    std::begin(rom) + NESHeader::Size + prg_size,
-    std::begin(m_prgrom));
+Cartridge::Layout Cartridge::Layout::of(const NESHeader& header, size_t file_size)
+{
+  Layout layout;
+  layout.trainer_offset = NESHeader::Size;
+  layout.trainer_size = header.trainer() ? NESHeader::TrainerSize : 0;
+  layout.prg_offset = layout.trainer_offset + layout.trainer_size;
+  layout.prg_size = header.prg_rom_size();
+  layout.chr_offset = layout.prg_offset + layout.prg_size;
+  layout.chr_size = header.chr_rom_size();
+  layout.misc_offset = layout.chr_offset + layout.chr_size;
+
+  //  Sizes come from the header, so check each one before adding it.
+  if (layout.prg_size > file_size || layout.chr_size > file_size || layout.misc_offset > file_size)
+  {
+    throw std::invalid_argument("Not a valid NES ROM: File is shorter than its header says.");
+  }
 
-  std::copy(std::begin(rom) + NESHeader::Size + prg_size,
-    std::begin(rom) + NESHeader::Size + prg_size + chr_size,
-    std::begin(m_chrrom));
+  layout.misc_size = file_size - layout.misc_offset;
+  return layout;
 }
-
@@ -1,21 +1,73 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "mapped_file.h"
 #include "nes_header.h"
 
+//  Keeps the ROM image in one buffer, mapped from the file where possible.
+//  Every region of it is handed out as a view, so mapping a bank anywhere never
+//  copies it. Copies of a cartridge, and every cartridge loaded from the same
+//  ROM, share the image through ROMRegistry. Headers of known bad dumps are
+//  replaced from HeaderFixups as the image is loaded.
 class Cartridge
 {
-  static const size_t PRGSize = 0x4000;
-  static const size_t CHRSize = 0x2000;
+public:
+  //  A read-only window onto the image. Bank numbers wrap around, which is
+  //  how boards with less ROM than the mapper can address behave.
+  struct View
+  {
+    const uint8_t* data;
+    size_t size;
+
+    inline const uint8_t* bank(size_t index, size_t bank_size) const
+    {
+      return size ? data + (index * bank_size) % size : nullptr;
+    }
+  };
+
+  //  Where each part of the file starts, in the order the format stores them:
+  //  header, optional 512 byte trainer, PRG, CHR, then anything else. Whatever
+  //  follows CHR is taken as misc ROM, as it holds the PlayChoice hint screen
+  //  and NES 2.0 misc ROMs.
+  struct Layout
+  {
+    size_t trainer_offset;
+    size_t trainer_size;
+    size_t prg_offset;
+    size_t prg_size;
+    size_t chr_offset;
+    size_t chr_size;
+    size_t misc_offset;
+    size_t misc_size;
 
-  std::vector<uint8_t> m_prgrom;
-  std::vector<uint8_t> m_chrrom;
-  std::vector<uint8_t> m_sram;
+    //  Throws if the file is shorter than the header says.
+    static Layout of(const NESHeader& header, size_t file_size);
+  };
+
+private:
+  std::shared_ptr<const MappedFile> m_image;
+  uint32_t m_crc;               //  Of everything after the header
+  Layout m_layout;
+  std::string m_filename;       //  Empty unless loaded from a file
 
   NESHeader m_header;
+
+  void load(std::shared_ptr<const MappedFile> image);
+  inline View view(size_t offset, size_t size) const { return View{ m_image ? m_image->data() + offset : nullptr, size }; }
 public:
+  Cartridge() : m_crc(0), m_layout{} {};
   explicit Cartridge(std::string filename);
+  explicit Cartridge(std::vector<uint8_t> image);
 
-  inline std::vector<uint8_t> prg_rom() const { return m_prgrom; }
-};
\ No newline at end of file
+  inline View trainer() const { return view(m_layout.trainer_offset, m_layout.trainer_size); }
+  inline View prg_rom() const { return view(m_layout.prg_offset, m_layout.prg_size); }
+  inline View chr_rom() const { return view(m_layout.chr_offset, m_layout.chr_size); }
+  inline View misc_rom() const { return view(m_layout.misc_offset, m_layout.misc_size); }
+  inline const Layout& layout() const { return m_layout; }
+  inline const NESHeader& header() const { return m_header; }
+  inline uint32_t crc() const { return m_crc; }
+  inline const std::string& filename() const { return m_filename; }
+};
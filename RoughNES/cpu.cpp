@@ -1,48 +1,224 @@
 #include "cpu.h"
+#include "nes.h"
 
-void(CPU::*CPU::FuncTable[])(const OpcodeInfo&) = {
-  &CPU::BRK, &CPU::ORA, &CPU::KIL, &CPU::SLO, &CPU::NOP, &CPU::ORA, &CPU::ASL, &CPU::SLO,
-  &CPU::PHP, &CPU::ORA, &CPU::ASL, &CPU::ANC, &CPU::NOP, &CPU::ORA, &CPU::ASL, &CPU::SLO,
-  &CPU::BPL, &CPU::ORA, &CPU::KIL, &CPU::SLO, &CPU::NOP, &CPU::ORA, &CPU::ASL, &CPU::SLO,
-  &CPU::CLC, &CPU::ORA, &CPU::NOP, &CPU::SLO, &CPU::NOP, &CPU::ORA, &CPU::ASL, &CPU::SLO,
-  &CPU::JSR, &CPU::AND, &CPU::KIL, &CPU::RLA, &CPU::BIT, &CPU::AND, &CPU::ROL, &CPU::RLA,
-  &CPU::PLP, &CPU::AND, &CPU::ROL, &CPU::ANC, &CPU::BIT, &CPU::AND, &CPU::ROL, &CPU::RLA,
-  &CPU::BMI, &CPU::AND, &CPU::KIL, &CPU::RLA, &CPU::NOP, &CPU::AND, &CPU::ROL, &CPU::RLA,
-  &CPU::SEC, &CPU::AND, &CPU::NOP, &CPU::RLA, &CPU::NOP, &CPU::AND, &CPU::ROL, &CPU::RLA,
-  &CPU::RTI, &CPU::EOR, &CPU::KIL, &CPU::SRE, &CPU::NOP, &CPU::EOR, &CPU::LSR, &CPU::SRE,
-  &CPU::PHA, &CPU::EOR, &CPU::LSR, &CPU::ALR, &CPU::JMP, &CPU::EOR, &CPU::LSR, &CPU::SRE,
-  &CPU::BVC, &CPU::EOR, &CPU::KIL, &CPU::SRE, &CPU::NOP, &CPU::EOR, &CPU::LSR, &CPU::SRE,
-  &CPU::CLI, &CPU::EOR, &CPU::NOP, &CPU::SRE, &CPU::NOP, &CPU::EOR, &CPU::LSR, &CPU::SRE,
-  &CPU::RTS, &CPU::ADC, &CPU::KIL, &CPU::RRA, &CPU::NOP, &CPU::ADC, &CPU::ROR, &CPU::RRA,
-  &CPU::PLA, &CPU::ADC, &CPU::ROR, &CPU::ARR, &CPU::JMP, &CPU::ADC, &CPU::ROR, &CPU::RRA,
-  &CPU::BVS, &CPU::ADC, &CPU::KIL, &CPU::RRA, &CPU::NOP, &CPU::ADC, &CPU::ROR, &CPU::RRA,
-  &CPU::SEI, &CPU::ADC, &CPU::NOP, &CPU::RRA, &CPU::NOP, &CPU::ADC, &CPU::ROR, &CPU::RRA,
-  &CPU::NOP, &CPU::STA, &CPU::NOP, &CPU::SAX, &CPU::STY, &CPU::STA, &CPU::STX, &CPU::SAX,
-  &CPU::DEY, &CPU::NOP, &CPU::TXA, &CPU::XAA, &CPU::STY, &CPU::STA, &CPU::STX, &CPU::SAX,
-  &CPU::BCC, &CPU::STA, &CPU::KIL, &CPU::AHX, &CPU::STY, &CPU::STA, &CPU::STX, &CPU::SAX,
-  &CPU::TYA, &CPU::STA, &CPU::TXS, &CPU::TAS, &CPU::SHY, &CPU::STA, &CPU::SHX, &CPU::AHX,
-  &CPU::LDY, &CPU::LDA, &CPU::LDX, &CPU::LAX, &CPU::LDY, &CPU::LDA, &CPU::LDX, &CPU::LAX,
-  &CPU::TAY, &CPU::LDA, &CPU::TAX, &CPU::LAX, &CPU::LDY, &CPU::LDA, &CPU::LDX, &CPU::LAX,
-  &CPU::BCS, &CPU::LDA, &CPU::KIL, &CPU::LAX, &CPU::LDY, &CPU::LDA, &CPU::LDX, &CPU::LAX,
-  &CPU::CLV, &CPU::LDA, &CPU::TSX, &CPU::LAS, &CPU::LDY, &CPU::LDA, &CPU::LDX, &CPU::LAX,
-  &CPU::CPY, &CPU::CMP, &CPU::NOP, &CPU::DCP, &CPU::CPY, &CPU::CMP, &CPU::DEC, &CPU::DCP,
-  &CPU::INY, &CPU::CMP, &CPU::DEX, &CPU::AXS, &CPU::CPY, &CPU::CMP, &CPU::DEC, &CPU::DCP,
-  &CPU::BNE, &CPU::CMP, &CPU::KIL, &CPU::DCP, &CPU::NOP, &CPU::CMP, &CPU::DEC, &CPU::DCP,
-  &CPU::CLD, &CPU::CMP, &CPU::NOP, &CPU::DCP, &CPU::NOP, &CPU::CMP, &CPU::DEC, &CPU::DCP,
-  &CPU::CPX, &CPU::SBC, &CPU::NOP, &CPU::ISC, &CPU::CPX, &CPU::SBC, &CPU::INC, &CPU::ISC,
-  &CPU::INX, &CPU::SBC, &CPU::NOP, &CPU::SBC, &CPU::CPX, &CPU::SBC, &CPU::INC, &CPU::ISC,
-  &CPU::BEQ, &CPU::SBC, &CPU::KIL, &CPU::ISC, &CPU::NOP, &CPU::SBC, &CPU::INC, &CPU::ISC,
-  &CPU::SED, &CPU::SBC, &CPU::NOP, &CPU::ISC, &CPU::NOP, &CPU::SBC, &CPU::INC, &CPU::ISC,
-};
+#include <limits>
+
+//  Opcode to handler mapping. Shared by FuncTable and the threaded core so the
+//  two cannot drift apart.
+#define CPU_OPCODES(X) \
+  X(00, BRK) X(01, ORA) X(02, KIL) X(03, SLO) X(04, NOP) X(05, ORA) X(06, ASL) X(07, SLO) \
+  X(08, PHP) X(09, ORA) X(0A, ASL) X(0B, ANC) X(0C, NOP) X(0D, ORA) X(0E, ASL) X(0F, SLO) \
+  X(10, BPL) X(11, ORA) X(12, KIL) X(13, SLO) X(14, NOP) X(15, ORA) X(16, ASL) X(17, SLO) \
+  X(18, CLC) X(19, ORA) X(1A, NOP) X(1B, SLO) X(1C, NOP) X(1D, ORA) X(1E, ASL) X(1F, SLO) \
+  X(20, JSR) X(21, AND) X(22, KIL) X(23, RLA) X(24, BIT) X(25, AND) X(26, ROL) X(27, RLA) \
+  X(28, PLP) X(29, AND) X(2A, ROL) X(2B, ANC) X(2C, BIT) X(2D, AND) X(2E, ROL) X(2F, RLA) \
+  X(30, BMI) X(31, AND) X(32, KIL) X(33, RLA) X(34, NOP) X(35, AND) X(36, ROL) X(37, RLA) \
+  X(38, SEC) X(39, AND) X(3A, NOP) X(3B, RLA) X(3C, NOP) X(3D, AND) X(3E, ROL) X(3F, RLA) \
+  X(40, RTI) X(41, EOR) X(42, KIL) X(43, SRE) X(44, NOP) X(45, EOR) X(46, LSR) X(47, SRE) \
+  X(48, PHA) X(49, EOR) X(4A, LSR) X(4B, ALR) X(4C, JMP) X(4D, EOR) X(4E, LSR) X(4F, SRE) \
+  X(50, BVC) X(51, EOR) X(52, KIL) X(53, SRE) X(54, NOP) X(55, EOR) X(56, LSR) X(57, SRE) \
+  X(58, CLI) X(59, EOR) X(5A, NOP) X(5B, SRE) X(5C, NOP) X(5D, EOR) X(5E, LSR) X(5F, SRE) \
+  X(60, RTS) X(61, ADC) X(62, KIL) X(63, RRA) X(64, NOP) X(65, ADC) X(66, ROR) X(67, RRA) \
+  X(68, PLA) X(69, ADC) X(6A, ROR) X(6B, ARR) X(6C, JMP) X(6D, ADC) X(6E, ROR) X(6F, RRA) \
+  X(70, BVS) X(71, ADC) X(72, KIL) X(73, RRA) X(74, NOP) X(75, ADC) X(76, ROR) X(77, RRA) \
+  X(78, SEI) X(79, ADC) X(7A, NOP) X(7B, RRA) X(7C, NOP) X(7D, ADC) X(7E, ROR) X(7F, RRA) \
+  X(80, NOP) X(81, STA) X(82, NOP) X(83, SAX) X(84, STY) X(85, STA) X(86, STX) X(87, SAX) \
+  X(88, DEY) X(89, NOP) X(8A, TXA) X(8B, XAA) X(8C, STY) X(8D, STA) X(8E, STX) X(8F, SAX) \
+  X(90, BCC) X(91, STA) X(92, KIL) X(93, AHX) X(94, STY) X(95, STA) X(96, STX) X(97, SAX) \
+  X(98, TYA) X(99, STA) X(9A, TXS) X(9B, TAS) X(9C, SHY) X(9D, STA) X(9E, SHX) X(9F, AHX) \
+  X(A0, LDY) X(A1, LDA) X(A2, LDX) X(A3, LAX) X(A4, LDY) X(A5, LDA) X(A6, LDX) X(A7, LAX) \
+  X(A8, TAY) X(A9, LDA) X(AA, TAX) X(AB, LAX) X(AC, LDY) X(AD, LDA) X(AE, LDX) X(AF, LAX) \
+  X(B0, BCS) X(B1, LDA) X(B2, KIL) X(B3, LAX) X(B4, LDY) X(B5, LDA) X(B6, LDX) X(B7, LAX) \
+  X(B8, CLV) X(B9, LDA) X(BA, TSX) X(BB, LAS) X(BC, LDY) X(BD, LDA) X(BE, LDX) X(BF, LAX) \
+  X(C0, CPY) X(C1, CMP) X(C2, NOP) X(C3, DCP) X(C4, CPY) X(C5, CMP) X(C6, DEC) X(C7, DCP) \
+  X(C8, INY) X(C9, CMP) X(CA, DEX) X(CB, AXS) X(CC, CPY) X(CD, CMP) X(CE, DEC) X(CF, DCP) \
+  X(D0, BNE) X(D1, CMP) X(D2, KIL) X(D3, DCP) X(D4, NOP) X(D5, CMP) X(D6, DEC) X(D7, DCP) \
+  X(D8, CLD) X(D9, CMP) X(DA, NOP) X(DB, DCP) X(DC, NOP) X(DD, CMP) X(DE, DEC) X(DF, DCP) \
+  X(E0, CPX) X(E1, SBC) X(E2, NOP) X(E3, ISC) X(E4, CPX) X(E5, SBC) X(E6, INC) X(E7, ISC) \
+  X(E8, INX) X(E9, SBC) X(EA, NOP) X(EB, SBC) X(EC, CPX) X(ED, SBC) X(EE, INC) X(EF, ISC) \
+  X(F0, BEQ) X(F1, SBC) X(F2, KIL) X(F3, ISC) X(F4, NOP) X(F5, SBC) X(F6, INC) X(F7, ISC) \
+  X(F8, SED) X(F9, SBC) X(FA, NOP) X(FB, ISC) X(FC, NOP) X(FD, SBC) X(FE, INC) X(FF, ISC)
 
 bool CPU::pages_differ(uint16_t a, uint16_t b)
 {
   return (a & 0xFF00) != (b & 0xFF00);
 }
 
-CPU::CPU() : m_cycles(0), m_stall(0)
+template<Instruction::AddressMode Mode>
+uint16_t CPU::operand() const
+{
+  return Instruction::operand_bytes(Mode) == 2 ? read_word(m_reg.pc + 1)
+    : Instruction::operand_bytes(Mode) == 1 ? read_byte(m_reg.pc + 1)
+    : 0;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::Absolute>(uint16_t operand) const
+{
+  return operand;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::AbsoluteX>(uint16_t operand) const
+{
+  return operand + m_reg.x;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::AbsoluteY>(uint16_t operand) const
+{
+  return operand + m_reg.y;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::Accumulator>(uint16_t /*operand*/) const
+{
+  return 0;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::Immediate>(uint16_t /*operand*/) const
+{
+  return m_reg.pc + 1;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::Implied>(uint16_t /*operand*/) const
+{
+  return 0;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::Indirect>(uint16_t operand) const
+{
+  return read_word(operand);
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::IndirectX>(uint16_t operand) const
+{
+  return read_word(operand + m_reg.x);
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::IndirectY>(uint16_t operand) const
+{
+  return read_word(operand) + m_reg.y;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::Relative>(uint16_t operand) const
+{
+  return static_cast<int8_t>(operand) + m_reg.pc;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::ZeroPage>(uint16_t operand) const
+{
+  return operand;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::ZeroPageX>(uint16_t operand) const
+{
+  return operand + m_reg.x;
+}
+
+template<>
+uint16_t CPU::address<Instruction::AddressMode::ZeroPageY>(uint16_t operand) const
+{
+  return operand + m_reg.y;
+}
+
+template<uint8_t Opcode, void(CPU::*Handler)(const CPU::OpcodeInfo&)>
+void CPU::execute()
+{
+  execute<Opcode, Handler>(operand<Instruction::Table[Opcode].mode>());
+}
+
+template<uint8_t Opcode, void(CPU::*Handler)(const CPU::OpcodeInfo&)>
+void CPU::execute(uint16_t operand)
+{
+  constexpr auto info = Instruction::Table[Opcode];
+
+  auto address = this->address<info.mode>(operand);
+  OpcodeInfo opinfo = { address, m_reg.pc, info.size };
+
+  if (m_interrupt != Interrupt::None)
+  {
+    interrupt(m_interrupt);
+    m_interrupt = Interrupt::None;
+  }
+  else if (m_irq && !m_status.get_flag(Status::Interrupt))
+  {
+    interrupt(Interrupt::IRQ);
+    m_irq = false;
+  }
+
+  (this->*Handler)(opinfo);
+
+  m_reg.pc += info.size;
+  m_cycles += info.cycles + pages_differ(m_reg.pc, address);
+}
+
+#define CPU_HANDLER(op, name) &CPU::name<Instruction::Table[0x##op].mode>
+#define CPU_FUNC_ENTRY(op, name) &CPU::execute<0x##op, CPU_HANDLER(op, name)>,
+
+void(CPU::*const CPU::FuncTable[])() = {
+  CPU_OPCODES(CPU_FUNC_ENTRY)
+};
+
+#undef CPU_FUNC_ENTRY
+
+bool CPU::ends_block(uint8_t opcode)
+{
+  const auto& info = Instruction::Table[opcode];
+
+  switch (opcode)
+  {
+  case 0x00:  //  BRK
+  case 0x20:  //  JSR
+  case 0x40:  //  RTI
+  case 0x4C:  //  JMP
+  case 0x60:  //  RTS
+  case 0x6C:  //  JMP
+    return true;
+  default:
+    //  Branches, and unimplemented opcodes that never advance pc
+    return info.mode == Instruction::AddressMode::Relative || info.size == 0;
+  }
+}
+
+bool CPU::writes_memory(uint8_t opcode)
 {
-  m_sysmem.resize(MemorySize + 1);
+  switch (opcode)
+  {
+  case 0x81: case 0x85: case 0x8D: case 0x91: case 0x95: case 0x99: case 0x9D:  //  STA
+  case 0x86: case 0x8E: case 0x96:                                              //  STX
+  case 0x84: case 0x8C: case 0x94:                                              //  STY
+  case 0xC6: case 0xCE: case 0xD6: case 0xDE:                                   //  DEC
+  case 0xE6: case 0xEE: case 0xF6: case 0xFE:                                   //  INC
+  case 0x06: case 0x0E: case 0x16: case 0x1E:                                   //  ASL
+  case 0x46: case 0x4E: case 0x56: case 0x5E:                                   //  LSR
+  case 0x26: case 0x2E: case 0x36: case 0x3E:                                   //  ROL
+  case 0x66: case 0x6E: case 0x76: case 0x7E:                                   //  ROR
+  case 0x00: case 0x08: case 0x20: case 0x48:                                   //  BRK, PHP, JSR, PHA
+    return true;
+  default:
+    return false;
+  }
+}
+
+CPU::CPU() : m_console(nullptr), m_cycles(0), m_interrupt(Interrupt::None), m_irq(false), m_stall(0), m_stop(false), m_use_blocks(true),
+  m_use_jit(false), m_jit_threshold(DefaultJitThreshold), m_jit_excluded(MemorySize)
+{
+  m_sysmem.resize(MemorySize);
+  m_bus.map(0, MemorySize, m_sysmem.data());
+  m_bus.on_remap(this, &CPU::bus_remapped);
+
+  JIT::prepare(m_jit_context);
+  m_jit_context.owner = this;
+  m_jit_context.write = &CPU::jit_write;
 };
 
 CPU::CPU(const std::vector<uint8_t>& rom) : CPU()
@@ -52,59 +228,456 @@ CPU::CPU(const std::vector<uint8_t>& rom) : CPU()
 
 CPU::CPU(Cartridge& cart) : CPU()
 {
-  load_rom(cart.prg_rom());
+  auto prg = cart.prg_rom();
+  load_rom(std::vector<uint8_t>(prg.data, prg.data + prg.size));
 }
 
-CPU::CPU(std::shared_ptr<NES> console) : CPU()
+CPU::CPU(NES& console) : CPU()
 {
-  m_console = console;
+  //  The console maps all of its own memory, so the flat 64K isn't needed.
+  m_console = &console;
+  m_bus.unmap(0, MemorySize);
+  std::vector<uint8_t>().swap(m_sysmem);
 }
 
 bool CPU::load_rom(const std::vector<uint8_t>& rom)
 {
   if (rom.size() <= MemorySize)
   {
-    std::copy(std::begin(rom), std::end(rom), std::begin(m_sysmem));
+    for (size_t i = 0; i < rom.size(); ++i)
+    {
+      m_bus.write(rom[i], static_cast<uint16_t>(i));
+    }
+
+    m_blocks.clear();
     return true;
   }
   return false;
 }
 
+void CPU::reset()
+{
+  m_reg.s -= 3;
+  m_reg.pc = read_word(ResetVectorAddress);
+  m_status.set_flag(Status::Interrupt, true);
+  m_interrupt = Interrupt::None;
+  m_irq = false;
+}
+
+#if defined(ROUGHNES_THREADED_CORE)
 uint64_t CPU::step(size_t times)
 {
   auto start_cycles = m_cycles;
+  begin_run();
 
-  while (times-- > 0)
+  if (m_use_blocks)
   {
-    auto opcode = read_byte(m_reg.pc);
-    auto info = Instruction::Table[opcode];
-    auto address = get_address(info.mode);
-    OpcodeInfo opinfo = { address, m_reg.pc, info.mode, info.size };
+    run_blocks(times, NoDeadline);
+    return m_cycles - start_cycles;
+  }
+
+#if defined(__GNUC__) || defined(__clang__)
+  //  Direct threading: every fused handler jumps straight to the next one.
+  #define CPU_LABEL_ENTRY(op, name) &&op_##op,
+  #define CPU_DISPATCH() \
+    if (times-- == 0) return m_cycles - start_cycles; \
+    goto *Dispatch[read_byte(m_reg.pc)]
+  #define CPU_THREADED_CASE(op, name) op_##op: execute<0x##op, CPU_HANDLER(op, name)>(); CPU_DISPATCH();
+
+  static void* const Dispatch[] = { CPU_OPCODES(CPU_LABEL_ENTRY) };
 
-    if (m_interrupt != Interrupt::None)
+  CPU_DISPATCH();
+  CPU_OPCODES(CPU_THREADED_CASE)
+
+  #undef CPU_THREADED_CASE
+  #undef CPU_DISPATCH
+  #undef CPU_LABEL_ENTRY
+#else
+  //  Portable fallback for compilers without labels as values.
+  #define CPU_SWITCH_CASE(op, name) case 0x##op: execute<0x##op, CPU_HANDLER(op, name)>(); break;
+
+  while (times-- > 0)
+  {
+    switch (read_byte(m_reg.pc))
     {
-      interrupt(m_interrupt);
+      CPU_OPCODES(CPU_SWITCH_CASE)
     }
+  }
 
-    m_interrupt = Interrupt::None;
+  #undef CPU_SWITCH_CASE
+
+  return m_cycles - start_cycles;
+#endif
+}
+#else
+uint64_t CPU::step(size_t times)
+{
+  auto start_cycles = m_cycles;
+  begin_run();
+
+  if (m_use_blocks)
+  {
+    run_blocks(times, NoDeadline);
+    return m_cycles - start_cycles;
+  }
+
+  while (times-- > 0)
+  {
+    (this->*FuncTable[read_byte(m_reg.pc)])();
+  }
+
+  return m_cycles - start_cycles;
+}
+#endif
 
-    (this->*FuncTable[opcode])(opinfo);
+uint64_t CPU::run_until(uint64_t target_cycle)
+{
+  auto start_cycles = m_cycles;
+  begin_run();
 
-    m_reg.pc += info.size;
-    m_cycles += info.cycles + pages_differ(m_reg.pc, address);
+  if (m_use_blocks)
+  {
+    run_blocks(std::numeric_limits<size_t>::max(), target_cycle);
+    return m_cycles - start_cycles;
+  }
+
+  while (m_cycles < target_cycle && !m_stop)
+  {
+    (this->*FuncTable[read_byte(m_reg.pc)])();
+    m_cycles += m_stall;
+    m_stall = 0;
   }
 
   return m_cycles - start_cycles;
 }
 
+void CPU::begin_run()
+{
+  m_cycles += m_stall;
+  m_stall = 0;
+  m_stop = false;
+}
+
+CPU::Blocks::Block& CPU::decode_block(uint16_t pc)
+{
+  std::vector<Instruction::Decoded> code;
+  auto start = pc;
+  uint8_t opcode;
+
+  do
+  {
+    opcode = read_byte(pc);
+    auto bytes = Instruction::operand_bytes(Instruction::Table[opcode].mode);
+    uint16_t operand = bytes == 2 ? read_word(pc + 1) : bytes == 1 ? read_byte(pc + 1) : 0;
+
+    code.push_back({ opcode, operand });
+    pc += Instruction::Table[opcode].size;
+  } while (!ends_block(opcode) && code.size() < MaxBlockSize);
+
+  //  Cover the operand of the last instruction even if it does not advance pc.
+  uint16_t end = pc + (Instruction::Table[opcode].size == 0 ? 1 + Instruction::operand_bytes(Instruction::Table[opcode].mode) : 0);
+
+  //  A taken branch lands on its target plus its own size.
+  auto& last = code.back();
+  uint16_t branch_pc = pc - Instruction::Table[opcode].size;
+  bool loops = Instruction::Table[opcode].mode == Instruction::AddressMode::Relative &&
+    static_cast<uint16_t>(branch_pc + static_cast<int8_t>(last.operand) + Instruction::Table[opcode].size) == start;
+
+  //  A JMP to itself is the other common way to wait, usually for an NMI.
+  //  JMP takes its target from the word at its operand, which is only read
+  //  here if it is memory; a register read could have side effects. Should
+  //  the word change later, the pass doesn't come back to the same pc and
+  //  the idle check won't skip it.
+  if (opcode == 0x4C)
+  {
+    auto pages = m_bus.read_pages();
+    uint16_t high = last.operand + 1;
+    loops = pages[last.operand >> 8] && pages[high >> 8] && read_word(last.operand) == start;
+  }
+
+  bool spins = loops &&
+    std::none_of(std::begin(code), std::end(code), [](const Instruction::Decoded& i) { return writes_memory(i.opcode); });
+
+  auto& block = m_blocks.insert(start, end, std::move(code));
+  block.data.spins = spins;
+  return block;
+}
+
+#define CPU_DECODED_CASE(op, name) case 0x##op: execute<0x##op, CPU_HANDLER(op, name)>(instruction.operand); break;
+
+void CPU::run_blocks(size_t times, uint64_t deadline)
+{
+  const Blocks::Block* spinning = nullptr;
+  uint32_t checks = 0;
+
+  while (times > 0 && m_cycles < deadline && !m_stop)
+  {
+    //  An interrupt moves pc before the handler runs, so take it one
+    //  instruction at a time through the regular table.
+    if (interrupt_pending())
+    {
+      (this->*FuncTable[read_byte(m_reg.pc)])();
+      --times;
+      continue;
+    }
+
+    auto block = m_blocks.find(m_reg.pc);
+    auto& current = block ? *block : decode_block(m_reg.pc);
+
+    //  The first passes through a spin loop are interpreted and compared, so
+    //  a loop that has settled is skipped instead of run.
+    bool check_idle = false;
+
+    if (current.data.spins)
+    {
+      if (spinning != &current)
+      {
+        spinning = &current;
+        checks = 0;
+      }
+
+      check_idle = checks++ < IdleChecks;
+    }
+    else
+    {
+      spinning = nullptr;
+    }
+
+    if (check_idle)
+    {
+      skip_idle_loop(current, times, deadline);
+    }
+    else if (!m_use_jit || !run_translated(current, times, deadline))
+    {
+      run_block(current, times, deadline);
+    }
+
+    //  Stalls requested by writes during the block are charged before the
+    //  deadline is checked again.
+    m_cycles += m_stall;
+    m_stall = 0;
+  }
+}
+
+void CPU::run_block(const Blocks::Block& block, size_t& times, uint64_t deadline)
+{
+  //  A write inside the block may drop it, so copy each entry out before
+  //  running it and stop as soon as the cache changes underneath us.
+  //  CLI or a write that raises an interrupt ends the block too, so the
+  //  interrupt is taken before the next instruction.
+  auto generation = m_blocks.generation();
+  auto code = block.code.data();
+  auto count = std::min(block.code.size(), times);
+
+#if defined(ROUGHNES_THREADED_CORE) && (defined(__GNUC__) || defined(__clang__))
+  //  The threaded core runs blocks as well: each fused handler jumps straight
+  //  to the one for the next decoded instruction.
+  #define CPU_LABEL_ENTRY(op, name) &&op_##op,
+  #define CPU_DISPATCH() \
+    if (i == count) return; \
+    instruction = code[i++]; \
+    goto *Dispatch[instruction.opcode]
+  #define CPU_THREADED_CASE(op, name) \
+    op_##op: \
+    execute<0x##op, CPU_HANDLER(op, name)>(instruction.operand); \
+    --times; \
+    if (m_blocks.generation() != generation || m_cycles >= deadline || m_stop || interrupt_pending()) return; \
+    CPU_DISPATCH();
+
+  static void* const Dispatch[] = { CPU_OPCODES(CPU_LABEL_ENTRY) };
+  Instruction::Decoded instruction;
+  size_t i = 0;
+
+  CPU_DISPATCH();
+  CPU_OPCODES(CPU_THREADED_CASE)
+
+  #undef CPU_THREADED_CASE
+  #undef CPU_DISPATCH
+  #undef CPU_LABEL_ENTRY
+#else
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto instruction = code[i];
+
+    switch (instruction.opcode)
+    {
+      CPU_OPCODES(CPU_DECODED_CASE)
+    }
+
+    --times;
+
+    if (m_blocks.generation() != generation || m_cycles >= deadline || m_stop || interrupt_pending())
+    {
+      break;
+    }
+  }
+#endif
+}
+
+#undef CPU_DECODED_CASE
+
+uint32_t CPU::io_changes() const
+{
+  return m_console ? m_console->io_changes() : 0;
+}
+
+//  A block that branches to itself without writing anything, and comes back
+//  around with every register and flag unchanged and no I/O read having had a
+//  side effect, will do exactly the same on every following pass until
+//  something outside the CPU changes what it reads. Everything outside the CPU
+//  happens at the deadline, so whole passes up to it are credited at once.
+void CPU::skip_idle_loop(const Blocks::Block& block, size_t& times, uint64_t deadline)
+{
+  auto regs = m_reg;
+  auto status = m_status.pack();
+  auto start_cycles = m_cycles;
+  auto start_times = times;
+  auto io = io_changes();
+  auto size = block.code.size();
+
+  //  Running the block may drop it, so nothing below may touch it.
+  run_block(block, times, deadline);
+
+  size_t executed = start_times - times;
+
+  if (executed != size || m_cycles >= deadline || m_stop || io_changes() != io ||
+    !(m_reg == regs) || m_status.pack() != status)
+  {
+    return;
+  }
+
+  uint64_t cycles = m_cycles - start_cycles;
+  uint64_t passes = std::min<uint64_t>((deadline - m_cycles) / cycles, times / executed);
+
+  m_cycles += passes * cycles;
+  times -= static_cast<size_t>(passes * executed);
+}
+
+bool CPU::run_translated(Blocks::Block& block, size_t& times, uint64_t deadline)
+{
+  auto& translation = block.data.translation;
+
+  if (translation.epoch != m_jit.epoch())
+  {
+    translation = BlockTranslation{ nullptr, 0, 0, m_jit.epoch(), 0 };
+  }
+
+  if (!translation.function)
+  {
+    if (translation.executions++ != m_jit_threshold || m_jit_excluded[block.start])
+    {
+      return false;
+    }
+
+    auto result = m_jit.translate(block.start, block.code);
+    translation = BlockTranslation{ result.function, result.size, result.max_cycles, m_jit.epoch(), translation.executions };
+
+    if (!translation.function)
+    {
+      return false;
+    }
+  }
+
+  //  Only enter when the whole block fits the budgets, so translated code
+  //  stops on exactly the same instruction as the interpreter would.
+  if (times < translation.size || deadline - m_cycles < translation.max_cycles)
+  {
+    return false;
+  }
+
+  auto& context = m_jit_context;
+  context.read_pages = m_bus.read_pages();
+  context.write_pages = m_bus.write_pages();
+  context.cycles = 0;
+  context.executed = 0;
+  context.budget = static_cast<uint32_t>(std::min<size_t>(times, 0x7FFFFFFF));
+  context.cycle_budget = deadline - m_cycles;
+  context.invalidated = 0;
+  context.a = m_reg.a;
+  context.x = m_reg.x;
+  context.y = m_reg.y;
+  context.s = m_reg.s;
+  context.p = m_status.pack();
+
+  //  The block may be dropped by a write while it runs; nothing below may
+  //  touch it.
+  translation.function(&context);
+
+  m_reg.a = context.a;
+  m_reg.x = context.x;
+  m_reg.y = context.y;
+  m_reg.s = context.s;
+  m_status.load(context.p);
+  m_reg.pc = context.pc;
+  m_cycles += context.cycles;
+  times -= context.executed;
+
+  //  Nothing retired means the first instruction needs the interpreter.
+  return context.executed > 0;
+}
+
+void CPU::jit_write(JIT::Context* context, uint32_t address, uint32_t value)
+{
+  auto cpu = static_cast<CPU*>(context->owner);
+  auto generation = cpu->m_blocks.generation();
+
+  cpu->write_byte(static_cast<uint8_t>(value), static_cast<uint16_t>(address));
+
+  if (cpu->m_blocks.generation() != generation || cpu->m_stall || cpu->m_stop || cpu->interrupt_pending())
+  {
+    context->invalidated = 1;
+  }
+}
+
+void CPU::bus_remapped(void* owner, uint8_t first_page, uint8_t last_page)
+{
+  static_cast<CPU*>(owner)->m_blocks.invalidate_pages(first_page, last_page);
+}
+
+void CPU::enable_block_cache(bool enabled)
+{
+  m_use_blocks = enabled;
+  m_blocks.clear();
+}
+
+bool CPU::enable_jit(bool enabled, uint32_t threshold)
+{
+  m_use_jit = enabled && JIT::supported();
+  m_jit_threshold = threshold;
+  m_blocks.clear();
+  return m_use_jit;
+}
+
+void CPU::interpret_block(uint16_t pc, bool interpret)
+{
+  m_jit_excluded[pc] = interpret;
+
+  if (auto block = m_blocks.find(pc))
+  {
+    block->data.translation = BlockTranslation{};
+  }
+}
+
 void CPU::stall(uint64_t cycles)
 {
   m_stall += cycles;
 }
 
+void CPU::stop()
+{
+  m_stop = true;
+}
+
+uint64_t CPU::cycles() const
+{
+  return m_cycles;
+}
+
 Registers CPU::get_registers() const
 {
-  return m_reg;
+  auto regs = m_reg;
+  regs.p = m_status.pack();
+  return regs;
 }
 
 uint16_t CPU::get_address(Instruction::AddressMode mode) const
@@ -112,31 +685,31 @@ uint16_t CPU::get_address(Instruction::AddressMode mode) const
   switch (mode)
   {
   case Instruction::AddressMode::Absolute:
-    return read_word(m_reg.pc + 1);
+    return address<Instruction::AddressMode::Absolute>(operand<Instruction::AddressMode::Absolute>());
   case Instruction::AddressMode::AbsoluteX:
-    return read_word(m_reg.pc + 1) + m_reg.x;
+    return address<Instruction::AddressMode::AbsoluteX>(operand<Instruction::AddressMode::AbsoluteX>());
   case Instruction::AddressMode::AbsoluteY:
-    return read_word(m_reg.pc + 1) + m_reg.y;
+    return address<Instruction::AddressMode::AbsoluteY>(operand<Instruction::AddressMode::AbsoluteY>());
   case Instruction::AddressMode::Accumulator:
-    return 0;
+    return address<Instruction::AddressMode::Accumulator>(operand<Instruction::AddressMode::Accumulator>());
   case Instruction::AddressMode::Immediate:
-    return m_reg.pc + 1;
+    return address<Instruction::AddressMode::Immediate>(operand<Instruction::AddressMode::Immediate>());
   case Instruction::AddressMode::Implied:
-    return 0;
+    return address<Instruction::AddressMode::Implied>(operand<Instruction::AddressMode::Implied>());
   case Instruction::AddressMode::Indirect:
-    return read_word(read_word(m_reg.pc + 1));
+    return address<Instruction::AddressMode::Indirect>(operand<Instruction::AddressMode::Indirect>());
   case Instruction::AddressMode::IndirectX:
-    return read_word(read_byte(m_reg.pc + 1) + m_reg.x);
+    return address<Instruction::AddressMode::IndirectX>(operand<Instruction::AddressMode::IndirectX>());
   case Instruction::AddressMode::IndirectY:
-    return read_word(read_byte(m_reg.pc + 1)) + m_reg.y;
+    return address<Instruction::AddressMode::IndirectY>(operand<Instruction::AddressMode::IndirectY>());
   case Instruction::AddressMode::Relative:
-    return static_cast<int8_t>(read_byte(m_reg.pc + 1)) + m_reg.pc;
+    return address<Instruction::AddressMode::Relative>(operand<Instruction::AddressMode::Relative>());
   case Instruction::AddressMode::ZeroPage:
-    return read_byte(m_reg.pc + 1);
+    return address<Instruction::AddressMode::ZeroPage>(operand<Instruction::AddressMode::ZeroPage>());
   case Instruction::AddressMode::ZeroPageX:
-    return read_byte(m_reg.pc + 1) + m_reg.x;;
+    return address<Instruction::AddressMode::ZeroPageX>(operand<Instruction::AddressMode::ZeroPageX>());
   case Instruction::AddressMode::ZeroPageY:
-    return read_byte(m_reg.pc + 1) + m_reg.y;
+    return address<Instruction::AddressMode::ZeroPageY>(operand<Instruction::AddressMode::ZeroPageY>());
   }
   return 0;
 }
@@ -144,18 +717,20 @@ uint16_t CPU::get_address(Instruction::AddressMode mode) const
 void CPU::set_registers(Registers regs)
 {
   m_reg = regs;
+  m_status.load(regs.p);
 }
 
 void CPU::write_byte(uint8_t value, uint16_t pos)
 {
-  m_sysmem[pos] = value;
+  m_bus.write(value, pos);
+  m_blocks.invalidate(pos);
 }
 
 void CPU::write_word(uint16_t value, uint16_t pos)
 {
-  m_sysmem[pos] = value & 0xFF;
-  ++pos;  //  Increment to avoid modulus logic in vector access (overflow will wrap around correctly)
-  m_sysmem[pos] = (value >> 8) & 0xFF;
+  write_byte(value & 0xFF, pos);
+  ++pos;  //  Wraps around at the top of memory
+  write_byte((value >> 8) & 0xFF, pos);
 }
 
 bool CPU::write_bytes(const std::vector<uint8_t>& data, uint16_t start)
@@ -176,7 +751,7 @@ bool CPU::write_bytes(const std::vector<uint8_t>& data, uint16_t start)
 
 uint8_t CPU::read_byte(uint16_t pos) const
 {
-  return m_sysmem[pos];
+  return m_bus.read(pos);
 }
 
 uint16_t CPU::read_word(uint16_t pos) const
@@ -191,7 +766,11 @@ std::vector<uint8_t> CPU::read_bytes(uint16_t start, size_t size) const
   if (start + size <= MemorySize)
   {
     data.resize(size);
-    std::copy(std::begin(m_sysmem) + start, std::begin(m_sysmem) + start + size, std::begin(data));
+
+    for (size_t i = 0; i < size; ++i)
+    {
+      data[i] = read_byte(static_cast<uint16_t>(start + i));
+    }
   }
 
   return data;
@@ -204,5 +783,10 @@ void CPU::trigger_nmi()
 
 void CPU::trigger_irq()
 {
-  m_interrupt = Interrupt::IRQ;
+  m_irq = true;
+}
+
+void CPU::clear_irq()
+{
+  m_irq = false;
 }
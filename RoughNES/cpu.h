@@ -4,16 +4,19 @@
 #include <memory>
 #include <vector>
 
+#include "block_cache.h"
+#include "bus.h"
+#include "jit.h"
 #include "register.h"
 #include "opcode.h"
 #include "cartridge.h"
-#include "nes.h"
 
 class NES;
 
 class CPU
 {
   const uint16_t NMIVectorAddress = 0xFFFA;
+  const uint16_t ResetVectorAddress = 0xFFFC;
   const uint16_t IRQVectorAddress = 0xFFFE;
   const uint16_t StackStart = 0x100;
 
@@ -24,37 +27,143 @@ class CPU
     IRQ
   };
 
-  std::shared_ptr<NES> m_console;
+  NES* m_console;
 
   std::vector<uint8_t> m_rom;
-  std::vector<uint8_t> m_sysmem;
-  Registers m_reg;
+  std::vector<uint8_t> m_sysmem;  //  The whole bus on a CPU without a console
+  Bus m_bus;
+  Registers m_reg;      //  p is stale; the flags live in m_status
+  LazyStatus m_status;
   uint64_t m_cycles;
-  Interrupt m_interrupt;
+  Interrupt m_interrupt;   //  NMI waiting for the next instruction
+  bool m_irq;              //  IRQ line held, taken once the I flag is clear
   uint64_t m_stall;
+  bool m_stop;
+
+  //  Longest run of instructions decoded into a single block.
+  static const size_t MaxBlockSize = 64;
+
+  //  Per block recompiler state. Translations are only trusted while their
+  //  epoch matches the recompiler's.
+  struct BlockTranslation
+  {
+    JIT::Function function;
+    uint16_t size;
+    uint16_t max_cycles;
+    uint32_t epoch;
+    uint32_t executions;
+  };
+
+  struct BlockData
+  {
+    bool spins;                   //  Branches or jumps back to its own start and never writes
+    BlockTranslation translation;
+  };
+
+  typedef BlockCache<Instruction::Decoded, BlockData> Blocks;
+
+  //  Passes through a spinning block that are compared against the one
+  //  before, each time it is entered.
+  static const uint32_t IdleChecks = 2;
+
+  //  Executions of a block before it is handed to the recompiler.
+  static const uint32_t DefaultJitThreshold = 16;
+
+  Blocks m_blocks;
+  bool m_use_blocks;
+
+  JIT m_jit;
+  JIT::Context m_jit_context;
+  bool m_use_jit;
+  uint32_t m_jit_threshold;
+  std::vector<bool> m_jit_excluded;
 
   struct OpcodeInfo
   {
     uint16_t address;
     uint16_t pc;
-    Instruction::AddressMode mode;
     uint8_t size;
   };
 
-  static void(CPU::*FuncTable[])(const OpcodeInfo&);
+  //  Fused decode + execute for a single opcode. The handler is instantiated
+  //  for the opcode's addressing mode, so nothing is decided at runtime.
+  //  The second overload runs with an operand that was already fetched.
+  template<uint8_t Opcode, void(CPU::*Handler)(const OpcodeInfo&)>
+  inline void execute();
+  template<uint8_t Opcode, void(CPU::*Handler)(const OpcodeInfo&)>
+  inline void execute(uint16_t operand);
+
+  static void(CPU::*const FuncTable[])();
+
+  static inline bool ends_block(uint8_t opcode);
+  static inline bool writes_memory(uint8_t opcode);
+  Blocks::Block& decode_block(uint16_t pc);
+  static const uint64_t NoDeadline = ~0ull;
+
+  //  Pending stalls are charged to m_cycles at the start of a run and
+  //  between blocks.
+  void begin_run();
+  void run_blocks(size_t times, uint64_t deadline);
+  void run_block(const Blocks::Block& block, size_t& times, uint64_t deadline);
+  void skip_idle_loop(const Blocks::Block& block, size_t& times, uint64_t deadline);
+  uint32_t io_changes() const;
+  bool run_translated(Blocks::Block& block, size_t& times, uint64_t deadline);
+  static void jit_write(JIT::Context* context, uint32_t address, uint32_t value);
+  static void bus_remapped(void* owner, uint8_t first_page, uint8_t last_page);
 
   static inline bool pages_differ(uint16_t a, uint16_t b);
+
+  //  Operand fetch and effective address for an addressing mode known at
+  //  compile time.
+  template<Instruction::AddressMode Mode>
+  inline uint16_t operand() const;
+  template<Instruction::AddressMode Mode>
+  inline uint16_t address(uint16_t operand) const;
 public:
   static const size_t MemorySize = 0x10000;
 
   CPU();
   explicit CPU(const std::vector<uint8_t>& rom);
   explicit CPU(Cartridge& cart);
-  explicit CPU(std::shared_ptr<NES> console);
+  explicit CPU(NES& console);
 
   bool load_rom(const std::vector<uint8_t>& rom);
+
+  //  Starts from the reset vector with interrupts disabled. Reset pushes
+  //  nothing but still moves the stack pointer down by three.
+  void reset();
+
+  //  Executes the given number of instructions and returns the cycles used.
+  //  Defining ROUGHNES_THREADED_CORE at build time swaps the table dispatch for
+  //  a threaded core with one fused handler per opcode. With the block cache
+  //  on, the default, blocks are run through the same threaded handlers;
+  //  with it off, step runs the threaded loop over fetched opcodes.
   uint64_t step(size_t times = 1);
+
+  //  Executes until the cycle counter reaches target_cycle or stop() is
+  //  called, and returns the cycles used. The instruction that crosses the
+  //  target completes, so the counter may end a few cycles past it.
+  uint64_t run_until(uint64_t target_cycle);
+  void stop();
+
+  //  Charges cycles the CPU spends halted, e.g. during DMA.
   void stall(uint64_t cycles);
+  uint64_t cycles() const;
+
+  //  Executes from predecoded basic blocks instead of fetching every opcode
+  //  (on by default). Blocks are dropped when a write lands on their code.
+  void enable_block_cache(bool enabled);
+
+  //  Runs blocks that have executed threshold times as native x86-64 code
+  //  (off by default). Needs the block cache, and returns false where the
+  //  recompiler is not available. A single block can be kept on the
+  //  interpreter with interpret_block.
+  bool enable_jit(bool enabled, uint32_t threshold = DefaultJitThreshold);
+  void interpret_block(uint16_t pc, bool interpret = true);
+
+  //  Every memory access goes through the bus. A standalone CPU sees 64K of
+  //  RAM; a console maps its own memory and registers over it.
+  inline Bus& bus() { return m_bus; }
 
   void set_registers(Registers regs);
   void write_byte(uint8_t value, uint16_t pos);
@@ -77,120 +186,124 @@ public:
   inline void stack_push_word(uint16_t value);
   inline uint16_t stack_pull_word();
 
-  inline void trigger_nmi();
-  inline void trigger_irq();
+  //  An NMI is taken before the next instruction. An IRQ waits for the I
+  //  flag to be clear and stays pending until it is taken or cleared.
+  void trigger_nmi();
+  void trigger_irq();
+  void clear_irq();
+  inline bool interrupt_pending() const;
   inline void interrupt(Interrupt inter);
 
 #pragma region Set and Clear status flags
-  inline void SEC(const OpcodeInfo& info);
-  inline void SED(const OpcodeInfo& info);
-  inline void SEI(const OpcodeInfo& info);
-  inline void CLC(const OpcodeInfo& info);
-  inline void CLD(const OpcodeInfo& info);
-  inline void CLI(const OpcodeInfo& info);
-  inline void CLV(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SEC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SED(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SEI(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void CLC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void CLD(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void CLI(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void CLV(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Increment and Decrement
-  inline void INC(const OpcodeInfo& info);
-  inline void INX(const OpcodeInfo& info);
-  inline void INY(const OpcodeInfo& info);
-  inline void DEC(const OpcodeInfo& info);
-  inline void DEX(const OpcodeInfo& info);
-  inline void DEY(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void INC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void INX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void INY(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void DEC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void DEX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void DEY(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Logical
-  inline void AND(const OpcodeInfo& info);
-  inline void EOR(const OpcodeInfo& info);
-  inline void ORA(const OpcodeInfo& info);
-  inline void BIT(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void AND(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void EOR(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ORA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BIT(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Arithmetic
-  inline void ADC(const OpcodeInfo& info);
-  inline void SBC(const OpcodeInfo& info);
-  inline void LSR(const OpcodeInfo& info);
-  inline void ASL(const OpcodeInfo& info);
-  inline void ROR(const OpcodeInfo& info);
-  inline void ROL(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ADC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SBC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void LSR(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ASL(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ROR(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ROL(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region System
-  inline void BRK(const OpcodeInfo& info);
-  inline void NOP(const OpcodeInfo& info);
-  inline void RTI(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BRK(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void NOP(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void RTI(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Register Transfer
-  inline void TAX(const OpcodeInfo& info);
-  inline void TAY(const OpcodeInfo& info);
-  inline void TSX(const OpcodeInfo& info);
-  inline void TXS(const OpcodeInfo& info);
-  inline void TXA(const OpcodeInfo& info);
-  inline void TYA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void TAX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void TAY(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void TSX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void TXS(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void TXA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void TYA(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Branch and Jump
-  inline void BCC(const OpcodeInfo& info);
-  inline void BCS(const OpcodeInfo& info);
-  inline void BEQ(const OpcodeInfo& info);
-  inline void BMI(const OpcodeInfo& info);
-  inline void BNE(const OpcodeInfo& info);
-  inline void BPL(const OpcodeInfo& info);
-  inline void BVC(const OpcodeInfo& info);
-  inline void BVS(const OpcodeInfo& info);
-
-  inline void JMP(const OpcodeInfo& info);
-  inline void JSR(const OpcodeInfo& info);
-  inline void RTS(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BCC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BCS(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BEQ(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BMI(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BNE(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BPL(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BVC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void BVS(const OpcodeInfo& info);
+
+  template<Instruction::AddressMode Mode> inline void JMP(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void JSR(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void RTS(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Load
-  inline void LDA(const OpcodeInfo& info);
-  inline void LDX(const OpcodeInfo& info);
-  inline void LDY(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void LDA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void LDX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void LDY(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Store
-  inline void STA(const OpcodeInfo& info);
-  inline void STX(const OpcodeInfo& info);
-  inline void STY(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void STA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void STX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void STY(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Compare
-  inline void CMP(const OpcodeInfo& info);
-  inline void CPX(const OpcodeInfo& info);
-  inline void CPY(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void CMP(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void CPX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void CPY(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Stack
-  inline void PHA(const OpcodeInfo& info);
-  inline void PHP(const OpcodeInfo& info);
-  inline void PLA(const OpcodeInfo& info);
-  inline void PLP(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void PHA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void PHP(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void PLA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void PLP(const OpcodeInfo& info);
 #pragma endregion
 
 #pragma region Illegal
-  inline void AHX(const OpcodeInfo& info);
-  inline void ALR(const OpcodeInfo& info);
-  inline void ANC(const OpcodeInfo& info);
-  inline void ARR(const OpcodeInfo& info);
-  inline void AXS(const OpcodeInfo& info);
-  inline void DCP(const OpcodeInfo& info);
-  inline void ISC(const OpcodeInfo& info);
-  inline void KIL(const OpcodeInfo& info);
-  inline void LAS(const OpcodeInfo& info);
-  inline void LAX(const OpcodeInfo& info);
-  inline void RLA(const OpcodeInfo& info);
-  inline void RRA(const OpcodeInfo& info);
-  inline void SAX(const OpcodeInfo& info);
-  inline void SHX(const OpcodeInfo& info);
-  inline void SHY(const OpcodeInfo& info);
-  inline void SLO(const OpcodeInfo& info);
-  inline void SRE(const OpcodeInfo& info);
-  inline void TAS(const OpcodeInfo& info);
-  inline void XAA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void AHX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ALR(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ANC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ARR(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void AXS(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void DCP(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void ISC(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void KIL(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void LAS(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void LAX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void RLA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void RRA(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SAX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SHX(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SHY(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SLO(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void SRE(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void TAS(const OpcodeInfo& info);
+  template<Instruction::AddressMode Mode> inline void XAA(const OpcodeInfo& info);
 #pragma endregion
 };
 
@@ -241,7 +354,7 @@ uint16_t CPU::stack_pull_word()
 void CPU::interrupt(Interrupt inter)
 {
   stack_push_word(m_reg.pc);
-  PHP(OpcodeInfo{});
+  PHP<Instruction::AddressMode::Implied>(OpcodeInfo{});
 
   switch (inter)
   { 
@@ -255,504 +368,584 @@ void CPU::interrupt(Interrupt inter)
       break;
   }
 
-  m_reg.set_flag(Status::Interrupt, true);
+  m_status.set_flag(Status::Interrupt, true);
   m_cycles += 7;
 }
 
+bool CPU::interrupt_pending() const
+{
+  return m_interrupt != Interrupt::None || (m_irq && !m_status.get_flag(Status::Interrupt));
+}
+
+template<Instruction::AddressMode Mode>
 void CPU::SEC(const OpcodeInfo& info)
 {
-  m_reg.set_flag(Status::Carry, true);
+  m_status.set_flag(Status::Carry, true);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SED(const OpcodeInfo& info)
 {
-  m_reg.set_flag(Status::Decimal, true);
+  m_status.set_flag(Status::Decimal, true);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SEI(const OpcodeInfo& info)
 {
-  m_reg.set_flag(Status::Interrupt, true);
+  m_status.set_flag(Status::Interrupt, true);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::CLC(const OpcodeInfo& info)
 {
-  m_reg.set_flag(Status::Carry, false);
+  m_status.set_flag(Status::Carry, false);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::CLD(const OpcodeInfo& info)
 {
-  m_reg.set_flag(Status::Decimal, false);
+  m_status.set_flag(Status::Decimal, false);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::CLI(const OpcodeInfo& info)
 {
-  m_reg.set_flag(Status::Interrupt, false);
+  m_status.set_flag(Status::Interrupt, false);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::CLV(const OpcodeInfo& info)
 {
-  m_reg.set_flag(Status::Overflow, false);
+  m_status.set_flag(Status::Overflow, false);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::INC(const OpcodeInfo& info)
 {
   write_byte(read_byte(info.address) + 1, info.address);
-  m_reg.set_zn(read_byte(info.address));
+  m_status.set_zn(read_byte(info.address));
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::INX(const OpcodeInfo& info)
 {
   m_reg.x += 1;
-  m_reg.set_zn(m_reg.x);
+  m_status.set_zn(m_reg.x);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::INY(const OpcodeInfo& info)
 {
   m_reg.y += 1;
-  m_reg.set_zn(m_reg.y);
+  m_status.set_zn(m_reg.y);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::DEC(const OpcodeInfo& info)
 {
   write_byte(read_byte(info.address) - 1, info.address);
-  m_reg.set_zn(read_byte(info.address));
+  m_status.set_zn(read_byte(info.address));
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::DEX(const OpcodeInfo& info)
 {
   m_reg.x -= 1;
-  m_reg.set_zn(m_reg.x);
+  m_status.set_zn(m_reg.x);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::DEY(const OpcodeInfo& info)
 {
   m_reg.y -= 1;
-  m_reg.set_zn(m_reg.y);
+  m_status.set_zn(m_reg.y);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::AND(const OpcodeInfo& info)
 {
   m_reg.a &= read_byte(info.address);
-  m_reg.set_zn(m_reg.a);
+  m_status.set_zn(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::EOR(const OpcodeInfo& info)
 {
   m_reg.a ^= read_byte(info.address);
-  m_reg.set_zn(m_reg.a);
+  m_status.set_zn(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ORA(const OpcodeInfo& info)
 {
   m_reg.a |= read_byte(info.address);
-  m_reg.set_zn(m_reg.a);
+  m_status.set_zn(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BIT(const OpcodeInfo& info)
 {
   auto value = read_byte(info.address);
-  m_reg.set_flag(Status::Zero, (m_reg.a & value) == 0);
-  m_reg.set_nv(value);
+  m_status.set_flag(Status::Zero, (m_reg.a & value) == 0);
+  m_status.set_nv(value);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ADC(const OpcodeInfo& info)
 {
   auto value = read_byte(info.address);
   uint8_t acc = m_reg.a;
-  uint8_t carry = m_reg.get_flag(Status::Carry);
+  uint8_t carry = m_status.get_flag(Status::Carry);
 
-  m_reg.a += value + m_reg.get_flag(Status::Carry);
+  m_reg.a += value + m_status.get_flag(Status::Carry);
 
-  m_reg.set_flag(Status::Carry, value + acc + carry > 0xFF);
-  m_reg.set_zn(m_reg.a);
-  m_reg.set_overflow(m_reg.a, acc, value);
+  m_status.set_flag(Status::Carry, value + acc + carry > 0xFF);
+  m_status.set_zn(m_reg.a);
+  m_status.set_overflow(m_reg.a, acc, value);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SBC(const OpcodeInfo& info)
 {
   auto value = read_byte(info.address);
   auto acc = m_reg.a;
-  uint8_t carry = m_reg.get_flag(Status::Carry);
+  uint8_t carry = m_status.get_flag(Status::Carry);
 
   m_reg.a = acc - value - (1 - carry);
 
-  m_reg.set_flag(Status::Carry, acc - value - (1 - carry) >= 0);
-  m_reg.set_zn(m_reg.a);
-  m_reg.set_overflow(m_reg.a, acc, value);
+  m_status.set_flag(Status::Carry, acc - value - (1 - carry) >= 0);
+  m_status.set_zn(m_reg.a);
+  m_status.set_overflow(m_reg.a, acc, value);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::LSR(const OpcodeInfo& info)
 {
   uint8_t temp;
 
-  if (info.mode == Instruction::AddressMode::Accumulator)
+  if (Mode == Instruction::AddressMode::Accumulator)
   {
     temp = m_reg.a;
-    m_reg.a = (temp / 2) | (m_reg.get_flag(Status::Carry) << 7);
-    m_reg.set_flag(Status::Carry, (temp & 1) > 0);
-    m_reg.set_zn(m_reg.a);
+    m_reg.a = (temp / 2) | (m_status.get_flag(Status::Carry) << 7);
+    m_status.set_flag(Status::Carry, (temp & 1) > 0);
+    m_status.set_zn(m_reg.a);
   }
   else
   {
     temp = read_byte(info.address);
-    int8_t result = (temp / 2) | (m_reg.get_flag(Status::Carry) << 7);
-    m_reg.set_flag(Status::Carry, (temp & 1) > 0);
-    m_reg.set_zn(result);
+    int8_t result = (temp / 2) | (m_status.get_flag(Status::Carry) << 7);
+    m_status.set_flag(Status::Carry, (temp & 1) > 0);
+    m_status.set_zn(result);
     write_byte(result, info.address);
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ASL(const OpcodeInfo& info)
 {
-  if (info.mode == Instruction::AddressMode::Accumulator)
+  if (Mode == Instruction::AddressMode::Accumulator)
   {
     uint8_t temp = m_reg.a;
-    m_reg.a = (temp * 2) | static_cast<int>(m_reg.get_flag(Status::Carry));;
-    m_reg.set_flag(Status::Carry, (temp & 0x80) > 0);
-    m_reg.set_zn(m_reg.a);
+    m_reg.a = (temp * 2) | static_cast<int>(m_status.get_flag(Status::Carry));;
+    m_status.set_flag(Status::Carry, (temp & 0x80) > 0);
+    m_status.set_zn(m_reg.a);
   }
   else
   {
     auto temp = read_byte(info.address);
-    int8_t result = (temp * 2) | static_cast<int>(m_reg.get_flag(Status::Carry));
-    m_reg.set_flag(Status::Carry, (temp & 0x80) > 0);
-    m_reg.set_zn(result);
+    int8_t result = (temp * 2) | static_cast<int>(m_status.get_flag(Status::Carry));
+    m_status.set_flag(Status::Carry, (temp & 0x80) > 0);
+    m_status.set_zn(result);
     write_byte(result, info.address);
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ROR(const OpcodeInfo& info)
 {
-  if (info.mode == Instruction::AddressMode::Accumulator)
+  if (Mode == Instruction::AddressMode::Accumulator)
   {
     auto bit_zero = (m_reg.a & 1) > 0;
-    m_reg.a = (static_cast<uint8_t>(m_reg.a) >> 1) | (m_reg.get_flag(Status::Carry) << 7);
-    m_reg.set_flag(Status::Carry, bit_zero);
-    m_reg.set_zn(m_reg.a);
+    m_reg.a = (static_cast<uint8_t>(m_reg.a) >> 1) | (m_status.get_flag(Status::Carry) << 7);
+    m_status.set_flag(Status::Carry, bit_zero);
+    m_status.set_zn(m_reg.a);
   }
   else
   {
     auto value = read_byte(info.address);
     auto bit_zero = (value & 1) > 0;
-    value = (value >> 1) | (m_reg.get_flag(Status::Carry) << 7);
-    m_reg.set_flag(Status::Carry, bit_zero);
-    m_reg.set_zn(value);
+    value = (value >> 1) | (m_status.get_flag(Status::Carry) << 7);
+    m_status.set_flag(Status::Carry, bit_zero);
+    m_status.set_zn(value);
     write_byte(value, info.address);
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ROL(const OpcodeInfo& info)
 {
-  if (info.mode == Instruction::AddressMode::Accumulator)
+  if (Mode == Instruction::AddressMode::Accumulator)
   {
     auto last_bit = (m_reg.a & 0x80) > 0;
-    m_reg.a = (static_cast<uint8_t>(m_reg.a) << 1) | static_cast<int>(m_reg.get_flag(Status::Carry));
-    m_reg.set_flag(Status::Carry, last_bit);
-    m_reg.set_zn(m_reg.a);
+    m_reg.a = (static_cast<uint8_t>(m_reg.a) << 1) | static_cast<int>(m_status.get_flag(Status::Carry));
+    m_status.set_flag(Status::Carry, last_bit);
+    m_status.set_zn(m_reg.a);
   }
   else
   {
     auto value = read_byte(info.address);
     auto last_bit = (value & 0x80) > 0;
-    value = (value << 1) | static_cast<int>(m_reg.get_flag(Status::Carry));
-    m_reg.set_flag(Status::Carry, last_bit);
-    m_reg.set_zn(value);
+    value = (value << 1) | static_cast<int>(m_status.get_flag(Status::Carry));
+    m_status.set_flag(Status::Carry, last_bit);
+    m_status.set_zn(value);
     write_byte(value, info.address);
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BRK(const OpcodeInfo& info)
 {
   stack_push_word(m_reg.pc);
-  stack_push_byte(m_reg.p);
+  stack_push_byte(m_status.pack());
 
   m_reg.pc = read_word(IRQVectorAddress) - info.size;
-  m_reg.set_flag(Status::Break, true);
+  m_status.set_flag(Status::Break, true);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::NOP(const OpcodeInfo& info)
 {
   //  Do nothing
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::RTI(const OpcodeInfo& info)
 {
-  m_reg.p = stack_pull_byte();
+  m_status.load(stack_pull_byte());
   m_reg.pc = stack_pull_word();
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::TAX(const OpcodeInfo& info)
 {
   m_reg.x = m_reg.a;
-  m_reg.set_zn(m_reg.x);
+  m_status.set_zn(m_reg.x);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::TAY(const OpcodeInfo& info)
 {
   m_reg.y = m_reg.a;
-  m_reg.set_zn(m_reg.y);
+  m_status.set_zn(m_reg.y);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::TSX(const OpcodeInfo& info)
 {
   m_reg.x = m_reg.s;
-  m_reg.set_zn(m_reg.x);
+  m_status.set_zn(m_reg.x);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::TXS(const OpcodeInfo& info)
 {
   m_reg.s = m_reg.x;
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::TXA(const OpcodeInfo& info)
 {
   m_reg.a = m_reg.x;
-  m_reg.set_zn(m_reg.a);
+  m_status.set_zn(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::TYA(const OpcodeInfo& info)
 {
   m_reg.a = m_reg.y;
-  m_reg.set_zn(m_reg.a);
+  m_status.set_zn(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BCC(const OpcodeInfo& info)
 {
-  if (!m_reg.get_flag(Status::Carry))
+  if (!m_status.get_flag(Status::Carry))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BCS(const OpcodeInfo& info)
 {
-  if (m_reg.get_flag(Status::Carry))
+  if (m_status.get_flag(Status::Carry))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BEQ(const OpcodeInfo& info)
 {
-  if (m_reg.get_flag(Status::Zero))
+  if (m_status.get_flag(Status::Zero))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BMI(const OpcodeInfo& info)
 {
-  if (m_reg.get_flag(Status::Negative))
+  if (m_status.get_flag(Status::Negative))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BNE(const OpcodeInfo& info)
 {
-  if (!m_reg.get_flag(Status::Zero))
+  if (!m_status.get_flag(Status::Zero))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BPL(const OpcodeInfo& info)
 {
-  if (!m_reg.get_flag(Status::Negative))
+  if (!m_status.get_flag(Status::Negative))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BVC(const OpcodeInfo& info)
 {
-  if (!m_reg.get_flag(Status::Overflow))
+  if (!m_status.get_flag(Status::Overflow))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::BVS(const OpcodeInfo& info)
 {
-  if (m_reg.get_flag(Status::Overflow))
+  if (m_status.get_flag(Status::Overflow))
   {
     m_reg.pc = info.address;
   }
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::JMP(const OpcodeInfo& info)
 {
   m_reg.pc = read_word(info.address) - info.size;
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::JSR(const OpcodeInfo& info)
 {
   stack_push_word(m_reg.pc - 1);
   m_reg.pc = info.address;
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::RTS(const OpcodeInfo& info)
 {
   m_reg.pc = stack_pull_word() - 1;
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::LDA(const OpcodeInfo& info)
 {
   m_reg.a = read_byte(info.address);
-  m_reg.set_zn(m_reg.a);
+  m_status.set_zn(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::LDX(const OpcodeInfo& info)
 {
   m_reg.x = read_byte(info.address);
-  m_reg.set_zn(m_reg.x);
+  m_status.set_zn(m_reg.x);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::LDY(const OpcodeInfo& info)
 {
   m_reg.y = read_byte(info.address);
-  m_reg.set_zn(m_reg.y);
+  m_status.set_zn(m_reg.y);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::STA(const OpcodeInfo& info)
 {
   write_byte(m_reg.a, info.address);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::STX(const OpcodeInfo& info)
 {
   write_byte(m_reg.x, info.address);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::STY(const OpcodeInfo& info)
 {
   write_byte(m_reg.y, info.address);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::CMP(const OpcodeInfo& info)
 {
   int8_t mem = read_byte(info.address);
   int8_t value = m_reg.a - mem;
 
-  m_reg.set_flag(Status::Carry, m_reg.a >= mem);
-  m_reg.set_zn(value);
+  m_status.set_flag(Status::Carry, m_reg.a >= mem);
+  m_status.set_zn(value);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::CPX(const OpcodeInfo& info)
 {
   int8_t mem = read_byte(info.address);
   int8_t value = m_reg.x - mem;
 
-  m_reg.set_flag(Status::Carry, m_reg.x >= mem);
-  m_reg.set_zn(value);
+  m_status.set_flag(Status::Carry, m_reg.x >= mem);
+  m_status.set_zn(value);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::CPY(const OpcodeInfo& info)
 {
   int8_t mem = read_byte(info.address);
   int8_t value = m_reg.y - mem;
 
-  m_reg.set_flag(Status::Carry, m_reg.y >= mem);
-  m_reg.set_zn(value);
+  m_status.set_flag(Status::Carry, m_reg.y >= mem);
+  m_status.set_zn(value);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::PHA(const OpcodeInfo& info)
 {
   stack_push_byte(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::PHP(const OpcodeInfo& info)
 {
-  stack_push_byte(m_reg.p);
+  stack_push_byte(m_status.pack());
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::PLA(const OpcodeInfo& info)
 {
   m_reg.a = stack_pull_byte();
-  m_reg.set_zn(m_reg.a);
+  m_status.set_zn(m_reg.a);
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::PLP(const OpcodeInfo& info)
 {
-  m_reg.p = stack_pull_byte();
+  m_status.load(stack_pull_byte());
 }
 
 //
 //Illegal Opcodes Below.
 //
 #pragma region Illegal Opcodes
+template<Instruction::AddressMode Mode>
 void CPU::AHX(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ALR(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ANC(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ARR(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::AXS(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::DCP(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::ISC(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::KIL(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::LAS(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::LAX(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::RLA(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::RRA(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SAX(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SHX(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SHY(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SLO(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::SRE(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::TAS(const OpcodeInfo& info)
 {
 }
 
+template<Instruction::AddressMode Mode>
 void CPU::XAA(const OpcodeInfo& info)
 {
 }
@@ -0,0 +1,164 @@
+#include "crc32.h"
+
+#include <array>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ROUGHNES_CRC32_CLMUL
+#endif
+
+#if defined(ROUGHNES_CRC32_CLMUL)
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ROUGHNES_CLMUL_TARGET
+#else
+#include <cpuid.h>
+#define ROUGHNES_CLMUL_TARGET __attribute__((target("pclmul,sse4.1")))
+#endif
+#endif
+
+namespace
+{
+  const uint32_t Polynomial = 0xEDB88320;
+
+  std::array<uint32_t, 256> make_table()
+  {
+    std::array<uint32_t, 256> table;
+
+    for (uint32_t i = 0; i < table.size(); ++i)
+    {
+      auto value = i;
+
+      for (int bit = 0; bit < 8; ++bit)
+      {
+        value = (value >> 1) ^ ((value & 1) ? Polynomial : 0);
+      }
+
+      table[i] = value;
+    }
+
+    return table;
+  }
+
+  const std::array<uint32_t, 256> Table = make_table();
+
+  //  Works on the inverted CRC, like the loop in crc32 itself.
+  uint32_t crc32_table(const uint8_t* data, size_t size, uint32_t crc)
+  {
+    for (size_t i = 0; i < size; ++i)
+    {
+      crc = (crc >> 8) ^ Table[(crc ^ data[i]) & 0xFF];
+    }
+
+    return crc;
+  }
+
+#if defined(ROUGHNES_CRC32_CLMUL)
+  bool has_clmul()
+  {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    auto ecx = static_cast<unsigned>(info[2]);
+#else
+    unsigned eax, ebx, ecx = 0, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+      return false;
+    }
+#endif
+
+    //  PCLMULQDQ and SSE4.1
+    return (ecx & (1u << 1)) && (ecx & (1u << 19));
+  }
+
+  const bool HasCLMUL = has_clmul();
+
+  inline __m128i load(const uint8_t* data)
+  {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  }
+
+  //  Multiplies both halves of x by their constant in k and adds in next.
+  ROUGHNES_CLMUL_TARGET inline __m128i fold(__m128i x, __m128i k, __m128i next)
+  {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+  }
+
+  //  Folds 64 bytes at a time with carry-less multiplies, then reduces to 32
+  //  bits with Barrett reduction ("Fast CRC Computation for Generic Polynomials
+  //  Using PCLMULQDQ Instruction", Intel). The constants are x^n mod P for the
+  //  reflected polynomial. Takes at least 64 bytes, in a multiple of 16.
+  ROUGHNES_CLMUL_TARGET uint32_t crc32_clmul(const uint8_t* data, size_t size, uint32_t crc)
+  {
+    const __m128i k1k2 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+    const __m128i k5 = _mm_set_epi64x(0, 0x163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x1f7011641, 0x1db710641);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    auto x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    auto x2 = load(data + 0x10);
+    auto x3 = load(data + 0x20);
+    auto x4 = load(data + 0x30);
+    data += 64;
+    size -= 64;
+
+    for (; size >= 64; data += 64, size -= 64)
+    {
+      x1 = fold(x1, k1k2, load(data));
+      x2 = fold(x2, k1k2, load(data + 0x10));
+      x3 = fold(x3, k1k2, load(data + 0x20));
+      x4 = fold(x4, k1k2, load(data + 0x30));
+    }
+
+    //  Four lanes into one, then the remaining 16 byte blocks
+    x1 = fold(x1, k3k4, x2);
+    x1 = fold(x1, k3k4, x3);
+    x1 = fold(x1, k3k4, x4);
+
+    for (; size >= 16; data += 16, size -= 16)
+    {
+      x1 = fold(x1, k3k4, load(data));
+    }
+
+    //  128 bits to 64
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, low32);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5, 0x00), x2);
+
+    //  Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, low32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, low32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+  }
+#endif
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+  crc = ~crc;
+
+#if defined(ROUGHNES_CRC32_CLMUL)
+  if (HasCLMUL && size >= 64)
+  {
+    auto blocks = size & ~size_t{ 15 };
+    crc = crc32_clmul(data, blocks, crc);
+    data += blocks;
+    size -= blocks;
+  }
+#endif
+
+  return ~crc32_table(data, size, crc);
+}
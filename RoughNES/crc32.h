@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//  CRC-32 as used by zip and by ROM databases (reflected, polynomial
+//  0xEDB88320). Pass a previous result to continue over more data. Uses
+//  carry-less multiplication on x86-64 processors that have it, which makes
+//  hashing a ROM cost next to nothing next to loading it.
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
@@ -0,0 +1,80 @@
+#include "header_fixups.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  struct Fixup
+  {
+    uint32_t crc;
+    HeaderFixups::Header header;
+  };
+
+  //  Built-in corrections, written as NES 2.0 headers so nothing is left to
+  //  defaults. Only dumps whose CRC has been checked against a known good
+  //  copy belong here, and none have been yet, so the table is empty on
+  //  purpose. Until it isn't, fixups come from add().
+  const std::vector<Fixup> BuiltIn = {};
+
+  struct Database
+  {
+    std::mutex lock;
+    std::unordered_map<uint32_t, HeaderFixups::Header> headers;
+
+    Database()
+    {
+      for (const auto& fixup : BuiltIn)
+      {
+        headers.emplace(fixup.crc, fixup.header);
+      }
+    }
+  };
+
+  Database& database()
+  {
+    static Database instance;
+    return instance;
+  }
+}
+
+bool HeaderFixups::find(uint32_t crc, Header& header)
+{
+  auto& database = ::database();
+  std::lock_guard<std::mutex> guard(database.lock);
+
+  auto entry = database.headers.find(crc);
+
+  if (entry == std::end(database.headers))
+  {
+    return false;
+  }
+
+  header = entry->second;
+  return true;
+}
+
+void HeaderFixups::add(uint32_t crc, const Header& header)
+{
+  auto& database = ::database();
+  std::lock_guard<std::mutex> guard(database.lock);
+
+  database.headers[crc] = header;
+}
+
+void HeaderFixups::remove(uint32_t crc)
+{
+  auto& database = ::database();
+  std::lock_guard<std::mutex> guard(database.lock);
+
+  database.headers.erase(crc);
+
+  for (const auto& fixup : BuiltIn)
+  {
+    if (fixup.crc == crc)
+    {
+      database.headers.emplace(fixup.crc, fixup.header);
+    }
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+//  Corrected headers for dumps known to carry a wrong one, keyed by the CRC32
+//  of everything after the header (what Cartridge::crc() reports). That part
+//  of the file doesn't change when a header is fixed, so the key finds the
+//  game whatever its header claims. Entries added at run time take precedence
+//  over the built-in ones.
+class HeaderFixups
+{
+public:
+  typedef std::array<uint8_t, 16> Header;
+
+  //  Copies the replacement header for crc into header if there is one.
+  static bool find(uint32_t crc, Header& header);
+
+  static void add(uint32_t crc, const Header& header);
+
+  //  Drops an entry added at run time, falling back to the built-in one for
+  //  crc if there is one.
+  static void remove(uint32_t crc);
+};
@@ -0,0 +1,1105 @@
+#include "jit.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#include "register.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ROUGHNES_JIT_X64
+#endif
+
+#if defined(ROUGHNES_JIT_X64)
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace
+{
+  void make_writable(uint8_t* buffer, size_t size, bool writable)
+  {
+#if defined(ROUGHNES_JIT_X64)
+#if defined(_WIN32)
+    DWORD old;
+    VirtualProtect(buffer, size, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old);
+#else
+    mprotect(buffer, size, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+#endif
+#endif
+  }
+
+  uint8_t* allocate(size_t size)
+  {
+#if defined(ROUGHNES_JIT_X64)
+#if defined(_WIN32)
+    return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+    auto buffer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return buffer == MAP_FAILED ? nullptr : static_cast<uint8_t*>(buffer);
+#endif
+#else
+    return nullptr;
+#endif
+  }
+
+  void release(uint8_t* buffer, size_t size)
+  {
+#if defined(ROUGHNES_JIT_X64)
+#if defined(_WIN32)
+    VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+    munmap(buffer, size);
+#endif
+#endif
+  }
+
+  enum Reg : uint8_t
+  {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    NoIndex = 0xFF
+  };
+
+  enum Condition : uint8_t
+  {
+    Below = 0x2,
+    Equal = 0x4,
+    NotEqual = 0x5,
+    Above = 0x7,
+    NotSign = 0x9,
+    GreaterEqual = 0xD
+  };
+
+  //  Two operand ALU opcodes in their "r/m, reg" form. The immediate group
+  //  extension is the opcode shifted down by three.
+  enum Alu : uint8_t
+  {
+    Add = 0x01,
+    Or = 0x09,
+    And = 0x21,
+    Sub = 0x29,
+    Xor = 0x31,
+    Cmp = 0x39
+  };
+
+  //  6502 state lives in callee saved registers so calls out to write leave
+  //  it alone. RAX, RCX, RDX and R8-R11 are scratch.
+  const Reg A = RBX;
+  const Reg X = RBP;
+  const Reg Y = R14;
+  const Reg P = R15;
+  const Reg Ctx = R12;
+  const Reg Pages = R13;
+
+#if defined(_WIN32)
+  const Reg Arg0 = RCX;
+  const Reg Arg1 = RDX;
+  const Reg Arg2 = R8;
+  const int32_t FrameSize = 40;   //  Shadow space plus alignment
+#else
+  const Reg Arg0 = RDI;
+  const Reg Arg1 = RSI;
+  const Reg Arg2 = RDX;
+  const int32_t FrameSize = 8;    //  Alignment
+#endif
+
+  struct Mem
+  {
+    Reg base;
+    Reg index;
+    int32_t disp;
+  };
+
+  inline Mem at(Reg base, int32_t disp)
+  {
+    return { base, NoIndex, disp };
+  }
+
+  inline Mem at(Reg base, Reg index, int32_t disp)
+  {
+    return { base, index, disp };
+  }
+
+  inline int32_t field(size_t offset)
+  {
+    return static_cast<int32_t>(offset);
+  }
+
+  //  Just enough of an x86-64 assembler for the translator. Memory operands
+  //  always use a SIB byte and a 32 bit displacement, which keeps R12 and R13
+  //  from needing special cases.
+  class Emitter
+  {
+  public:
+    std::vector<uint8_t> code;
+
+    size_t size() const { return code.size(); }
+
+    void byte(uint8_t value) { code.push_back(value); }
+
+    void dword(uint32_t value)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        byte(static_cast<uint8_t>(value >> (i * 8)));
+      }
+    }
+
+    void rex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool byte_reg)
+    {
+      uint8_t prefix = 0x40 | (wide << 3) | ((reg >> 3) & 1) << 2 | ((index >> 3) & 1) << 1 | ((base >> 3) & 1);
+
+      //  SPL, BPL, SIL and DIL only exist with a REX prefix.
+      if (prefix != 0x40 || byte_reg)
+      {
+        byte(prefix);
+      }
+    }
+
+    void rr(std::initializer_list<uint8_t> opcode, uint8_t reg, uint8_t rm, bool wide = false, bool byte_reg = false)
+    {
+      rex(wide, reg, 0, rm, byte_reg);
+
+      for (auto op : opcode)
+      {
+        byte(op);
+      }
+
+      byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+
+    void rm(std::initializer_list<uint8_t> opcode, uint8_t reg, Mem mem, bool wide = false, bool byte_reg = false)
+    {
+      rex(wide, reg, mem.index == NoIndex ? 0 : mem.index, mem.base, byte_reg);
+
+      for (auto op : opcode)
+      {
+        byte(op);
+      }
+
+      byte(0x80 | (reg & 7) << 3 | 4);
+      byte((mem.index == NoIndex ? 4 : (mem.index & 7)) << 3 | (mem.base & 7));
+      dword(mem.disp);
+    }
+
+    static bool is_byte_reg(Reg reg) { return reg >= RSP && reg <= RDI; }
+
+    void mov(Reg dst, Reg src) { rr({ 0x89 }, src, dst); }
+    void mov64(Reg dst, Reg src) { rr({ 0x89 }, src, dst, true); }
+
+    void mov(Reg dst, uint32_t value)
+    {
+      rex(false, 0, 0, dst, false);
+      byte(0xB8 + (dst & 7));
+      dword(value);
+    }
+
+    void load64(Reg dst, Mem mem) { rm({ 0x8B }, dst, mem, true); }
+    void load32(Reg dst, Mem mem) { rm({ 0x8B }, dst, mem); }
+    void movzx8(Reg dst, Mem mem) { rm({ 0x0F, 0xB6 }, dst, mem); }
+    void movzx8(Reg dst, Reg src) { rr({ 0x0F, 0xB6 }, dst, src, false, is_byte_reg(src)); }
+    void movsx8(Reg dst, Reg src) { rr({ 0x0F, 0xBE }, dst, src, false, is_byte_reg(src)); }
+    void movzx16(Reg dst, Reg src) { rr({ 0x0F, 0xB7 }, dst, src); }
+    void store8(Mem mem, Reg src) { rm({ 0x88 }, src, mem, false, is_byte_reg(src)); }
+
+    void store16(Mem mem, uint16_t value)
+    {
+      byte(0x66);
+      rm({ 0xC7 }, 0, mem);
+      byte(value & 0xFF);
+      byte(value >> 8);
+    }
+
+    void alu(Alu op, Reg dst, Reg src) { rr({ op }, src, dst); }
+    void alu(Alu op, Reg dst, Mem mem, bool wide = false) { rm({ static_cast<uint8_t>(op + 2) }, dst, mem, wide); }
+
+    void alu(Alu op, Reg dst, int32_t value, bool wide = false)
+    {
+      if (value >= -128 && value <= 127)
+      {
+        rr({ 0x83 }, op >> 3, dst, wide);
+        byte(static_cast<uint8_t>(value));
+      }
+      else
+      {
+        rr({ 0x81 }, op >> 3, dst, wide);
+        dword(value);
+      }
+    }
+
+    void alu(Alu op, Mem mem, int32_t value, bool wide = false)
+    {
+      rm({ 0x81 }, op >> 3, mem, wide);
+      dword(value);
+    }
+
+    void add64(Mem mem, Reg src) { rm({ Add }, src, mem, true); }
+    void cmp8(Mem mem, uint8_t value) { rm({ 0x80 }, 7, mem); byte(value); }
+    void inc8(Mem mem) { rm({ 0xFE }, 0, mem); }
+    void dec8(Mem mem) { rm({ 0xFE }, 1, mem); }
+    void test(Reg a, Reg b, bool wide = false) { rr({ 0x85 }, b, a, wide); }
+    void test(Reg reg, uint32_t value) { rr({ 0xF7 }, 0, reg); dword(value); }
+    void shl(Reg reg, uint8_t count) { rr({ 0xC1 }, 4, reg); byte(count); }
+    void shr(Reg reg, uint8_t count) { rr({ 0xC1 }, 5, reg); byte(count); }
+    void setcc(Condition cc, Reg dst) { rr({ 0x0F, static_cast<uint8_t>(0x90 | cc) }, 0, dst, false, is_byte_reg(dst)); }
+    void call(Mem mem) { rm({ 0xFF }, 2, mem); }
+
+    void push(Reg reg)
+    {
+      rex(false, 0, 0, reg, false);
+      byte(0x50 + (reg & 7));
+    }
+
+    void pop(Reg reg)
+    {
+      rex(false, 0, 0, reg, false);
+      byte(0x58 + (reg & 7));
+    }
+
+    void ret() { byte(0xC3); }
+
+    //  Forward jumps return the offset of their displacement for bind().
+    size_t jcc(Condition cc)
+    {
+      byte(0x0F);
+      byte(0x80 | cc);
+      dword(0);
+      return size() - 4;
+    }
+
+    size_t jmp()
+    {
+      byte(0xE9);
+      dword(0);
+      return size() - 4;
+    }
+
+    void jmp(size_t target)
+    {
+      bind(jmp(), target);
+    }
+
+    void bind(size_t patch, size_t target)
+    {
+      auto rel = static_cast<int32_t>(target - (patch + 4));
+      std::memcpy(&code[patch], &rel, sizeof(rel));
+    }
+  };
+
+  enum class Operation : uint8_t
+  {
+    Unsupported,
+    LDA, LDX, LDY, STA, STX, STY,
+    TAX, TAY, TSX, TXA, TXS, TYA,
+    INC, INX, INY, DEC, DEX, DEY,
+    AND, EOR, ORA, BIT,
+    ADC, SBC, CMP, CPX, CPY,
+    ASL, LSR, ROL, ROR,
+    CLC, CLD, CLI, CLV, SEC, SED, SEI,
+    PHA, PHP, PLA, PLP,
+    NOP,
+    BCC, BCS, BEQ, BMI, BNE, BPL, BVC, BVS
+  };
+
+  Operation operation(uint8_t opcode)
+  {
+    struct Entry
+    {
+      const char* name;
+      Operation operation;
+    };
+
+    static const Entry Entries[] = {
+      { "LDA", Operation::LDA }, { "LDX", Operation::LDX }, { "LDY", Operation::LDY },
+      { "STA", Operation::STA }, { "STX", Operation::STX }, { "STY", Operation::STY },
+      { "TAX", Operation::TAX }, { "TAY", Operation::TAY }, { "TSX", Operation::TSX },
+      { "TXA", Operation::TXA }, { "TXS", Operation::TXS }, { "TYA", Operation::TYA },
+      { "INC", Operation::INC }, { "INX", Operation::INX }, { "INY", Operation::INY },
+      { "DEC", Operation::DEC }, { "DEX", Operation::DEX }, { "DEY", Operation::DEY },
+      { "AND", Operation::AND }, { "EOR", Operation::EOR }, { "ORA", Operation::ORA },
+      { "BIT", Operation::BIT }, { "ADC", Operation::ADC }, { "SBC", Operation::SBC },
+      { "CMP", Operation::CMP }, { "CPX", Operation::CPX }, { "CPY", Operation::CPY },
+      { "ASL", Operation::ASL }, { "LSR", Operation::LSR }, { "ROL", Operation::ROL },
+      { "ROR", Operation::ROR }, { "CLC", Operation::CLC }, { "CLD", Operation::CLD },
+      { "CLI", Operation::CLI }, { "CLV", Operation::CLV }, { "SEC", Operation::SEC },
+      { "SED", Operation::SED }, { "SEI", Operation::SEI }, { "PHA", Operation::PHA },
+      { "PHP", Operation::PHP }, { "PLA", Operation::PLA }, { "PLP", Operation::PLP },
+      { "NOP", Operation::NOP }, { "BCC", Operation::BCC }, { "BCS", Operation::BCS },
+      { "BEQ", Operation::BEQ }, { "BMI", Operation::BMI }, { "BNE", Operation::BNE },
+      { "BPL", Operation::BPL }, { "BVC", Operation::BVC }, { "BVS", Operation::BVS }
+    };
+
+    //  Opcodes that never advance pc are left to the interpreter.
+    if (Instruction::Table[opcode].size == 0)
+    {
+      return Operation::Unsupported;
+    }
+
+    for (const auto& entry : Entries)
+    {
+      if (std::strcmp(entry.name, Instruction::Names[opcode]) == 0)
+      {
+        return entry.operation;
+      }
+    }
+
+    return Operation::Unsupported;
+  }
+
+  bool reads_memory(Operation op)
+  {
+    switch (op)
+    {
+    case Operation::LDA: case Operation::LDX: case Operation::LDY:
+    case Operation::AND: case Operation::EOR: case Operation::ORA: case Operation::BIT:
+    case Operation::ADC: case Operation::SBC:
+    case Operation::CMP: case Operation::CPX: case Operation::CPY:
+    case Operation::INC: case Operation::DEC:
+    case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  bool writes_memory(Operation op)
+  {
+    switch (op)
+    {
+    case Operation::STA: case Operation::STX: case Operation::STY:
+    case Operation::INC: case Operation::DEC:
+    case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  bool is_branch(Operation op)
+  {
+    return op >= Operation::BCC;
+  }
+
+  bool pages_differ(uint16_t a, uint16_t b)
+  {
+    return (a & 0xFF00) != (b & 0xFF00);
+  }
+
+  class Translator
+  {
+  public:
+    Translator(uint16_t start) : m_start(start), m_cycles(0), m_max_cycles(0)
+    {
+    }
+
+    uint16_t translate(const std::vector<Instruction::Decoded>& code);
+
+    uint16_t max_cycles() const { return static_cast<uint16_t>(m_max_cycles); }
+
+    const std::vector<uint8_t>& code() const { return m_emit.code; }
+
+  private:
+    struct Exit
+    {
+      size_t patch;
+      uint16_t pc;
+      uint32_t cycles;
+      uint32_t count;
+    };
+
+    Emitter m_emit;
+    std::vector<Exit> m_exits;
+    uint16_t m_start;
+    uint32_t m_cycles;    //  Static cycles up to the current instruction
+    uint32_t m_max_cycles;
+    size_t m_body;
+
+    //  Effective address of the current instruction, either known at
+    //  translation time or computed into RAX.
+    bool m_dynamic;
+    uint16_t m_address;
+
+    //  Where to leave if the current instruction can not run here.
+    uint16_t m_pc;
+    uint32_t m_index;
+
+    void exit(size_t patch, uint16_t pc, uint32_t cycles, uint32_t count)
+    {
+      m_exits.push_back({ patch, pc, cycles, count });
+    }
+
+    void prologue();
+    void epilogue();
+    void emit_exits();
+
+    void read_page(Reg address);
+    void read_page(uint16_t address);
+    void write_page(Reg address);
+    void write_page(uint16_t address);
+    bool address(const Instruction::Decoded& instruction);
+    void load(Reg dst, const Instruction::Decoded& instruction);
+    void write(Reg value);
+    void set_zn(Reg value);
+    void set_carry(Condition cc);
+    void set_overflow(Reg output, Reg value1, Reg value2);
+    void compare(Reg reg);
+    void shift_left(Reg value);
+    void shift_right(Reg value);
+    void branch(Operation op, const Instruction::Decoded& instruction, uint16_t pc, uint32_t count);
+    void operate(Operation op, const Instruction::Decoded& instruction);
+  };
+
+  void Translator::prologue()
+  {
+    m_emit.push(RBX);
+    m_emit.push(RBP);
+    m_emit.push(R12);
+    m_emit.push(R13);
+    m_emit.push(R14);
+    m_emit.push(R15);
+    m_emit.alu(Sub, RSP, FrameSize, true);
+
+    m_emit.mov64(Ctx, Arg0);
+    m_emit.load64(Pages, at(Ctx, field(offsetof(JIT::Context, read_pages))));
+    m_emit.movzx8(A, at(Ctx, field(offsetof(JIT::Context, a))));
+    m_emit.movzx8(X, at(Ctx, field(offsetof(JIT::Context, x))));
+    m_emit.movzx8(Y, at(Ctx, field(offsetof(JIT::Context, y))));
+    m_emit.movzx8(P, at(Ctx, field(offsetof(JIT::Context, p))));
+  }
+
+  void Translator::epilogue()
+  {
+    m_emit.alu(Add, RSP, FrameSize, true);
+    m_emit.pop(R15);
+    m_emit.pop(R14);
+    m_emit.pop(R13);
+    m_emit.pop(R12);
+    m_emit.pop(RBP);
+    m_emit.pop(RBX);
+    m_emit.ret();
+  }
+
+  void Translator::emit_exits()
+  {
+    for (const auto& exit : m_exits)
+    {
+      m_emit.bind(exit.patch, m_emit.size());
+      m_emit.store8(at(Ctx, field(offsetof(JIT::Context, a))), A);
+      m_emit.store8(at(Ctx, field(offsetof(JIT::Context, x))), X);
+      m_emit.store8(at(Ctx, field(offsetof(JIT::Context, y))), Y);
+      m_emit.store8(at(Ctx, field(offsetof(JIT::Context, p))), P);
+      m_emit.store16(at(Ctx, field(offsetof(JIT::Context, pc))), exit.pc);
+
+      if (exit.cycles)
+      {
+        m_emit.alu(Add, at(Ctx, field(offsetof(JIT::Context, cycles))), exit.cycles, true);
+      }
+
+      if (exit.count)
+      {
+        m_emit.alu(Add, at(Ctx, field(offsetof(JIT::Context, executed))), exit.count);
+      }
+
+      epilogue();
+    }
+  }
+
+  //  Loads the read page of an address into R11, see Bus. Pages that belong
+  //  to a handler leave before the current instruction.
+  void Translator::read_page(Reg address)
+  {
+    m_emit.mov(R11, address);
+    m_emit.shr(R11, 8);
+    m_emit.shl(R11, 3);
+    m_emit.load64(R11, at(Pages, R11, 0));
+    m_emit.test(R11, R11, true);
+    exit(m_emit.jcc(Equal), m_pc, m_cycles, m_index);
+  }
+
+  void Translator::read_page(uint16_t address)
+  {
+    m_emit.load64(R11, at(Pages, (address >> 8) * 8));
+    m_emit.test(R11, R11, true);
+    exit(m_emit.jcc(Equal), m_pc, m_cycles, m_index);
+  }
+
+  //  Writes still go through the owner; this only keeps handler pages, and
+  //  whatever they might trigger, on the interpreter.
+  void Translator::write_page(Reg address)
+  {
+    m_emit.load64(R10, at(Ctx, field(offsetof(JIT::Context, write_pages))));
+    m_emit.mov(RDX, address);
+    m_emit.shr(RDX, 8);
+    m_emit.shl(RDX, 3);
+    m_emit.load64(RDX, at(R10, RDX, 0));
+    m_emit.test(RDX, RDX, true);
+    exit(m_emit.jcc(Equal), m_pc, m_cycles, m_index);
+  }
+
+  void Translator::write_page(uint16_t address)
+  {
+    m_emit.load64(R10, at(Ctx, field(offsetof(JIT::Context, write_pages))));
+    m_emit.load64(RDX, at(R10, (address >> 8) * 8));
+    m_emit.test(RDX, RDX, true);
+    exit(m_emit.jcc(Equal), m_pc, m_cycles, m_index);
+  }
+
+  //  Mirrors CPU::address<Mode>. Returns false when the instruction has to go
+  //  through the interpreter.
+  bool Translator::address(const Instruction::Decoded& instruction)
+  {
+    auto mode = Instruction::Table[instruction.opcode].mode;
+    auto op = operation(instruction.opcode);
+
+    m_dynamic = false;
+    m_address = 0;
+
+    switch (mode)
+    {
+    case Instruction::AddressMode::Absolute:
+    case Instruction::AddressMode::ZeroPage:
+      m_address = instruction.operand;
+      break;
+    case Instruction::AddressMode::Immediate:
+      m_address = m_pc + 1;
+      return true;
+    case Instruction::AddressMode::Accumulator:
+    case Instruction::AddressMode::Implied:
+      return true;
+    case Instruction::AddressMode::AbsoluteX:
+    case Instruction::AddressMode::ZeroPageX:
+    case Instruction::AddressMode::AbsoluteY:
+    case Instruction::AddressMode::ZeroPageY:
+      m_emit.movsx8(RAX, mode == Instruction::AddressMode::AbsoluteX || mode == Instruction::AddressMode::ZeroPageX ? X : Y);
+      m_emit.alu(Add, RAX, instruction.operand);
+      m_emit.movzx16(RAX, RAX);
+      m_dynamic = true;
+      break;
+    case Instruction::AddressMode::IndirectX:
+      m_emit.movsx8(RCX, X);
+      m_emit.alu(Add, RCX, instruction.operand);
+      m_emit.movzx16(RCX, RCX);
+      read_page(RCX);
+      m_emit.movzx8(RAX, at(R11, RCX, 0));
+      m_emit.alu(Add, RCX, 1);
+      m_emit.movzx16(RCX, RCX);
+      read_page(RCX);
+      m_emit.movzx8(RCX, at(R11, RCX, 0));
+      m_emit.shl(RCX, 8);
+      m_emit.alu(Or, RAX, RCX);
+      m_dynamic = true;
+      break;
+    case Instruction::AddressMode::IndirectY:
+    {
+      uint16_t high = instruction.operand + 1;
+      read_page(instruction.operand);
+      m_emit.movzx8(RAX, at(R11, instruction.operand));
+      read_page(high);
+      m_emit.movzx8(RCX, at(R11, high));
+      m_emit.shl(RCX, 8);
+      m_emit.alu(Or, RAX, RCX);
+      m_emit.movsx8(RCX, Y);
+      m_emit.alu(Add, RAX, RCX);
+      m_emit.movzx16(RAX, RAX);
+      m_dynamic = true;
+      break;
+    }
+    default:
+      return false;
+    }
+
+    //  Both checks come before anything the instruction changes, so leaving
+    //  here hands the whole instruction to the interpreter.
+    if (writes_memory(op))
+    {
+      m_dynamic ? write_page(RAX) : write_page(m_address);
+    }
+
+    if (reads_memory(op))
+    {
+      m_dynamic ? read_page(RAX) : read_page(m_address);
+    }
+
+    return true;
+  }
+
+  void Translator::load(Reg dst, const Instruction::Decoded& instruction)
+  {
+    if (Instruction::Table[instruction.opcode].mode == Instruction::AddressMode::Immediate)
+    {
+      m_emit.mov(dst, static_cast<uint32_t>(instruction.operand & 0xFF));
+    }
+    else if (m_dynamic)
+    {
+      m_emit.movzx8(dst, at(R11, RAX, 0));
+    }
+    else
+    {
+      m_emit.movzx8(dst, at(R11, m_address));
+    }
+  }
+
+  //  Goes through the owner so writes see the same side effects as the
+  //  interpreter. Clobbers every scratch register.
+  void Translator::write(Reg value)
+  {
+    if (value != Arg2)
+    {
+      m_emit.mov(Arg2, value);
+    }
+
+    if (m_dynamic)
+    {
+      m_emit.mov(Arg1, RAX);
+    }
+    else
+    {
+      m_emit.mov(Arg1, static_cast<uint32_t>(m_address));
+    }
+
+    m_emit.mov64(Arg0, Ctx);
+    m_emit.call(at(Ctx, field(offsetof(JIT::Context, write))));
+  }
+
+  void Translator::set_zn(Reg value)
+  {
+    m_emit.alu(And, P, ~(Status::Zero | Status::Negative) & 0xFF);
+    m_emit.movzx8(RDX, at(Ctx, value, field(offsetof(JIT::Context, zn))));
+    m_emit.alu(Or, P, RDX);
+  }
+
+  void Translator::set_carry(Condition cc)
+  {
+    m_emit.setcc(cc, RDX);
+    m_emit.movzx8(RDX, RDX);
+    m_emit.alu(And, P, ~Status::Carry & 0xFF);
+    m_emit.alu(Or, P, RDX);
+  }
+
+  //  Registers::set_overflow
+  void Translator::set_overflow(Reg output, Reg value1, Reg value2)
+  {
+    m_emit.mov(R10, value1);
+    m_emit.alu(Xor, R10, value2);
+    m_emit.alu(Xor, R10, 0x80);
+    m_emit.mov(R11, value2);
+    m_emit.alu(Xor, R11, output);
+    m_emit.alu(And, R10, R11);
+    m_emit.alu(And, R10, 0x80);
+    m_emit.shr(R10, 1);
+    m_emit.alu(And, P, ~Status::Overflow & 0xFF);
+    m_emit.alu(Or, P, R10);
+  }
+
+  //  Carry comes from a signed comparison, as in CPU::CMP.
+  void Translator::compare(Reg reg)
+  {
+    m_emit.movsx8(RAX, reg);
+    m_emit.movsx8(R8, RCX);
+    m_emit.alu(Cmp, RAX, R8);
+    set_carry(GreaterEqual);
+    m_emit.mov(RAX, reg);
+    m_emit.alu(Sub, RAX, RCX);
+    m_emit.alu(And, RAX, 0xFF);
+    set_zn(RAX);
+  }
+
+  //  ASL and ROL both shift the carry in.
+  void Translator::shift_left(Reg value)
+  {
+    m_emit.mov(R8, P);
+    m_emit.alu(And, R8, Status::Carry);
+    m_emit.mov(RDX, value);
+    m_emit.shr(RDX, 7);
+    m_emit.shl(value, 1);
+    m_emit.alu(Or, value, R8);
+    m_emit.alu(And, value, 0xFF);
+    m_emit.alu(And, P, ~Status::Carry & 0xFF);
+    m_emit.alu(Or, P, RDX);
+    set_zn(value);
+  }
+
+  //  LSR and ROR both shift the carry in.
+  void Translator::shift_right(Reg value)
+  {
+    m_emit.mov(R8, P);
+    m_emit.alu(And, R8, Status::Carry);
+    m_emit.shl(R8, 7);
+    m_emit.mov(RDX, value);
+    m_emit.alu(And, RDX, 1);
+    m_emit.shr(value, 1);
+    m_emit.alu(Or, value, R8);
+    m_emit.alu(And, P, ~Status::Carry & 0xFF);
+    m_emit.alu(Or, P, RDX);
+    set_zn(value);
+  }
+
+  void Translator::branch(Operation op, const Instruction::Decoded& instruction, uint16_t pc, uint32_t count)
+  {
+    const auto& info = Instruction::Table[instruction.opcode];
+    uint16_t target = static_cast<int8_t>(instruction.operand) + pc;
+    uint16_t taken = target + info.size;
+    uint16_t not_taken = pc + info.size;
+
+    Status flag;
+    bool set;
+
+    switch (op)
+    {
+    case Operation::BCC: flag = Status::Carry; set = false; break;
+    case Operation::BCS: flag = Status::Carry; set = true; break;
+    case Operation::BNE: flag = Status::Zero; set = false; break;
+    case Operation::BEQ: flag = Status::Zero; set = true; break;
+    case Operation::BPL: flag = Status::Negative; set = false; break;
+    case Operation::BMI: flag = Status::Negative; set = true; break;
+    case Operation::BVC: flag = Status::Overflow; set = false; break;
+    default: flag = Status::Overflow; set = true; break;
+    }
+
+    m_emit.test(P, static_cast<uint32_t>(flag));
+    auto jump = m_emit.jcc(set ? NotEqual : Equal);
+
+    exit(m_emit.jmp(), not_taken, m_cycles + info.cycles + pages_differ(not_taken, target), count);
+
+    m_emit.bind(jump, m_emit.size());
+    auto cycles = m_cycles + info.cycles + pages_differ(taken, target);
+
+    if (taken != m_start)
+    {
+      exit(m_emit.jmp(), taken, cycles, count);
+      return;
+    }
+
+    //  Tight loop: commit the iteration and go around again while both
+    //  budgets allow another full pass.
+    m_emit.alu(Add, at(Ctx, field(offsetof(JIT::Context, cycles))), cycles, true);
+    m_emit.alu(Add, at(Ctx, field(offsetof(JIT::Context, executed))), count);
+    m_emit.load32(RAX, at(Ctx, field(offsetof(JIT::Context, executed))));
+    m_emit.alu(Add, RAX, count);
+    m_emit.alu(Cmp, RAX, at(Ctx, field(offsetof(JIT::Context, budget))));
+    exit(m_emit.jcc(Above), m_start, 0, 0);
+    m_emit.load64(RAX, at(Ctx, field(offsetof(JIT::Context, cycles))));
+    m_emit.alu(Add, RAX, m_max_cycles, true);
+    m_emit.alu(Cmp, RAX, at(Ctx, field(offsetof(JIT::Context, cycle_budget))), true);
+    exit(m_emit.jcc(Above), m_start, 0, 0);
+    m_emit.jmp(m_body);
+  }
+
+  void Translator::operate(Operation op, const Instruction::Decoded& instruction)
+  {
+    auto accumulator = Instruction::Table[instruction.opcode].mode == Instruction::AddressMode::Accumulator;
+
+    switch (op)
+    {
+    case Operation::LDA: load(A, instruction); set_zn(A); break;
+    case Operation::LDX: load(X, instruction); set_zn(X); break;
+    case Operation::LDY: load(Y, instruction); set_zn(Y); break;
+    case Operation::STA: write(A); break;
+    case Operation::STX: write(X); break;
+    case Operation::STY: write(Y); break;
+
+    case Operation::TAX: m_emit.mov(X, A); set_zn(X); break;
+    case Operation::TAY: m_emit.mov(Y, A); set_zn(Y); break;
+    case Operation::TXA: m_emit.mov(A, X); set_zn(A); break;
+    case Operation::TYA: m_emit.mov(A, Y); set_zn(A); break;
+    case Operation::TSX: m_emit.movzx8(X, at(Ctx, field(offsetof(JIT::Context, s)))); set_zn(X); break;
+    case Operation::TXS: m_emit.store8(at(Ctx, field(offsetof(JIT::Context, s))), X); break;
+
+    case Operation::INX: m_emit.alu(Add, X, 1); m_emit.alu(And, X, 0xFF); set_zn(X); break;
+    case Operation::INY: m_emit.alu(Add, Y, 1); m_emit.alu(And, Y, 0xFF); set_zn(Y); break;
+    case Operation::DEX: m_emit.alu(Sub, X, 1); m_emit.alu(And, X, 0xFF); set_zn(X); break;
+    case Operation::DEY: m_emit.alu(Sub, Y, 1); m_emit.alu(And, Y, 0xFF); set_zn(Y); break;
+    case Operation::INC:
+    case Operation::DEC:
+      load(RCX, instruction);
+      m_emit.alu(op == Operation::INC ? Add : Sub, RCX, 1);
+      m_emit.alu(And, RCX, 0xFF);
+      set_zn(RCX);
+      write(RCX);
+      break;
+
+    case Operation::AND: load(RCX, instruction); m_emit.alu(And, A, RCX); set_zn(A); break;
+    case Operation::EOR: load(RCX, instruction); m_emit.alu(Xor, A, RCX); set_zn(A); break;
+    case Operation::ORA: load(RCX, instruction); m_emit.alu(Or, A, RCX); set_zn(A); break;
+    case Operation::BIT:
+      load(RCX, instruction);
+      m_emit.mov(RDX, A);
+      m_emit.alu(And, RDX, RCX);
+      m_emit.setcc(Equal, RDX);
+      m_emit.movzx8(RDX, RDX);
+      m_emit.shl(RDX, 1);
+      m_emit.alu(And, P, ~Status::Zero & 0xFF);
+      m_emit.alu(Or, P, RDX);
+      m_emit.alu(And, P, 0x3F);
+      m_emit.alu(And, RCX, 0xC0);
+      m_emit.alu(Or, P, RCX);
+      break;
+
+    case Operation::ADC:
+      load(RCX, instruction);
+      m_emit.mov(R8, P);
+      m_emit.alu(And, R8, Status::Carry);
+      m_emit.mov(R9, A);
+      m_emit.mov(RAX, A);
+      m_emit.alu(Add, RAX, RCX);
+      m_emit.alu(Add, RAX, R8);
+      m_emit.alu(Cmp, RAX, 0xFF);
+      set_carry(Above);
+      m_emit.movzx8(A, RAX);
+      set_zn(A);
+      set_overflow(A, R9, RCX);
+      break;
+    case Operation::SBC:
+      //  Carry is computed from the signed accumulator, as in CPU::SBC.
+      load(RCX, instruction);
+      m_emit.mov(R8, P);
+      m_emit.alu(And, R8, Status::Carry);
+      m_emit.mov(R9, A);
+      m_emit.movsx8(RAX, A);
+      m_emit.alu(Sub, RAX, RCX);
+      m_emit.alu(Sub, RAX, 1);
+      m_emit.alu(Add, RAX, R8);
+      m_emit.test(RAX, RAX);
+      set_carry(NotSign);
+      m_emit.movzx8(A, RAX);
+      set_zn(A);
+      set_overflow(A, R9, RCX);
+      break;
+    case Operation::CMP: load(RCX, instruction); compare(A); break;
+    case Operation::CPX: load(RCX, instruction); compare(X); break;
+    case Operation::CPY: load(RCX, instruction); compare(Y); break;
+
+    case Operation::ASL:
+    case Operation::ROL:
+    case Operation::LSR:
+    case Operation::ROR:
+    {
+      auto left = op == Operation::ASL || op == Operation::ROL;
+
+      if (accumulator)
+      {
+        left ? shift_left(A) : shift_right(A);
+      }
+      else
+      {
+        load(RCX, instruction);
+        left ? shift_left(RCX) : shift_right(RCX);
+        write(RCX);
+      }
+      break;
+    }
+
+    case Operation::CLC: m_emit.alu(And, P, ~Status::Carry & 0xFF); break;
+    case Operation::CLD: m_emit.alu(And, P, ~Status::Decimal & 0xFF); break;
+    case Operation::CLI: m_emit.alu(And, P, ~Status::Interrupt & 0xFF); break;
+    case Operation::CLV: m_emit.alu(And, P, ~Status::Overflow & 0xFF); break;
+    case Operation::SEC: m_emit.alu(Or, P, Status::Carry); break;
+    case Operation::SED: m_emit.alu(Or, P, Status::Decimal); break;
+    case Operation::SEI: m_emit.alu(Or, P, Status::Interrupt); break;
+
+    case Operation::PHA:
+    case Operation::PHP:
+      write_page(static_cast<uint16_t>(0x100));
+      m_emit.movzx8(RAX, at(Ctx, field(offsetof(JIT::Context, s))));
+      m_emit.alu(Or, RAX, 0x100);
+      m_dynamic = true;
+      write(op == Operation::PHA ? A : P);
+      m_emit.dec8(at(Ctx, field(offsetof(JIT::Context, s))));
+      break;
+    case Operation::PLA:
+    case Operation::PLP:
+    {
+      auto dst = op == Operation::PLA ? A : P;
+      read_page(static_cast<uint16_t>(0x100));
+      m_emit.inc8(at(Ctx, field(offsetof(JIT::Context, s))));
+      m_emit.movzx8(RAX, at(Ctx, field(offsetof(JIT::Context, s))));
+      m_emit.movzx8(dst, at(R11, RAX, 0x100));
+
+      if (op == Operation::PLA)
+      {
+        set_zn(A);
+      }
+      break;
+    }
+
+    default:
+      break;
+    }
+  }
+
+  uint16_t Translator::translate(const std::vector<Instruction::Decoded>& code)
+  {
+    prologue();
+    m_body = m_emit.size();
+
+    uint16_t pc = m_start;
+    uint32_t count = 0;
+
+    for (const auto& instruction : code)
+    {
+      const auto& info = Instruction::Table[instruction.opcode];
+      auto op = operation(instruction.opcode);
+
+      if (op == Operation::Unsupported)
+      {
+        break;
+      }
+
+      //  Every instruction can pay at most one cycle for a page crossing.
+      m_max_cycles += info.cycles + 1;
+
+      if (is_branch(op))
+      {
+        branch(op, instruction, pc, count + 1);
+        emit_exits();
+        return count + 1;
+      }
+
+      auto mark = m_emit.size();
+      auto exits = m_exits.size();
+      m_pc = pc;
+      m_index = count;
+
+      if (!address(instruction))
+      {
+        m_emit.code.resize(mark);
+        m_exits.resize(exits);
+        m_max_cycles -= info.cycles + 1;
+        break;
+      }
+
+      uint16_t next = pc + info.size;
+      uint32_t cycles = m_cycles + info.cycles;
+
+      //  Page crossing between the effective address and the next pc, exactly
+      //  as the interpreter charges it.
+      if (m_dynamic)
+      {
+        m_emit.mov(RCX, RAX);
+        m_emit.alu(Xor, RCX, next);
+        m_emit.test(RCX, 0xFF00u);
+        m_emit.setcc(NotEqual, RCX);
+        m_emit.movzx8(RCX, RCX);
+        m_emit.add64(at(Ctx, field(offsetof(JIT::Context, cycles))), RCX);
+      }
+      else
+      {
+        cycles += pages_differ(next, m_address);
+      }
+
+      operate(op, instruction);
+
+      ++count;
+      m_cycles = cycles;
+      pc = next;
+
+      if (writes_memory(op) || op == Operation::PHA || op == Operation::PHP)
+      {
+        m_emit.cmp8(at(Ctx, field(offsetof(JIT::Context, invalidated))), 0);
+        exit(m_emit.jcc(NotEqual), pc, m_cycles, count);
+      }
+
+      //  Clearing I can make a held IRQ takeable, so go back to run_blocks,
+      //  which takes it before the next instruction just as the interpreter
+      //  does.
+      if (op == Operation::CLI || op == Operation::PLP)
+      {
+        break;
+      }
+    }
+
+    if (count == 0)
+    {
+      return 0;
+    }
+
+    exit(m_emit.jmp(), pc, m_cycles, count);
+    emit_exits();
+    return count;
+  }
+}
+
+JIT::JIT() : m_buffer(nullptr), m_used(0), m_epoch(1)
+{
+}
+
+JIT::~JIT()
+{
+  if (m_buffer)
+  {
+    release(m_buffer, BufferSize);
+  }
+}
+
+bool JIT::supported()
+{
+#if defined(ROUGHNES_JIT_X64)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void JIT::prepare(Context& context)
+{
+  std::memset(&context, 0, sizeof(context));
+
+  for (int i = 0; i < 256; ++i)
+  {
+    context.zn[i] = (i == 0 ? Status::Zero : 0) | (i & Status::Negative);
+  }
+}
+
+JIT::Translation JIT::translate(uint16_t pc, const std::vector<Instruction::Decoded>& code)
+{
+  if (!supported())
+  {
+    return { nullptr, 0, 0 };
+  }
+
+  Translator translator(pc);
+  auto size = translator.translate(code);
+  const auto& bytes = translator.code();
+
+  if (size == 0 || bytes.size() > BufferSize)
+  {
+    return { nullptr, 0, 0 };
+  }
+
+  if (!m_buffer)
+  {
+    m_buffer = allocate(BufferSize);
+
+    if (!m_buffer)
+    {
+      return { nullptr, 0, 0 };
+    }
+
+    make_writable(m_buffer, BufferSize, false);
+  }
+
+  if (m_used + bytes.size() > BufferSize)
+  {
+    flush();
+  }
+
+  auto function = m_buffer + m_used;
+
+  make_writable(m_buffer, BufferSize, true);
+  std::memcpy(function, bytes.data(), bytes.size());
+  make_writable(m_buffer, BufferSize, false);
+
+  //  Keep entry points 16 byte aligned.
+  m_used = (m_used + bytes.size() + 15) & ~static_cast<size_t>(15);
+
+  return { reinterpret_cast<Function>(function), size, translator.max_cycles() };
+}
+
+void JIT::flush()
+{
+  m_used = 0;
+  ++m_epoch;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "opcode.h"
+
+//  Recompiles decoded 6502 blocks to x86-64. Translated code keeps A, X, Y and
+//  P in host registers for the length of a block and reproduces the cycle
+//  accounting of the interpreter exactly, including its page crossing rules.
+//
+//  A translation covers the longest prefix of a block that it understands and
+//  hands everything else back to the interpreter: jumps, interrupts, illegal
+//  opcodes and any access to a bus page that belongs to a handler. On other
+//  architectures translate() always fails and the interpreter runs everything.
+class JIT
+{
+public:
+  //  State exchanged with translated code. It is loaded on entry and spilled
+  //  on every exit, so the owner only has to sync registers around the call.
+  struct Context
+  {
+    //  Bus page tables, see Bus. Reads are direct, writes go through write
+    //  and are only made to memory pages.
+    const uintptr_t* read_pages;
+    const uintptr_t* write_pages;
+    void* owner;            //  Handed back to write
+    void(*write)(Context* context, uint32_t address, uint32_t value);
+    uint64_t cycles;        //  Cycles consumed, added to on exit
+    uint32_t executed;      //  Instructions retired, added to on exit
+    uint32_t budget;        //  Instructions a block may retire before it has to return
+    uint64_t cycle_budget;  //  Cycles a block may consume before it has to return
+    uint16_t pc;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t s;
+    uint8_t p;
+    uint8_t invalidated;    //  Set by write when the running block was dropped
+    uint8_t zn[256];        //  Zero and Negative flags for every byte value
+  };
+
+  typedef void(*Function)(Context* context);
+
+  struct Translation
+  {
+    Function function;
+    uint16_t size;        //  Instructions covered, counted from the block start
+    uint16_t max_cycles;  //  Upper bound for one pass, page crossings included
+  };
+
+  JIT();
+  ~JIT();
+
+  JIT(const JIT&) = delete;
+  JIT& operator=(const JIT&) = delete;
+
+  static bool supported();
+  static void prepare(Context& context);
+
+  Translation translate(uint16_t pc, const std::vector<Instruction::Decoded>& code);
+
+  //  All translations are dropped together when the code buffer fills up.
+  //  Callers compare epochs to tell whether a Function is still valid.
+  inline uint32_t epoch() const { return m_epoch; }
+  void flush();
+
+private:
+  static const size_t BufferSize = 4 << 20;
+
+  uint8_t* m_buffer;
+  size_t m_used;
+  uint32_t m_epoch;
+};
@@ -0,0 +1,125 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  const size_t ReadChunk = 0x10000;
+}
+
+MappedFile::MappedFile(const std::string& filename) : m_data(nullptr), m_size(0), m_view(nullptr)
+{
+#if defined(_WIN32)
+  auto file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    throw std::invalid_argument("Could not open file");
+  }
+
+  LARGE_INTEGER size;
+
+  if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size) && size.QuadPart > 0)
+  {
+    auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping)
+    {
+      //  The view keeps the mapping alive on its own.
+      m_view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      m_size = m_view ? static_cast<size_t>(size.QuadPart) : 0;
+      CloseHandle(mapping);
+    }
+  }
+
+  if (!m_view)
+  {
+    DWORD read = 0;
+
+    do
+    {
+      m_buffer.resize(m_size + ReadChunk);
+
+      if (!ReadFile(file, m_buffer.data() + m_size, static_cast<DWORD>(ReadChunk), &read, nullptr))
+      {
+        read = 0;
+      }
+
+      m_size += read;
+    } while (read > 0);
+  }
+
+  CloseHandle(file);
+#else
+  auto file = open(filename.c_str(), O_RDONLY);
+
+  if (file < 0)
+  {
+    throw std::invalid_argument("Could not open file");
+  }
+
+  struct stat info;
+
+  if (fstat(file, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+  {
+    auto view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+    if (view != MAP_FAILED)
+    {
+      m_view = view;
+      m_size = static_cast<size_t>(info.st_size);
+    }
+  }
+
+  if (!m_view)
+  {
+    ssize_t count;
+
+    do
+    {
+      m_buffer.resize(m_size + ReadChunk);
+      count = read(file, m_buffer.data() + m_size, ReadChunk);
+      m_size += count > 0 ? count : 0;
+    } while (count > 0);
+  }
+
+  close(file);
+#endif
+
+  if (m_view)
+  {
+    m_data = static_cast<const uint8_t*>(m_view);
+  }
+  else
+  {
+    m_buffer.resize(m_size);
+    m_data = m_buffer.data();
+  }
+}
+
+MappedFile::MappedFile(std::vector<uint8_t> buffer) : m_view(nullptr), m_buffer(std::move(buffer))
+{
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+  if (m_view)
+  {
+#if defined(_WIN32)
+    UnmapViewOfFile(m_view);
+#else
+    munmap(m_view, m_size);
+#endif
+  }
+}
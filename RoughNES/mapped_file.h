@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//  Read-only contents of a file. Regular files are mapped straight into
+//  memory, so opening one costs the same no matter how large it is. Pipes and
+//  anything else that can't be mapped are read into a buffer instead.
+class MappedFile
+{
+  const uint8_t* m_data;
+  size_t m_size;
+  void* m_view;                   //  Start of the mapping, null when buffered
+  std::vector<uint8_t> m_buffer;
+public:
+  explicit MappedFile(const std::string& filename);
+  explicit MappedFile(std::vector<uint8_t> buffer);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  inline const uint8_t* data() const { return m_data; }
+  inline size_t size() const { return m_size; }
+  inline bool mapped() const { return m_view != nullptr; }
+};
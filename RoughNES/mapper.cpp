@@ -0,0 +1,398 @@
+#include "mapper.h"
+#include "nes.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace
+{
+  uint8_t read_open_bus(void*, uint16_t)
+  {
+    return 0;
+  }
+
+  template<typename Board>
+  void write_board(void* board, uint8_t value, uint16_t address)
+  {
+    static_cast<Board*>(board)->write(value, address);
+  }
+
+  class NROM final : public Mapper
+  {
+  public:
+    explicit NROM(NES& console) : Mapper(console) {}
+
+    void reset() override
+    {
+      take_writes(this);
+      m_console.map_prg(0x8000, 0x4000, 0);
+      m_console.map_prg(0xC000, 0x4000, 1);
+      m_console.map_chr(0x0000, 0x2000, 0);
+      header_mirroring();
+    }
+
+    void write(uint8_t, uint16_t)
+    {
+    }
+  };
+
+  //  16K switched at $8000 and the last bank fixed at $C000.
+  class UxROM final : public Mapper
+  {
+  public:
+    explicit UxROM(NES& console) : Mapper(console) {}
+
+    void reset() override
+    {
+      take_writes(this);
+      m_console.map_prg(0x8000, 0x4000, 0);
+      m_console.map_prg(0xC000, 0x4000, prg_banks(0x4000) - 1);
+      m_console.map_chr(0x0000, 0x2000, 0);
+      header_mirroring();
+    }
+
+    void write(uint8_t value, uint16_t)
+    {
+      m_console.map_prg(0x8000, 0x4000, value);
+    }
+  };
+
+  //  Fixed PRG and one switched 8K CHR bank.
+  class CNROM final : public Mapper
+  {
+  public:
+    explicit CNROM(NES& console) : Mapper(console) {}
+
+    void reset() override
+    {
+      take_writes(this);
+      m_console.map_prg(0x8000, 0x4000, 0);
+      m_console.map_prg(0xC000, 0x4000, 1);
+      m_console.map_chr(0x0000, 0x2000, 0);
+      header_mirroring();
+    }
+
+    void write(uint8_t value, uint16_t)
+    {
+      m_console.map_chr(0x0000, 0x2000, value);
+    }
+  };
+
+  //  Registers are loaded a bit at a time through a serial port; the fifth
+  //  write picks the register from its address.
+  class MMC1 final : public Mapper
+  {
+    uint8_t m_shift;
+    uint8_t m_count;
+    uint8_t m_control;
+    uint8_t m_chr0;
+    uint8_t m_chr1;
+    uint8_t m_prg;
+
+    void update()
+    {
+      static const PPU::Mirroring Mirroring[] = {
+        PPU::Mirroring::SingleLow, PPU::Mirroring::SingleHigh, PPU::Mirroring::Vertical, PPU::Mirroring::Horizontal };
+
+      m_console.set_mirroring(Mirroring[m_control & 3]);
+
+      auto bank = m_prg & 0x0F;
+
+      switch ((m_control >> 2) & 3)
+      {
+      case 0:
+      case 1:
+        m_console.map_prg(0x8000, 0x8000, bank >> 1);
+        break;
+      case 2:
+        m_console.map_prg(0x8000, 0x4000, 0);
+        m_console.map_prg(0xC000, 0x4000, bank);
+        break;
+      default:
+        m_console.map_prg(0x8000, 0x4000, bank);
+        m_console.map_prg(0xC000, 0x4000, prg_banks(0x4000) - 1);
+        break;
+      }
+
+      if (m_control & 0x10)
+      {
+        m_console.map_chr(0x0000, 0x1000, m_chr0);
+        m_console.map_chr(0x1000, 0x1000, m_chr1);
+      }
+      else
+      {
+        m_console.map_chr(0x0000, 0x2000, m_chr0 >> 1);
+      }
+    }
+
+  public:
+    explicit MMC1(NES& console) : Mapper(console), m_shift(0), m_count(0), m_control(0x0C), m_chr0(0), m_chr1(0), m_prg(0) {}
+
+    void reset() override
+    {
+      m_shift = 0;
+      m_count = 0;
+      m_control = 0x0C;
+      m_chr0 = m_chr1 = m_prg = 0;
+
+      take_writes(this);
+      update();
+    }
+
+    void write(uint8_t value, uint16_t address)
+    {
+      if (value & 0x80)
+      {
+        m_shift = 0;
+        m_count = 0;
+        m_control |= 0x0C;
+        update();
+        return;
+      }
+
+      m_shift |= (value & 1) << m_count;
+
+      if (++m_count < 5)
+      {
+        return;
+      }
+
+      switch ((address >> 13) & 3)
+      {
+      case 0:
+        m_control = m_shift;
+        break;
+      case 1:
+        m_chr0 = m_shift;
+        break;
+      case 2:
+        m_chr1 = m_shift;
+        break;
+      default:
+        m_prg = m_shift;
+        break;
+      }
+
+      m_shift = 0;
+      m_count = 0;
+      update();
+    }
+  };
+
+  //  8K PRG and 1K/2K CHR banks, plus a counter of scanline clocks that
+  //  raises IRQ when it reaches zero. The counter isn't clocked: it is brought
+  //  up to date from the PPU's clock count whenever it matters, and the IRQ is
+  //  a scheduled event at the clock that will take it to zero.
+  class MMC3 final : public Mapper
+  {
+    std::array<uint8_t, 8> m_banks;
+    uint8_t m_select;
+    uint8_t m_latch;
+    uint8_t m_counter;
+    bool m_irq_enabled;
+    bool m_rendering;     //  Whether clocks since m_clock counted
+    uint64_t m_clock;
+
+    void update_banks()
+    {
+      auto last = prg_banks(0x2000) - 1;
+      uint16_t swap = (m_select & 0x40) ? 0x4000 : 0;
+
+      m_console.map_prg(0x8000 ^ swap, 0x2000, m_banks[6]);
+      m_console.map_prg(0xA000, 0x2000, m_banks[7]);
+      m_console.map_prg(0xC000 ^ swap, 0x2000, last - 1);
+      m_console.map_prg(0xE000, 0x2000, last);
+
+      uint16_t invert = (m_select & 0x80) ? 0x1000 : 0;
+
+      m_console.map_chr(0x0000 ^ invert, 0x0400, m_banks[0] & 0xFE);
+      m_console.map_chr(0x0400 ^ invert, 0x0400, m_banks[0] | 0x01);
+      m_console.map_chr(0x0800 ^ invert, 0x0400, m_banks[1] & 0xFE);
+      m_console.map_chr(0x0C00 ^ invert, 0x0400, m_banks[1] | 0x01);
+
+      for (uint16_t i = 0; i < 4; ++i)
+      {
+        m_console.map_chr((0x1000 + i * 0x400) ^ invert, 0x0400, m_banks[2 + i]);
+      }
+    }
+
+    //  Applies the clocks seen since the last update. Past zero the counter
+    //  reloads from the latch, so it repeats every latch + 1 clocks.
+    void count()
+    {
+      auto& ppu = m_console.ppu();
+      ppu.catch_up(m_console.cpu().cycles());
+
+      auto now = ppu.scanline_clocks();
+      auto clocks = m_rendering ? now - m_clock : 0;
+      m_clock = now;
+      m_rendering = ppu.rendering();
+
+      if (clocks == 0)
+      {
+        return;
+      }
+
+      uint64_t until_zero = m_counter ? m_counter : m_latch + 1;
+
+      if (clocks < until_zero)
+      {
+        m_counter = static_cast<uint8_t>(m_counter ? m_counter - clocks : m_latch - (clocks - 1));
+        return;
+      }
+
+      auto rest = clocks - until_zero;
+      m_counter = static_cast<uint8_t>(rest ? m_latch - (rest - 1) % (m_latch + 1) : 0);
+
+      if (m_irq_enabled)
+      {
+        m_console.cpu().trigger_irq();
+      }
+    }
+
+    void schedule_irq()
+    {
+      auto& scheduler = m_console.scheduler();
+
+      if (!m_irq_enabled || !m_rendering)
+      {
+        scheduler.cancel(Scheduler::MapperIRQ);
+        return;
+      }
+
+      uint64_t until_zero = m_counter ? m_counter : m_latch + 1;
+      scheduler.schedule(Scheduler::MapperIRQ, m_console.ppu().scanline_clock_cycle(m_clock + until_zero - 1));
+      m_console.events_changed();
+    }
+
+  public:
+    explicit MMC3(NES& console) : Mapper(console), m_banks{}, m_select(0), m_latch(0), m_counter(0),
+      m_irq_enabled(false), m_rendering(false), m_clock(0) {}
+
+    void reset() override
+    {
+      m_banks = { { 0, 2, 4, 5, 6, 7, 0, 1 } };
+      m_select = 0;
+      m_latch = 0;
+      m_counter = 0;
+      m_irq_enabled = false;
+      m_rendering = m_console.ppu().rendering();
+      m_clock = m_console.ppu().scanline_clocks();
+
+      take_writes(this);
+      update_banks();
+      header_mirroring();
+      schedule_irq();
+    }
+
+    void sync() override
+    {
+      count();
+      schedule_irq();
+    }
+
+    void write(uint8_t value, uint16_t address)
+    {
+      switch (address & 0xE001)
+      {
+      case 0x8000:
+        m_select = value;
+        update_banks();
+        break;
+      case 0x8001:
+        m_banks[m_select & 7] = value;
+        update_banks();
+        break;
+      case 0xA000:
+        if (!m_console.cartridge().header().four_screen())
+        {
+          m_console.set_mirroring((value & 1) ? PPU::Mirroring::Horizontal : PPU::Mirroring::Vertical);
+        }
+        break;
+      case 0xC000:
+        count();
+        m_latch = value;
+        schedule_irq();
+        break;
+      case 0xC001:
+        //  Cleared, so the next clock reloads it
+        count();
+        m_counter = 0;
+        schedule_irq();
+        break;
+      case 0xE000:
+        //  Also acknowledges an IRQ that hasn't been taken yet
+        count();
+        m_irq_enabled = false;
+        m_console.cpu().clear_irq();
+        schedule_irq();
+        break;
+      case 0xE001:
+        count();
+        m_irq_enabled = true;
+        schedule_irq();
+        break;
+      default:
+        //  $A001 protects PRG RAM, which is always enabled here
+        break;
+      }
+    }
+  };
+}
+
+Mapper::Mapper(NES& console) : m_console(console)
+{
+}
+
+std::unique_ptr<Mapper> Mapper::create(NES& console)
+{
+  switch (static_cast<Number>(console.cartridge().header().mapper()))
+  {
+  case Number::NROM:
+    return std::make_unique<NROM>(console);
+  case Number::MMC1:
+    return std::make_unique<MMC1>(console);
+  case Number::UxROM:
+    return std::make_unique<UxROM>(console);
+  case Number::CNROM:
+    return std::make_unique<CNROM>(console);
+  case Number::MMC3:
+    return std::make_unique<MMC3>(console);
+  default:
+    throw std::invalid_argument("Unsupported mapper");
+  }
+}
+
+bool Mapper::supported(uint16_t number)
+{
+  switch (static_cast<Number>(number))
+  {
+  case Number::NROM:
+  case Number::MMC1:
+  case Number::UxROM:
+  case Number::CNROM:
+  case Number::MMC3:
+    return true;
+  default:
+    return false;
+  }
+}
+
+template<typename Board>
+void Mapper::take_writes(Board* board)
+{
+  m_console.cpu().bus().map(0x8000, 0x8000, Bus::Handler{ &read_open_bus, &write_board<Board>, board });
+}
+
+size_t Mapper::prg_banks(size_t size) const
+{
+  return std::max<size_t>(1, m_console.cartridge().prg_rom().size / size);
+}
+
+void Mapper::header_mirroring()
+{
+  const auto& header = m_console.cartridge().header();
+  m_console.set_mirroring(header.four_screen() ? PPU::Mirroring::FourScreen :
+    header.vertical_mirroring() ? PPU::Mirroring::Vertical : PPU::Mirroring::Horizontal);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class NES;
+
+//  Cartridge boards. Reads never reach a mapper: its PRG and CHR banks are
+//  mapped as memory and switching one swaps pointers in the bus or the PPU.
+//  Only writes to $8000-$FFFF come here, through a bus handler bound to the
+//  concrete board when the cartridge is loaded, so no access goes through a
+//  virtual call.
+class Mapper
+{
+public:
+  //  iNES mapper numbers
+  enum class Number : uint16_t
+  {
+    NROM = 0,
+    MMC1 = 1,
+    UxROM = 2,
+    CNROM = 3,
+    MMC3 = 4
+  };
+
+  virtual ~Mapper() {}
+
+  //  Builds the board named in the cartridge header, or throws for one that
+  //  isn't supported.
+  static std::unique_ptr<Mapper> create(NES& console);
+  static bool supported(uint16_t number);
+
+  //  Maps the power-on banks and takes over writes to $8000-$FFFF.
+  virtual void reset() = 0;
+
+  //  Brings anything clocked by the PPU up to date. Called when rendering is
+  //  switched on or off and when the MapperIRQ event fires.
+  virtual void sync() {}
+
+protected:
+  NES& m_console;
+
+  explicit Mapper(NES& console);
+
+  template<typename Board> void take_writes(Board* board);
+  size_t prg_banks(size_t size) const;
+  void header_mirroring();
+};
@@ -1,37 +1,267 @@
 #include "nes.h"
 
-NES::NES()
+#include <algorithm>
+
+NES::NES() : m_cpu(*this), m_ppu(*this), m_ram{}, m_prg_ram{}, m_deadline(Scheduler::Never), m_dma_page(0)
 {
-  m_cart = nullptr;
-  m_cpu = std::make_shared<CPU>(self());
-  m_ppu = std::make_shared<PPU>(self());
+  map_memory();
+  schedule_ppu_events();
 }
 
 NES::NES(std::string filename) : NES()
 {
-  m_cart = std::make_shared<Cartridge>(filename);
-  m_cpu->load_rom(m_cart->prg_rom());
+  load_cartridge(Cartridge(filename));
+}
+
+void NES::load_cartridge(Cartridge cart)
+{
+  m_cart = std::move(cart);
+  map_prg_ram();
+
+  m_scheduler.cancel(Scheduler::MapperIRQ);
+  m_mapper = Mapper::create(*this);
+  m_mapper->reset();
+  m_cpu.reset();
+}
+
+void NES::map_memory()
+{
+  auto& bus = m_cpu.bus();
+
+  //  2K of RAM repeats up to $1FFF.
+  for (uint16_t address = 0; address < 0x2000; address += RAMSize)
+  {
+    bus.map(address, RAMSize, m_ram.data());
+  }
+
+  //  PPU registers repeat every eight bytes up to $3FFF and the APU and I/O
+  //  registers follow. read_io and write_io sort them out.
+  bus.map(0x2000, 0x2100, Bus::Handler{ &NES::read_register, &NES::write_register, this });
+  bus.unmap(0x4100, 0x1F00);
+  bus.map(0x6000, PRGRAMSize, m_prg_ram.data());
+  bus.unmap(0x8000, 0x8000);
+}
+
+//  Boards with more battery RAM than the window only show its first 8K, and
+//  less repeats to fill it. A trainer is loaded into the RAM at $7000, which
+//  is where the copiers that added them kept it.
+void NES::map_prg_ram()
+{
+  m_save.reset();
+
+  auto size = static_cast<size_t>(m_cart.header().prg_nvram_size());
+
+  if (!m_cart.header().battery() || size == 0 || m_cart.filename().empty())
+  {
+    m_cpu.bus().map(0x6000, PRGRAMSize, m_prg_ram.data());
+  }
+  else
+  {
+    size = std::max(size, size_t{ Bus::PageSize });
+    m_save.reset(new SaveFile(SaveFile::path_for(m_cart.filename()), size));
+
+    auto window = std::min(size, size_t{ PRGRAMSize });
+
+    for (size_t offset = 0; offset < PRGRAMSize; offset += window)
+    {
+      m_cpu.bus().map(static_cast<uint16_t>(0x6000 + offset), window, m_save->data());
+    }
+  }
+
+  auto trainer = m_cart.trainer();
+
+  for (size_t offset = 0; offset < trainer.size; ++offset)
+  {
+    m_cpu.bus().write(trainer.data[offset], static_cast<uint16_t>(TrainerAddress + offset));
+  }
+}
+
+//  Banks are views into the cartridge, so switching one only swaps pointers.
+void NES::map_prg(uint16_t address, size_t size, size_t bank)
+{
+  auto prg = m_cart.prg_rom();
+
+  if (!prg.size)
+  {
+    return;
+  }
+
+  for (size_t offset = 0; offset < size; offset += std::min(size, prg.size))
+  {
+    m_cpu.bus().map(static_cast<uint16_t>(address + offset), std::min(size, prg.size), prg.bank(bank, size));
+  }
+}
+
+//  The PPU is caught up first so the dots before the switch are drawn from
+//  the old banks, and sprite 0 may now hit somewhere else.
+void NES::map_chr(uint16_t address, size_t size, size_t bank)
+{
+  auto chr = m_cart.chr_rom();
+  m_ppu.catch_up(m_cpu.cycles());
+
+  if (!chr.size)
+  {
+    m_ppu.map_chr_ram();
+  }
+  else
+  {
+    for (size_t offset = 0; offset < size; offset += std::min(size, chr.size))
+    {
+      m_ppu.map_chr(static_cast<uint16_t>(address + offset), std::min(size, chr.size), chr.bank(bank, size));
+    }
+  }
+
+  schedule_ppu_events();
+  events_changed();
+}
+
+void NES::set_mirroring(PPU::Mirroring mirroring)
+{
+  m_ppu.catch_up(m_cpu.cycles());
+  m_ppu.set_mirroring(mirroring);
+  schedule_ppu_events();
+  events_changed();
 }
 
-std::shared_ptr<CPU> NES::cpu() const
+uint8_t NES::read_register(void* console, uint16_t address)
 {
-  return m_cpu;
+  return static_cast<NES*>(console)->read_io(address);
 }
 
-std::shared_ptr<PPU> NES::ppu() const
+void NES::write_register(void* console, uint8_t value, uint16_t address)
 {
-  return m_ppu;
+  static_cast<NES*>(console)->write_io(value, address);
 }
 
-uint64_t NES::step() const
+void NES::schedule_ppu_events()
 {
-  auto cpu_cycles = m_cpu->step();
-  auto ppu_cycles = cpu_cycles * 3;
+  m_scheduler.schedule(Scheduler::VBlank, m_ppu.next_vblank());
+  m_scheduler.schedule(Scheduler::FrameEnd, m_ppu.next_frame_end());
+  m_scheduler.schedule(Scheduler::SpriteZero, m_ppu.next_sprite_event());
+}
 
-  for (auto i = 0; i < ppu_cycles; ++i)
+void NES::dispatch_events()
+{
+  auto now = m_cpu.cycles();
+
+  for (auto event = m_scheduler.pop(now); event != Scheduler::None; event = m_scheduler.pop(now))
   {
-    m_ppu->step();
+    switch (event)
+    {
+    case Scheduler::VBlank:
+      m_ppu.catch_up(now);
+
+      if (m_ppu.nmi_enabled())
+      {
+        m_cpu.trigger_nmi();
+      }
+
+      schedule_ppu_events();
+      break;
+    case Scheduler::SpriteZero:
+      m_ppu.catch_up(now);
+      schedule_ppu_events();
+      break;
+    case Scheduler::FrameEnd:
+      m_ppu.catch_up(now);
+      schedule_ppu_events();
+
+      if (m_save)
+      {
+        m_save->flush();
+      }
+      break;
+    case Scheduler::MapperIRQ:
+      m_mapper->sync();
+      break;
+    case Scheduler::DMA:
+      m_ppu.catch_up(now);
+      m_ppu.write_oam(m_cpu.read_bytes(m_dma_page << 8, 0x100));
+      schedule_ppu_events();
+      break;
+    default:
+      break;
+    }
   }
+}
 
+uint64_t NES::step()
+{
+  auto cpu_cycles = m_cpu.step();
+  dispatch_events();
   return cpu_cycles;
 }
+
+uint64_t NES::run_until(uint64_t target_cycle)
+{
+  auto start_cycles = m_cpu.cycles();
+
+  while (m_cpu.cycles() < target_cycle)
+  {
+    m_deadline = std::min(target_cycle, m_scheduler.next());
+    m_cpu.run_until(m_deadline);
+    dispatch_events();
+  }
+
+  return m_cpu.cycles() - start_cycles;
+}
+
+uint64_t NES::run_frame()
+{
+  auto start_cycles = m_cpu.cycles();
+  auto frame = m_ppu.frame();
+
+  while (m_ppu.frame() == frame)
+  {
+    m_deadline = m_scheduler.next();
+    m_cpu.run_until(m_deadline);
+    dispatch_events();
+  }
+
+  return m_cpu.cycles() - start_cycles;
+}
+
+void NES::events_changed()
+{
+  if (m_scheduler.next() < m_deadline)
+  {
+    m_cpu.stop();
+  }
+}
+
+void NES::write_io(uint8_t value, uint16_t address)
+{
+  if (address < 0x4000)
+  {
+    m_ppu.catch_up(m_cpu.cycles());
+
+    bool nmi = m_ppu.nmi_enabled();
+    m_ppu.write_register(value, address);
+
+    //  Scanline counters only run while rendering.
+    if (m_mapper && (address & 7) == 1)
+    {
+      m_mapper->sync();
+    }
+
+    //  Enabling NMI during VBlank raises it straight away.
+    if (!nmi && m_ppu.nmi_enabled() && m_ppu.in_vblank())
+    {
+      m_cpu.trigger_nmi();
+    }
+
+    schedule_ppu_events();
+    events_changed();
+  }
+  else if (address == OAMDMA)
+  {
+    //  The CPU is halted for the copy, one extra cycle when it starts on an
+    //  odd cycle. OAM is filled in once the transfer is done, which has to
+    //  end the slice so the page is copied before the CPU runs on.
+    auto stall = 513 + (m_cpu.cycles() & 1);
+    m_dma_page = value;
+    m_cpu.stall(stall);
+    m_scheduler.schedule(Scheduler::DMA, m_cpu.cycles() + stall);
+    events_changed();
+  }
+}
@@ -1,30 +1,115 @@
 #pragma once
 
+#include <array>
+
 #include "cartridge.h"
 #include "cpu.h"
+#include "mapper.h"
 #include "ppu.h"
+#include "save_file.h"
+#include "scheduler.h"
 
-#include <memory>
+//  Runs the CPU in slices that end on the next scheduled event. The PPU is
+//  only brought up to date when the CPU touches its registers or one of its
+//  events fires.
+//
+//  Components are held by value and keep a plain pointer back to the console,
+//  so a console is one object and can not be copied or moved.
+//
+//  The CPU bus is mapped once per cartridge: RAM and PRG go straight to memory
+//  and only the register pages at $2000-$40FF and mapper writes reach a
+//  handler. Battery backed PRG RAM at $6000 is the cartridge's save file,
+//  mapped like any other memory.
+class NES
+{
+  static const size_t RAMSize = 0x800;
+  static const size_t PRGRAMSize = 0x2000;
+  static const uint16_t TrainerAddress = 0x7000;
 
-class CPU;
-class PPU;
+  Cartridge m_cart;
+  CPU m_cpu;
+  PPU m_ppu;
+  std::unique_ptr<Mapper> m_mapper;
 
-class NES : std::enable_shared_from_this<NES>
-{
-  std::shared_ptr<Cartridge> m_cart;
-  std::shared_ptr<CPU> m_cpu;
-  std::shared_ptr<PPU> m_ppu;
+  std::array<uint8_t, RAMSize> m_ram;
+  std::array<uint8_t, PRGRAMSize> m_prg_ram;
+  std::unique_ptr<SaveFile> m_save;   //  Battery RAM of a cartridge loaded from a file
 
-  std::shared_ptr<NES> self()
-  {
-    return shared_from_this();
-  }
+  Scheduler m_scheduler;
+  uint64_t m_deadline;    //  End of the slice the CPU is running
+  uint8_t m_dma_page;
+
+  void map_memory();
+  void map_prg_ram();
+  void schedule_ppu_events();
+  void dispatch_events();
+
+  static uint8_t read_register(void* console, uint16_t address);
+  static void write_register(void* console, uint8_t value, uint16_t address);
 public:
+  static const uint16_t OAMDMA = 0x4014;
+
   NES();
   explicit NES(std::string filename);
 
-  inline std::shared_ptr<CPU> cpu() const;
-  inline std::shared_ptr<PPU> ppu() const;
+  //  Sets up the cartridge's mapper and resets the CPU. A battery backed
+  //  cartridge loaded from a file gets its save file next to the ROM.
+  void load_cartridge(Cartridge cart);
+
+  //  Maps bank number bank, counted in units of size, from the cartridge's
+  //  PRG or CHR. ROM smaller than the window repeats to fill it. Without CHR
+  //  ROM the pattern tables stay CHR RAM.
+  void map_prg(uint16_t address, size_t size, size_t bank);
+  void map_chr(uint16_t address, size_t size, size_t bank);
+
+  //  Nametable mirroring set by the mapper, from the dot it is written on.
+  void set_mirroring(PPU::Mirroring mirroring);
+
+  NES(const NES&) = delete;
+  NES& operator=(const NES&) = delete;
+
+  inline CPU& cpu() { return m_cpu; }
+  inline PPU& ppu() { return m_ppu; }
+  inline const Cartridge& cartridge() const { return m_cart; }
+  inline Scheduler& scheduler() { return m_scheduler; }
+
+  //  Called after the CPU's own accesses scheduled something, so a slice
+  //  that would run past the new event ends at it instead.
+  void events_changed();
+
+  //  Executes a single instruction and handles any event it reached.
+  uint64_t step();
+
+  //  Runs until the CPU reaches target_cycle, handling events on the way,
+  //  and returns the CPU cycles used. Frame ends don't stop it.
+  uint64_t run_until(uint64_t target_cycle);
+
+  //  Runs until the current frame has ended and returns the CPU cycles used.
+  uint64_t run_frame();
+
+  //  CPU accesses to $2000-$40FF.
+  inline uint8_t read_io(uint16_t address);
+  void write_io(uint8_t value, uint16_t address);
+
+  //  Draws one frame in interval and runs the ones between headless, which
+  //  costs no pixels and changes nothing else the program sees.
+  inline void set_frame_skip(uint32_t interval) { m_ppu.set_frame_skip(interval); }
+
+  //  Frames completed, and the ones among them drawn to the frame buffer.
+  inline uint64_t frames_emulated() const { return m_ppu.frame(); }
+  inline uint64_t frames_rendered() const { return m_ppu.frames_drawn(); }
+
+  //  Changes whenever an I/O read had a side effect.
+  inline uint32_t io_changes() const { return m_ppu.changes(); }
+};
+
+uint8_t NES::read_io(uint16_t address)
+{
+  if (address < 0x4000)
+  {
+    m_ppu.catch_up(m_cpu.cycles());
+    return m_ppu.read_register(address);
+  }
 
-  uint64_t step() const;
-};
\ No newline at end of file
+  return 0;
+}
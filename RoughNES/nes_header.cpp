@@ -1,6 +1,9 @@
 #include "nes_header.h"
 
-NESHeader::NESHeader(std::vector<uint8_t>& header)
+#include <algorithm>
+#include <stdexcept>
+
+NESHeader::NESHeader(const uint8_t* header)
 {
   if (header[0] != 'N' ||
       header[1] != 'E' ||
@@ -10,28 +13,83 @@ NESHeader::NESHeader(std::vector<uint8_t>& header)
     throw std::invalid_argument("Not a valid NES ROM: Header is invalid.");
   }
 
-  m_prg_pages = header[4];
-  m_chr_pages = header[5];
+  m_is_nes2 = ((header[7] & 0x0C) >> 2) == 2;
+
+  //  Old dumps often carry a signature in bytes 7-15. An iNES header with any
+  //  of the last four bytes set has one, and only byte 6 can be trusted.
+  bool signed_header = !m_is_nes2 && (header[12] | header[13] | header[14] | header[15]) != 0;
+  uint8_t flags7 = signed_header ? 0 : header[7];
+  uint8_t flags8 = signed_header ? 0 : header[8];
+  uint8_t flags9 = signed_header ? 0 : header[9];
 
-  m_mapper_index = ((header[6] & 0xF0) >> 4) | (header[7] & 0xF0);
+  m_mapper_index = ((header[6] & 0xF0) >> 4) | (flags7 & 0xF0);
 
   m_fourscreen = (header[6] & 0x08) > 0;
   m_trainer = (header[6] & 0x04) > 0;
   m_sram = (header[6] & 0x02) > 0;
   m_mirror = (header[6] & 0x01) > 0;
 
-  m_playchoice = (header[7] & 0x02) > 0;
-  m_vs_unisystem = (header[7] & 0x01) > 0;
+  m_playchoice = (flags7 & 0x02) > 0;
+  m_vs_unisystem = (flags7 & 0x01) > 0;
 
   m_submapper = 0;
-
-  m_is_nes2 = ((header[7] & 0x0C) >> 2) == 2;
+  m_misc_roms = 0;
 
   if (m_is_nes2)
   {
-    m_prg_pages |= ((header[9] & 0x0F) << 8);
-    m_chr_pages |= ((header[9] >> 4) << 8);
     m_mapper_index |= ((header[8] & 0x0F) << 8);
     m_submapper = header[8] >> 4;
+
+    m_prg_size = rom_size(header[4], header[9] & 0x0F, PRGPageSize);
+    m_chr_size = rom_size(header[5], header[9] >> 4, CHRPageSize);
+    m_prg_ram_size = ram_size(header[10] & 0x0F);
+    m_prg_nvram_size = ram_size(header[10] >> 4);
+    m_chr_ram_size = ram_size(header[11] & 0x0F);
+    m_chr_nvram_size = ram_size(header[11] >> 4);
+    m_timing = static_cast<Timing>(header[12] & 0x03);
+    m_misc_roms = header[14] & 0x03;
   }
+  else
+  {
+    m_prg_size = header[4] * PRGPageSize;
+    m_chr_size = header[5] * CHRPageSize;
+
+    //  8K of PRG RAM unless the header asks for more, battery backed if the
+    //  flag says so, and 8K of CHR RAM without CHR ROM.
+    uint32_t prg_ram = (flags8 ? flags8 : 1) * 0x2000;
+    m_prg_ram_size = m_sram ? 0 : prg_ram;
+    m_prg_nvram_size = m_sram ? prg_ram : 0;
+    m_chr_ram_size = m_chr_size ? 0 : CHRPageSize;
+    m_chr_nvram_size = 0;
+    m_timing = (flags9 & 0x01) ? Timing::PAL : Timing::NTSC;
+  }
+
+  m_prg_pages = static_cast<uint16_t>(m_prg_size / PRGPageSize);
+  m_chr_pages = static_cast<uint16_t>(m_chr_size / CHRPageSize);
+}
+
+//  NES 2.0 sizes are counted in pages up to $EFF. A high nibble of $F instead
+//  gives 2^E * (M * 2 + 1) bytes, with E and M packed into the low byte.
+uint32_t NESHeader::rom_size(uint8_t low, uint8_t high, uint32_t unit)
+{
+  if (high != 0x0F)
+  {
+    return ((high << 8) | low) * unit;
+  }
+
+  //  Anything past 4G can't be in the file, so it saturates and fails to load.
+  auto exponent = low >> 2;
+
+  if (exponent >= 32)
+  {
+    return UINT32_MAX;
+  }
+
+  auto size = (uint64_t{ 1 } << exponent) * ((low & 0x03) * 2 + 1);
+  return static_cast<uint32_t>(std::min<uint64_t>(size, UINT32_MAX));
+}
+
+uint32_t NESHeader::ram_size(uint8_t shift)
+{
+  return shift ? 64u << shift : 0;
 }
@@ -1,9 +1,24 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
+//  iNES and NES 2.0 headers. Sizes are in bytes and already account for the
+//  defaults iNES leaves implied, so callers don't need to know which format
+//  the file used.
 class NESHeader
 {
+public:
+  enum class Timing : uint8_t
+  {
+    NTSC,
+    PAL,
+    Multiple,
+    Dendy
+  };
+
+private:
   bool m_is_nes2;
   uint16_t m_prg_pages;
   uint16_t m_chr_pages;
@@ -16,12 +31,49 @@ class NESHeader
   bool m_vs_unisystem;
 
   uint8_t m_submapper;
+  uint8_t m_misc_roms;
+
+  uint32_t m_prg_size;
+  uint32_t m_chr_size;
+  uint32_t m_prg_ram_size;
+  uint32_t m_prg_nvram_size;
+  uint32_t m_chr_ram_size;
+  uint32_t m_chr_nvram_size;
+  Timing m_timing;
+
+  static uint32_t rom_size(uint8_t low, uint8_t high, uint32_t unit);
+  static uint32_t ram_size(uint8_t shift);
 public:
   static const size_t Size = 0x10;
+  static const uint32_t PRGPageSize = 0x4000;
+  static const uint32_t CHRPageSize = 0x2000;
+  static const uint32_t TrainerSize = 0x200;
 
   NESHeader(){};
-  explicit NESHeader(std::vector<uint8_t>& header);
+  explicit NESHeader(const uint8_t* header);
 
+  inline bool is_nes2() const { return m_is_nes2; }
   inline uint16_t prg_pages() const { return m_prg_pages; }
   inline uint16_t chr_pages() const { return m_chr_pages; }
+  inline uint32_t prg_rom_size() const { return m_prg_size; }
+  inline uint32_t chr_rom_size() const { return m_chr_size; }
+
+  //  Volatile and battery backed RAM on the cartridge
+  inline uint32_t prg_ram_size() const { return m_prg_ram_size; }
+  inline uint32_t prg_nvram_size() const { return m_prg_nvram_size; }
+  inline uint32_t chr_ram_size() const { return m_chr_ram_size; }
+  inline uint32_t chr_nvram_size() const { return m_chr_nvram_size; }
+
+  inline uint16_t mapper() const { return m_mapper_index; }
+  inline uint8_t submapper() const { return m_submapper; }
+  inline bool vertical_mirroring() const { return m_mirror; }
+  inline bool four_screen() const { return m_fourscreen; }
+  inline bool battery() const { return m_sram; }
+  inline bool trainer() const { return m_trainer; }
+  inline bool vs_unisystem() const { return m_vs_unisystem; }
+  inline bool playchoice() const { return m_playchoice; }
+  inline Timing timing() const { return m_timing; }
+
+  //  NES 2.0 only: ROMs after CHR that aren't banked like PRG or CHR.
+  inline uint8_t misc_roms() const { return m_misc_roms; }
 };
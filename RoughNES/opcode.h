@@ -1,13 +1,11 @@
 #pragma once
 
 #include <cstdint>
-#include <vector>
 #include <ostream>
-#include <string>
 
 namespace Instruction
 {
-  enum AddressMode
+  enum AddressMode : uint8_t
   {
     Absolute,
     AbsoluteX,
@@ -24,283 +22,336 @@ namespace Instruction
     ZeroPageY
   };
 
+  //  Decode entry consulted on every step. Kept as a 4 byte POD so the whole
+  //  table fits in 16 cache lines and a lookup is a single load with no copies.
   struct Info
   {
-    uint8_t opcode;       //  Instruction opcode
-    std::string name;     //  Instruction name
+    AddressMode mode;     //  Addressing mode used by instruction
     uint8_t size;         //  Instruction size in bytes
     uint8_t cycles;       //  Instruction cycles used by instruction
     uint8_t page_cycles;  //  How many cycles are added if a page boundary is crossed
-    AddressMode mode;     //  Addressing mode used by instruction
 
     friend std::ostream& operator<<(std::ostream& os, const Info& obj)
     {
       return os
-        << "opcode: " << obj.opcode
-        << " name: " << obj.name
-        << " size: " << obj.size
+        << "size: " << obj.size
         << " cycles: " << obj.cycles
         << " page_cycles: " << obj.page_cycles
         << " mode: " << obj.mode;
     }
   };
 
-  static const std::vector<Info> Table = {
-    { 0x00, "BRK", 1, 7, 0, Implied },
-    { 0x01, "ORA", 2, 6, 0, IndirectX },
-    { 0x02, "KIL", 0, 2, 0, Implied },
-    { 0x03, "SLO", 0, 8, 0, IndirectX },
-    { 0x04, "NOP", 2, 3, 0, ZeroPage },
-    { 0x05, "ORA", 2, 3, 0, ZeroPage },
-    { 0x06, "ASL", 2, 5, 0, ZeroPage },
-    { 0x07, "SLO", 0, 5, 0, ZeroPage },
-    { 0x08, "PHP", 1, 3, 0, Implied },
-    { 0x09, "ORA", 2, 2, 0, Immediate },
-    { 0x0A, "ASL", 1, 2, 0, Accumulator },
-    { 0x0B, "ANC", 0, 2, 0, Immediate },
-    { 0x0C, "NOP", 3, 4, 0, Absolute },
-    { 0x0D, "ORA", 3, 4, 0, Absolute },
-    { 0x0E, "ASL", 3, 6, 0, Absolute },
-    { 0x0F, "SLO", 0, 6, 0, Absolute },
-    { 0x10, "BPL", 2, 2, 1, Relative },
-    { 0x11, "ORA", 2, 5, 1, IndirectY },
-    { 0x12, "KIL", 0, 2, 0, Implied },
-    { 0x13, "SLO", 0, 8, 0, IndirectY },
-    { 0x14, "NOP", 2, 4, 0, ZeroPageX },
-    { 0x15, "ORA", 2, 4, 0, ZeroPageX },
-    { 0x16, "ASL", 2, 6, 0, ZeroPageX },
-    { 0x17, "SLO", 0, 6, 0, ZeroPageX },
-    { 0x18, "CLC", 1, 2, 0, Implied },
-    { 0x19, "ORA", 3, 4, 1, AbsoluteY },
-    { 0x1A, "NOP", 1, 2, 0, Implied },
-    { 0x1B, "SLO", 0, 7, 0, AbsoluteY },
-    { 0x1C, "NOP", 3, 4, 1, AbsoluteX },
-    { 0x1D, "ORA", 3, 4, 1, AbsoluteX },
-    { 0x1E, "ASL", 3, 7, 0, AbsoluteX },
-    { 0x1F, "SLO", 0, 7, 0, AbsoluteX },
-    { 0x20, "JSR", 3, 6, 0, Absolute },
-    { 0x21, "AND", 2, 6, 0, IndirectX },
-    { 0x22, "KIL", 0, 2, 0, Implied },
-    { 0x23, "RLA", 0, 8, 0, IndirectX },
-    { 0x24, "BIT", 2, 3, 0, ZeroPage },
-    { 0x25, "AND", 2, 3, 0, ZeroPage },
-    { 0x26, "ROL", 2, 5, 0, ZeroPage },
-    { 0x27, "RLA", 0, 5, 0, ZeroPage },
-    { 0x28, "PLP", 1, 4, 0, Implied },
-    { 0x29, "AND", 2, 2, 0, Immediate },
-    { 0x2A, "ROL", 1, 2, 0, Accumulator },
-    { 0x2B, "ANC", 0, 2, 0, Immediate },
-    { 0x2C, "BIT", 3, 4, 0, Absolute },
-    { 0x2D, "AND", 3, 4, 0, Absolute },
-    { 0x2E, "ROL", 3, 6, 0, Absolute },
-    { 0x2F, "RLA", 0, 6, 0, Absolute },
-    { 0x30, "BMI", 2, 2, 1, Relative },
-    { 0x31, "AND", 2, 5, 1, IndirectY },
-    { 0x32, "KIL", 0, 2, 0, Implied },
-    { 0x33, "RLA", 0, 8, 0, IndirectY },
-    { 0x34, "NOP", 2, 4, 0, ZeroPageX },
-    { 0x35, "AND", 2, 4, 0, ZeroPageX },
-    { 0x36, "ROL", 2, 6, 0, ZeroPageX },
-    { 0x37, "RLA", 0, 6, 0, ZeroPageX },
-    { 0x38, "SEC", 1, 2, 0, Implied },
-    { 0x39, "AND", 3, 4, 1, AbsoluteY },
-    { 0x3A, "NOP", 1, 2, 0, Implied },
-    { 0x3B, "RLA", 0, 7, 0, AbsoluteY },
-    { 0x3C, "NOP", 3, 4, 1, AbsoluteX },
-    { 0x3D, "AND", 3, 4, 1, AbsoluteX },
-    { 0x3E, "ROL", 3, 7, 0, AbsoluteX },
-    { 0x3F, "RLA", 0, 7, 0, AbsoluteX },
-    { 0x40, "RTI", 1, 6, 0, Implied },
-    { 0x41, "EOR", 2, 6, 0, IndirectX },
-    { 0x42, "KIL", 0, 2, 0, Implied },
-    { 0x43, "SRE", 0, 8, 0, IndirectX },
-    { 0x44, "NOP", 2, 3, 0, ZeroPage },
-    { 0x45, "EOR", 2, 3, 0, ZeroPage },
-    { 0x46, "LSR", 2, 5, 0, ZeroPage },
-    { 0x47, "SRE", 0, 5, 0, ZeroPage },
-    { 0x48, "PHA", 1, 3, 0, Implied },
-    { 0x49, "EOR", 2, 2, 0, Immediate },
-    { 0x4A, "LSR", 1, 2, 0, Accumulator },
-    { 0x4B, "ALR", 0, 2, 0, Immediate },
-    { 0x4C, "JMP", 3, 3, 0, Absolute },
-    { 0x4D, "EOR", 3, 4, 0, Absolute },
-    { 0x4E, "LSR", 3, 6, 0, Absolute },
-    { 0x4F, "SRE", 0, 6, 0, Absolute },
-    { 0x50, "BVC", 2, 2, 1, Relative },
-    { 0x51, "EOR", 2, 5, 1, IndirectY },
-    { 0x52, "KIL", 0, 2, 0, Implied },
-    { 0x53, "SRE", 0, 8, 0, IndirectY },
-    { 0x54, "NOP", 2, 4, 0, ZeroPageX },
-    { 0x55, "EOR", 2, 4, 0, ZeroPageX },
-    { 0x56, "LSR", 2, 6, 0, ZeroPageX },
-    { 0x57, "SRE", 0, 6, 0, ZeroPageX },
-    { 0x58, "CLI", 1, 2, 0, Implied },
-    { 0x59, "EOR", 3, 4, 1, AbsoluteY },
-    { 0x5A, "NOP", 1, 2, 0, Implied },
-    { 0x5B, "SRE", 0, 7, 0, AbsoluteY },
-    { 0x5C, "NOP", 3, 4, 1, AbsoluteX },
-    { 0x5D, "EOR", 3, 4, 1, AbsoluteX },
-    { 0x5E, "LSR", 3, 7, 0, AbsoluteX },
-    { 0x5F, "SRE", 0, 7, 0, AbsoluteX },
-    { 0x60, "RTS", 1, 6, 0, Implied },
-    { 0x61, "ADC", 2, 6, 0, IndirectX },
-    { 0x62, "KIL", 0, 2, 0, Implied },
-    { 0x63, "RRA", 0, 8, 0, IndirectX },
-    { 0x64, "NOP", 2, 3, 0, ZeroPage },
-    { 0x65, "ADC", 2, 3, 0, ZeroPage },
-    { 0x66, "ROR", 2, 5, 0, ZeroPage },
-    { 0x67, "RRA", 0, 5, 0, ZeroPage },
-    { 0x68, "PLA", 1, 4, 0, Implied },
-    { 0x69, "ADC", 2, 2, 0, Immediate },
-    { 0x6A, "ROR", 1, 2, 0, Accumulator },
-    { 0x6B, "ARR", 0, 2, 0, Immediate },
-    { 0x6C, "JMP", 3, 5, 0, Indirect },
-    { 0x6D, "ADC", 3, 4, 0, Absolute },
-    { 0x6E, "ROR", 3, 6, 0, Absolute },
-    { 0x6F, "RRA", 0, 6, 0, Absolute },
-    { 0x70, "BVS", 2, 2, 1, Relative },
-    { 0x71, "ADC", 2, 5, 1, IndirectY },
-    { 0x72, "KIL", 0, 2, 0, Implied },
-    { 0x73, "RRA", 0, 8, 0, IndirectY },
-    { 0x74, "NOP", 2, 4, 0, ZeroPageX },
-    { 0x75, "ADC", 2, 4, 0, ZeroPageX },
-    { 0x76, "ROR", 2, 6, 0, ZeroPageX },
-    { 0x77, "RRA", 0, 6, 0, ZeroPageX },
-    { 0x78, "SEI", 1, 2, 0, Implied },
-    { 0x79, "ADC", 3, 4, 1, AbsoluteY },
-    { 0x7A, "NOP", 1, 2, 0, Implied },
-    { 0x7B, "RRA", 0, 7, 0, AbsoluteY },
-    { 0x7C, "NOP", 3, 4, 1, AbsoluteX },
-    { 0x7D, "ADC", 3, 4, 1, AbsoluteX },
-    { 0x7E, "ROR", 3, 7, 0, AbsoluteX },
-    { 0x7F, "RRA", 0, 7, 0, AbsoluteX },
-    { 0x80, "NOP", 2, 2, 0, Immediate },
-    { 0x81, "STA", 2, 6, 0, IndirectX },
-    { 0x82, "NOP", 0, 2, 0, Immediate },
-    { 0x83, "SAX", 0, 6, 0, IndirectX },
-    { 0x84, "STY", 2, 3, 0, ZeroPage },
-    { 0x85, "STA", 2, 3, 0, ZeroPage },
-    { 0x86, "STX", 2, 3, 0, ZeroPage },
-    { 0x87, "SAX", 0, 3, 0, ZeroPage },
-    { 0x88, "DEY", 1, 2, 0, Implied },
-    { 0x89, "NOP", 0, 2, 0, Immediate },
-    { 0x8A, "TXA", 1, 2, 0, Implied },
-    { 0x8B, "XAA", 0, 2, 0, Immediate },
-    { 0x8C, "STY", 3, 4, 0, Absolute },
-    { 0x8D, "STA", 3, 4, 0, Absolute },
-    { 0x8E, "STX", 3, 4, 0, Absolute },
-    { 0x8F, "SAX", 0, 4, 0, Absolute },
-    { 0x90, "BCC", 2, 2, 1, Relative },
-    { 0x91, "STA", 2, 6, 0, IndirectY },
-    { 0x92, "KIL", 0, 2, 0, Implied },
-    { 0x93, "AHX", 0, 6, 0, IndirectY },
-    { 0x94, "STY", 2, 4, 0, ZeroPageX },
-    { 0x95, "STA", 2, 4, 0, ZeroPageX },
-    { 0x96, "STX", 2, 4, 0, ZeroPageY },
-    { 0x97, "SAX", 0, 4, 0, ZeroPageY },
-    { 0x98, "TYA", 1, 2, 0, Implied },
-    { 0x99, "STA", 3, 5, 0, AbsoluteY },
-    { 0x9A, "TXS", 1, 2, 0, Implied },
-    { 0x9B, "TAS", 0, 5, 0, AbsoluteY },
-    { 0x9C, "SHY", 0, 5, 0, AbsoluteX },
-    { 0x9D, "STA", 3, 5, 0, AbsoluteX },
-    { 0x9E, "SHX", 0, 5, 0, AbsoluteY },
-    { 0x9F, "AHX", 0, 5, 0, AbsoluteY },
-    { 0xA0, "LDY", 2, 2, 0, Immediate },
-    { 0xA1, "LDA", 2, 6, 0, IndirectX },
-    { 0xA2, "LDX", 2, 2, 0, Immediate },
-    { 0xA3, "LAX", 0, 6, 0, IndirectX },
-    { 0xA4, "LDY", 2, 3, 0, ZeroPage },
-    { 0xA5, "LDA", 2, 3, 0, ZeroPage },
-    { 0xA6, "LDX", 2, 3, 0, ZeroPage },
-    { 0xA7, "LAX", 0, 3, 0, ZeroPage },
-    { 0xA8, "TAY", 1, 2, 0, Implied },
-    { 0xA9, "LDA", 2, 2, 0, Immediate },
-    { 0xAA, "TAX", 1, 2, 0, Implied },
-    { 0xAB, "LAX", 0, 2, 0, Immediate },
-    { 0xAC, "LDY", 3, 4, 0, Absolute },
-    { 0xAD, "LDA", 3, 4, 0, Absolute },
-    { 0xAE, "LDX", 3, 4, 0, Absolute },
-    { 0xAF, "LAX", 0, 4, 0, Absolute },
-    { 0xB0, "BCS", 2, 2, 1, Relative },
-    { 0xB1, "LDA", 2, 5, 1, IndirectY },
-    { 0xB2, "KIL", 0, 2, 0, Implied },
-    { 0xB3, "LAX", 0, 5, 1, IndirectY },
-    { 0xB4, "LDY", 2, 4, 0, ZeroPageX },
-    { 0xB5, "LDA", 2, 4, 0, ZeroPageX },
-    { 0xB6, "LDX", 2, 4, 0, ZeroPageY },
-    { 0xB7, "LAX", 0, 4, 0, ZeroPageY },
-    { 0xB8, "CLV", 1, 2, 0, Implied },
-    { 0xB9, "LDA", 3, 4, 1, AbsoluteY },
-    { 0xBA, "TSX", 1, 2, 0, Implied },
-    { 0xBB, "LAS", 0, 4, 1, AbsoluteY },
-    { 0xBC, "LDY", 3, 4, 1, AbsoluteX },
-    { 0xBD, "LDA", 3, 4, 1, AbsoluteX },
-    { 0xBE, "LDX", 3, 4, 1, AbsoluteY },
-    { 0xBF, "LAX", 0, 4, 1, AbsoluteY },
-    { 0xC0, "CPY", 2, 2, 0, Immediate },
-    { 0xC1, "CMP", 2, 6, 0, IndirectX },
-    { 0xC2, "NOP", 0, 2, 0, Immediate },
-    { 0xC3, "DCP", 0, 8, 0, IndirectX },
-    { 0xC4, "CPY", 2, 3, 0, ZeroPage },
-    { 0xC5, "CMP", 2, 3, 0, ZeroPage },
-    { 0xC6, "DEC", 2, 5, 0, ZeroPage },
-    { 0xC7, "DCP", 0, 5, 0, ZeroPage },
-    { 0xC8, "INY", 1, 2, 0, Implied },
-    { 0xC9, "CMP", 2, 2, 0, Immediate },
-    { 0xCA, "DEX", 1, 2, 0, Implied },
-    { 0xCB, "AXS", 0, 2, 0, Immediate },
-    { 0xCC, "CPY", 3, 4, 0, Absolute },
-    { 0xCD, "CMP", 3, 4, 0, Absolute },
-    { 0xCE, "DEC", 3, 6, 0, Absolute },
-    { 0xCF, "DCP", 0, 6, 0, Absolute },
-    { 0xD0, "BNE", 2, 2, 1, Relative },
-    { 0xD1, "CMP", 2, 5, 1, IndirectY },
-    { 0xD2, "KIL", 0, 2, 0, Implied },
-    { 0xD3, "DCP", 0, 8, 0, IndirectY },
-    { 0xD4, "NOP", 2, 4, 0, ZeroPageX },
-    { 0xD5, "CMP", 2, 4, 0, ZeroPageX },
-    { 0xD6, "DEC", 2, 6, 0, ZeroPageX },
-    { 0xD7, "DCP", 0, 6, 0, ZeroPageX },
-    { 0xD8, "CLD", 1, 2, 0, Implied },
-    { 0xD9, "CMP", 3, 4, 1, AbsoluteY },
-    { 0xDA, "NOP", 1, 2, 0, Implied },
-    { 0xDB, "DCP", 0, 7, 0, AbsoluteY },
-    { 0xDC, "NOP", 3, 4, 1, AbsoluteX },
-    { 0xDD, "CMP", 3, 4, 1, AbsoluteX },
-    { 0xDE, "DEC", 3, 7, 0, AbsoluteX },
-    { 0xDF, "DCP", 0, 7, 0, AbsoluteX },
-    { 0xE0, "CPX", 2, 2, 0, Immediate },
-    { 0xE1, "SBC", 2, 6, 0, IndirectX },
-    { 0xE2, "NOP", 0, 2, 0, Immediate },
-    { 0xE3, "ISC", 0, 8, 0, IndirectX },
-    { 0xE4, "CPX", 2, 3, 0, ZeroPage },
-    { 0xE5, "SBC", 2, 3, 0, ZeroPage },
-    { 0xE6, "INC", 2, 5, 0, ZeroPage },
-    { 0xE7, "ISC", 0, 5, 0, ZeroPage },
-    { 0xE8, "INX", 1, 2, 0, Implied },
-    { 0xE9, "SBC", 2, 2, 0, Immediate },
-    { 0xEA, "NOP", 1, 2, 0, Implied },
-    { 0xEB, "SBC", 0, 2, 0, Immediate },
-    { 0xEC, "CPX", 3, 4, 0, Absolute },
-    { 0xED, "SBC", 3, 4, 0, Absolute },
-    { 0xEE, "INC", 3, 6, 0, Absolute },
-    { 0xEF, "ISC", 0, 6, 0, Absolute },
-    { 0xF0, "BEQ", 2, 2, 1, Relative },
-    { 0xF1, "SBC", 2, 5, 1, IndirectY },
-    { 0xF2, "KIL", 0, 2, 0, Implied },
-    { 0xF3, "ISC", 0, 8, 0, IndirectY },
-    { 0xF4, "NOP", 2, 4, 0, ZeroPageX },
-    { 0xF5, "SBC", 2, 4, 0, ZeroPageX },
-    { 0xF6, "INC", 2, 6, 0, ZeroPageX },
-    { 0xF7, "ISC", 0, 6, 0, ZeroPageX },
-    { 0xF8, "SED", 1, 2, 0, Implied },
-    { 0xF9, "SBC", 3, 4, 1, AbsoluteY },
-    { 0xFA, "NOP", 1, 2, 0, Implied },
-    { 0xFB, "ISC", 0, 7, 0, AbsoluteY },
-    { 0xFC, "NOP", 3, 4, 1, AbsoluteX },
-    { 0xFD, "SBC", 3, 4, 1, AbsoluteX },
-    { 0xFE, "INC", 3, 7, 0, AbsoluteX },
-    { 0xFF, "ISC", 0, 7, 0, AbsoluteX }
+  static_assert(sizeof(Info) == 4, "Instruction::Info must stay packed");
+
+  //  Number of operand bytes that follow the opcode for an addressing mode.
+  constexpr uint8_t operand_bytes(AddressMode mode)
+  {
+    return (mode == Absolute || mode == AbsoluteX || mode == AbsoluteY || mode == Indirect) ? 2
+      : (mode == Accumulator || mode == Implied) ? 0
+      : 1;
+  }
+
+  //  An instruction as fetched when a block was decoded. Shared by the block
+  //  cache and the recompiler.
+  struct Decoded
+  {
+    uint8_t opcode;     //  Selects the fused handler, which carries the addressing mode and cycle cost
+    uint16_t operand;   //  Operand bytes as fetched when the block was decoded
+  };
+
+  alignas(64) constexpr Info Table[] = {
+    { Implied,     1, 7, 0 },  //  0x00 BRK
+    { IndirectX,   2, 6, 0 },  //  0x01 ORA
+    { Implied,     0, 2, 0 },  //  0x02 KIL
+    { IndirectX,   0, 8, 0 },  //  0x03 SLO
+    { ZeroPage,    2, 3, 0 },  //  0x04 NOP
+    { ZeroPage,    2, 3, 0 },  //  0x05 ORA
+    { ZeroPage,    2, 5, 0 },  //  0x06 ASL
+    { ZeroPage,    0, 5, 0 },  //  0x07 SLO
+    { Implied,     1, 3, 0 },  //  0x08 PHP
+    { Immediate,   2, 2, 0 },  //  0x09 ORA
+    { Accumulator, 1, 2, 0 },  //  0x0A ASL
+    { Immediate,   0, 2, 0 },  //  0x0B ANC
+    { Absolute,    3, 4, 0 },  //  0x0C NOP
+    { Absolute,    3, 4, 0 },  //  0x0D ORA
+    { Absolute,    3, 6, 0 },  //  0x0E ASL
+    { Absolute,    0, 6, 0 },  //  0x0F SLO
+    { Relative,    2, 2, 1 },  //  0x10 BPL
+    { IndirectY,   2, 5, 1 },  //  0x11 ORA
+    { Implied,     0, 2, 0 },  //  0x12 KIL
+    { IndirectY,   0, 8, 0 },  //  0x13 SLO
+    { ZeroPageX,   2, 4, 0 },  //  0x14 NOP
+    { ZeroPageX,   2, 4, 0 },  //  0x15 ORA
+    { ZeroPageX,   2, 6, 0 },  //  0x16 ASL
+    { ZeroPageX,   0, 6, 0 },  //  0x17 SLO
+    { Implied,     1, 2, 0 },  //  0x18 CLC
+    { AbsoluteY,   3, 4, 1 },  //  0x19 ORA
+    { Implied,     1, 2, 0 },  //  0x1A NOP
+    { AbsoluteY,   0, 7, 0 },  //  0x1B SLO
+    { AbsoluteX,   3, 4, 1 },  //  0x1C NOP
+    { AbsoluteX,   3, 4, 1 },  //  0x1D ORA
+    { AbsoluteX,   3, 7, 0 },  //  0x1E ASL
+    { AbsoluteX,   0, 7, 0 },  //  0x1F SLO
+    { Absolute,    3, 6, 0 },  //  0x20 JSR
+    { IndirectX,   2, 6, 0 },  //  0x21 AND
+    { Implied,     0, 2, 0 },  //  0x22 KIL
+    { IndirectX,   0, 8, 0 },  //  0x23 RLA
+    { ZeroPage,    2, 3, 0 },  //  0x24 BIT
+    { ZeroPage,    2, 3, 0 },  //  0x25 AND
+    { ZeroPage,    2, 5, 0 },  //  0x26 ROL
+    { ZeroPage,    0, 5, 0 },  //  0x27 RLA
+    { Implied,     1, 4, 0 },  //  0x28 PLP
+    { Immediate,   2, 2, 0 },  //  0x29 AND
+    { Accumulator, 1, 2, 0 },  //  0x2A ROL
+    { Immediate,   0, 2, 0 },  //  0x2B ANC
+    { Absolute,    3, 4, 0 },  //  0x2C BIT
+    { Absolute,    3, 4, 0 },  //  0x2D AND
+    { Absolute,    3, 6, 0 },  //  0x2E ROL
+    { Absolute,    0, 6, 0 },  //  0x2F RLA
+    { Relative,    2, 2, 1 },  //  0x30 BMI
+    { IndirectY,   2, 5, 1 },  //  0x31 AND
+    { Implied,     0, 2, 0 },  //  0x32 KIL
+    { IndirectY,   0, 8, 0 },  //  0x33 RLA
+    { ZeroPageX,   2, 4, 0 },  //  0x34 NOP
+    { ZeroPageX,   2, 4, 0 },  //  0x35 AND
+    { ZeroPageX,   2, 6, 0 },  //  0x36 ROL
+    { ZeroPageX,   0, 6, 0 },  //  0x37 RLA
+    { Implied,     1, 2, 0 },  //  0x38 SEC
+    { AbsoluteY,   3, 4, 1 },  //  0x39 AND
+    { Implied,     1, 2, 0 },  //  0x3A NOP
+    { AbsoluteY,   0, 7, 0 },  //  0x3B RLA
+    { AbsoluteX,   3, 4, 1 },  //  0x3C NOP
+    { AbsoluteX,   3, 4, 1 },  //  0x3D AND
+    { AbsoluteX,   3, 7, 0 },  //  0x3E ROL
+    { AbsoluteX,   0, 7, 0 },  //  0x3F RLA
+    { Implied,     1, 6, 0 },  //  0x40 RTI
+    { IndirectX,   2, 6, 0 },  //  0x41 EOR
+    { Implied,     0, 2, 0 },  //  0x42 KIL
+    { IndirectX,   0, 8, 0 },  //  0x43 SRE
+    { ZeroPage,    2, 3, 0 },  //  0x44 NOP
+    { ZeroPage,    2, 3, 0 },  //  0x45 EOR
+    { ZeroPage,    2, 5, 0 },  //  0x46 LSR
+    { ZeroPage,    0, 5, 0 },  //  0x47 SRE
+    { Implied,     1, 3, 0 },  //  0x48 PHA
+    { Immediate,   2, 2, 0 },  //  0x49 EOR
+    { Accumulator, 1, 2, 0 },  //  0x4A LSR
+    { Immediate,   0, 2, 0 },  //  0x4B ALR
+    { Absolute,    3, 3, 0 },  //  0x4C JMP
+    { Absolute,    3, 4, 0 },  //  0x4D EOR
+    { Absolute,    3, 6, 0 },  //  0x4E LSR
+    { Absolute,    0, 6, 0 },  //  0x4F SRE
+    { Relative,    2, 2, 1 },  //  0x50 BVC
+    { IndirectY,   2, 5, 1 },  //  0x51 EOR
+    { Implied,     0, 2, 0 },  //  0x52 KIL
+    { IndirectY,   0, 8, 0 },  //  0x53 SRE
+    { ZeroPageX,   2, 4, 0 },  //  0x54 NOP
+    { ZeroPageX,   2, 4, 0 },  //  0x55 EOR
+    { ZeroPageX,   2, 6, 0 },  //  0x56 LSR
+    { ZeroPageX,   0, 6, 0 },  //  0x57 SRE
+    { Implied,     1, 2, 0 },  //  0x58 CLI
+    { AbsoluteY,   3, 4, 1 },  //  0x59 EOR
+    { Implied,     1, 2, 0 },  //  0x5A NOP
+    { AbsoluteY,   0, 7, 0 },  //  0x5B SRE
+    { AbsoluteX,   3, 4, 1 },  //  0x5C NOP
+    { AbsoluteX,   3, 4, 1 },  //  0x5D EOR
+    { AbsoluteX,   3, 7, 0 },  //  0x5E LSR
+    { AbsoluteX,   0, 7, 0 },  //  0x5F SRE
+    { Implied,     1, 6, 0 },  //  0x60 RTS
+    { IndirectX,   2, 6, 0 },  //  0x61 ADC
+    { Implied,     0, 2, 0 },  //  0x62 KIL
+    { IndirectX,   0, 8, 0 },  //  0x63 RRA
+    { ZeroPage,    2, 3, 0 },  //  0x64 NOP
+    { ZeroPage,    2, 3, 0 },  //  0x65 ADC
+    { ZeroPage,    2, 5, 0 },  //  0x66 ROR
+    { ZeroPage,    0, 5, 0 },  //  0x67 RRA
+    { Implied,     1, 4, 0 },  //  0x68 PLA
+    { Immediate,   2, 2, 0 },  //  0x69 ADC
+    { Accumulator, 1, 2, 0 },  //  0x6A ROR
+    { Immediate,   0, 2, 0 },  //  0x6B ARR
+    { Indirect,    3, 5, 0 },  //  0x6C JMP
+    { Absolute,    3, 4, 0 },  //  0x6D ADC
+    { Absolute,    3, 6, 0 },  //  0x6E ROR
+    { Absolute,    0, 6, 0 },  //  0x6F RRA
+    { Relative,    2, 2, 1 },  //  0x70 BVS
+    { IndirectY,   2, 5, 1 },  //  0x71 ADC
+    { Implied,     0, 2, 0 },  //  0x72 KIL
+    { IndirectY,   0, 8, 0 },  //  0x73 RRA
+    { ZeroPageX,   2, 4, 0 },  //  0x74 NOP
+    { ZeroPageX,   2, 4, 0 },  //  0x75 ADC
+    { ZeroPageX,   2, 6, 0 },  //  0x76 ROR
+    { ZeroPageX,   0, 6, 0 },  //  0x77 RRA
+    { Implied,     1, 2, 0 },  //  0x78 SEI
+    { AbsoluteY,   3, 4, 1 },  //  0x79 ADC
+    { Implied,     1, 2, 0 },  //  0x7A NOP
+    { AbsoluteY,   0, 7, 0 },  //  0x7B RRA
+    { AbsoluteX,   3, 4, 1 },  //  0x7C NOP
+    { AbsoluteX,   3, 4, 1 },  //  0x7D ADC
+    { AbsoluteX,   3, 7, 0 },  //  0x7E ROR
+    { AbsoluteX,   0, 7, 0 },  //  0x7F RRA
+    { Immediate,   2, 2, 0 },  //  0x80 NOP
+    { IndirectX,   2, 6, 0 },  //  0x81 STA
+    { Immediate,   0, 2, 0 },  //  0x82 NOP
+    { IndirectX,   0, 6, 0 },  //  0x83 SAX
+    { ZeroPage,    2, 3, 0 },  //  0x84 STY
+    { ZeroPage,    2, 3, 0 },  //  0x85 STA
+    { ZeroPage,    2, 3, 0 },  //  0x86 STX
+    { ZeroPage,    0, 3, 0 },  //  0x87 SAX
+    { Implied,     1, 2, 0 },  //  0x88 DEY
+    { Immediate,   0, 2, 0 },  //  0x89 NOP
+    { Implied,     1, 2, 0 },  //  0x8A TXA
+    { Immediate,   0, 2, 0 },  //  0x8B XAA
+    { Absolute,    3, 4, 0 },  //  0x8C STY
+    { Absolute,    3, 4, 0 },  //  0x8D STA
+    { Absolute,    3, 4, 0 },  //  0x8E STX
+    { Absolute,    0, 4, 0 },  //  0x8F SAX
+    { Relative,    2, 2, 1 },  //  0x90 BCC
+    { IndirectY,   2, 6, 0 },  //  0x91 STA
+    { Implied,     0, 2, 0 },  //  0x92 KIL
+    { IndirectY,   0, 6, 0 },  //  0x93 AHX
+    { ZeroPageX,   2, 4, 0 },  //  0x94 STY
+    { ZeroPageX,   2, 4, 0 },  //  0x95 STA
+    { ZeroPageY,   2, 4, 0 },  //  0x96 STX
+    { ZeroPageY,   0, 4, 0 },  //  0x97 SAX
+    { Implied,     1, 2, 0 },  //  0x98 TYA
+    { AbsoluteY,   3, 5, 0 },  //  0x99 STA
+    { Implied,     1, 2, 0 },  //  0x9A TXS
+    { AbsoluteY,   0, 5, 0 },  //  0x9B TAS
+    { AbsoluteX,   0, 5, 0 },  //  0x9C SHY
+    { AbsoluteX,   3, 5, 0 },  //  0x9D STA
+    { AbsoluteY,   0, 5, 0 },  //  0x9E SHX
+    { AbsoluteY,   0, 5, 0 },  //  0x9F AHX
+    { Immediate,   2, 2, 0 },  //  0xA0 LDY
+    { IndirectX,   2, 6, 0 },  //  0xA1 LDA
+    { Immediate,   2, 2, 0 },  //  0xA2 LDX
+    { IndirectX,   0, 6, 0 },  //  0xA3 LAX
+    { ZeroPage,    2, 3, 0 },  //  0xA4 LDY
+    { ZeroPage,    2, 3, 0 },  //  0xA5 LDA
+    { ZeroPage,    2, 3, 0 },  //  0xA6 LDX
+    { ZeroPage,    0, 3, 0 },  //  0xA7 LAX
+    { Implied,     1, 2, 0 },  //  0xA8 TAY
+    { Immediate,   2, 2, 0 },  //  0xA9 LDA
+    { Implied,     1, 2, 0 },  //  0xAA TAX
+    { Immediate,   0, 2, 0 },  //  0xAB LAX
+    { Absolute,    3, 4, 0 },  //  0xAC LDY
+    { Absolute,    3, 4, 0 },  //  0xAD LDA
+    { Absolute,    3, 4, 0 },  //  0xAE LDX
+    { Absolute,    0, 4, 0 },  //  0xAF LAX
+    { Relative,    2, 2, 1 },  //  0xB0 BCS
+    { IndirectY,   2, 5, 1 },  //  0xB1 LDA
+    { Implied,     0, 2, 0 },  //  0xB2 KIL
+    { IndirectY,   0, 5, 1 },  //  0xB3 LAX
+    { ZeroPageX,   2, 4, 0 },  //  0xB4 LDY
+    { ZeroPageX,   2, 4, 0 },  //  0xB5 LDA
+    { ZeroPageY,   2, 4, 0 },  //  0xB6 LDX
+    { ZeroPageY,   0, 4, 0 },  //  0xB7 LAX
+    { Implied,     1, 2, 0 },  //  0xB8 CLV
+    { AbsoluteY,   3, 4, 1 },  //  0xB9 LDA
+    { Implied,     1, 2, 0 },  //  0xBA TSX
+    { AbsoluteY,   0, 4, 1 },  //  0xBB LAS
+    { AbsoluteX,   3, 4, 1 },  //  0xBC LDY
+    { AbsoluteX,   3, 4, 1 },  //  0xBD LDA
+    { AbsoluteY,   3, 4, 1 },  //  0xBE LDX
+    { AbsoluteY,   0, 4, 1 },  //  0xBF LAX
+    { Immediate,   2, 2, 0 },  //  0xC0 CPY
+    { IndirectX,   2, 6, 0 },  //  0xC1 CMP
+    { Immediate,   0, 2, 0 },  //  0xC2 NOP
+    { IndirectX,   0, 8, 0 },  //  0xC3 DCP
+    { ZeroPage,    2, 3, 0 },  //  0xC4 CPY
+    { ZeroPage,    2, 3, 0 },  //  0xC5 CMP
+    { ZeroPage,    2, 5, 0 },  //  0xC6 DEC
+    { ZeroPage,    0, 5, 0 },  //  0xC7 DCP
+    { Implied,     1, 2, 0 },  //  0xC8 INY
+    { Immediate,   2, 2, 0 },  //  0xC9 CMP
+    { Implied,     1, 2, 0 },  //  0xCA DEX
+    { Immediate,   0, 2, 0 },  //  0xCB AXS
+    { Absolute,    3, 4, 0 },  //  0xCC CPY
+    { Absolute,    3, 4, 0 },  //  0xCD CMP
+    { Absolute,    3, 6, 0 },  //  0xCE DEC
+    { Absolute,    0, 6, 0 },  //  0xCF DCP
+    { Relative,    2, 2, 1 },  //  0xD0 BNE
+    { IndirectY,   2, 5, 1 },  //  0xD1 CMP
+    { Implied,     0, 2, 0 },  //  0xD2 KIL
+    { IndirectY,   0, 8, 0 },  //  0xD3 DCP
+    { ZeroPageX,   2, 4, 0 },  //  0xD4 NOP
+    { ZeroPageX,   2, 4, 0 },  //  0xD5 CMP
+    { ZeroPageX,   2, 6, 0 },  //  0xD6 DEC
+    { ZeroPageX,   0, 6, 0 },  //  0xD7 DCP
+    { Implied,     1, 2, 0 },  //  0xD8 CLD
+    { AbsoluteY,   3, 4, 1 },  //  0xD9 CMP
+    { Implied,     1, 2, 0 },  //  0xDA NOP
+    { AbsoluteY,   0, 7, 0 },  //  0xDB DCP
+    { AbsoluteX,   3, 4, 1 },  //  0xDC NOP
+    { AbsoluteX,   3, 4, 1 },  //  0xDD CMP
+    { AbsoluteX,   3, 7, 0 },  //  0xDE DEC
+    { AbsoluteX,   0, 7, 0 },  //  0xDF DCP
+    { Immediate,   2, 2, 0 },  //  0xE0 CPX
+    { IndirectX,   2, 6, 0 },  //  0xE1 SBC
+    { Immediate,   0, 2, 0 },  //  0xE2 NOP
+    { IndirectX,   0, 8, 0 },  //  0xE3 ISC
+    { ZeroPage,    2, 3, 0 },  //  0xE4 CPX
+    { ZeroPage,    2, 3, 0 },  //  0xE5 SBC
+    { ZeroPage,    2, 5, 0 },  //  0xE6 INC
+    { ZeroPage,    0, 5, 0 },  //  0xE7 ISC
+    { Implied,     1, 2, 0 },  //  0xE8 INX
+    { Immediate,   2, 2, 0 },  //  0xE9 SBC
+    { Implied,     1, 2, 0 },  //  0xEA NOP
+    { Immediate,   0, 2, 0 },  //  0xEB SBC
+    { Absolute,    3, 4, 0 },  //  0xEC CPX
+    { Absolute,    3, 4, 0 },  //  0xED SBC
+    { Absolute,    3, 6, 0 },  //  0xEE INC
+    { Absolute,    0, 6, 0 },  //  0xEF ISC
+    { Relative,    2, 2, 1 },  //  0xF0 BEQ
+    { IndirectY,   2, 5, 1 },  //  0xF1 SBC
+    { Implied,     0, 2, 0 },  //  0xF2 KIL
+    { IndirectY,   0, 8, 0 },  //  0xF3 ISC
+    { ZeroPageX,   2, 4, 0 },  //  0xF4 NOP
+    { ZeroPageX,   2, 4, 0 },  //  0xF5 SBC
+    { ZeroPageX,   2, 6, 0 },  //  0xF6 INC
+    { ZeroPageX,   0, 6, 0 },  //  0xF7 ISC
+    { Implied,     1, 2, 0 },  //  0xF8 SED
+    { AbsoluteY,   3, 4, 1 },  //  0xF9 SBC
+    { Implied,     1, 2, 0 },  //  0xFA NOP
+    { AbsoluteY,   0, 7, 0 },  //  0xFB ISC
+    { AbsoluteX,   3, 4, 1 },  //  0xFC NOP
+    { AbsoluteX,   3, 4, 1 },  //  0xFD SBC
+    { AbsoluteX,   3, 7, 0 },  //  0xFE INC
+    { AbsoluteX,   0, 7, 0 }   //  0xFF ISC
+  };
+
+  //  Mnemonics are only needed for disassembly and logging, so they live apart
+  //  from the decode table to keep it out of the way of the hot path.
+  constexpr const char* Names[] = {
+    "BRK", "ORA", "KIL", "SLO", "NOP", "ORA", "ASL", "SLO",
+    "PHP", "ORA", "ASL", "ANC", "NOP", "ORA", "ASL", "SLO",
+    "BPL", "ORA", "KIL", "SLO", "NOP", "ORA", "ASL", "SLO",
+    "CLC", "ORA", "NOP", "SLO", "NOP", "ORA", "ASL", "SLO",
+    "JSR", "AND", "KIL", "RLA", "BIT", "AND", "ROL", "RLA",
+    "PLP", "AND", "ROL", "ANC", "BIT", "AND", "ROL", "RLA",
+    "BMI", "AND", "KIL", "RLA", "NOP", "AND", "ROL", "RLA",
+    "SEC", "AND", "NOP", "RLA", "NOP", "AND", "ROL", "RLA",
+    "RTI", "EOR", "KIL", "SRE", "NOP", "EOR", "LSR", "SRE",
+    "PHA", "EOR", "LSR", "ALR", "JMP", "EOR", "LSR", "SRE",
+    "BVC", "EOR", "KIL", "SRE", "NOP", "EOR", "LSR", "SRE",
+    "CLI", "EOR", "NOP", "SRE", "NOP", "EOR", "LSR", "SRE",
+    "RTS", "ADC", "KIL", "RRA", "NOP", "ADC", "ROR", "RRA",
+    "PLA", "ADC", "ROR", "ARR", "JMP", "ADC", "ROR", "RRA",
+    "BVS", "ADC", "KIL", "RRA", "NOP", "ADC", "ROR", "RRA",
+    "SEI", "ADC", "NOP", "RRA", "NOP", "ADC", "ROR", "RRA",
+    "NOP", "STA", "NOP", "SAX", "STY", "STA", "STX", "SAX",
+    "DEY", "NOP", "TXA", "XAA", "STY", "STA", "STX", "SAX",
+    "BCC", "STA", "KIL", "AHX", "STY", "STA", "STX", "SAX",
+    "TYA", "STA", "TXS", "TAS", "SHY", "STA", "SHX", "AHX",
+    "LDY", "LDA", "LDX", "LAX", "LDY", "LDA", "LDX", "LAX",
+    "TAY", "LDA", "TAX", "LAX", "LDY", "LDA", "LDX", "LAX",
+    "BCS", "LDA", "KIL", "LAX", "LDY", "LDA", "LDX", "LAX",
+    "CLV", "LDA", "TSX", "LAS", "LDY", "LDA", "LDX", "LAX",
+    "CPY", "CMP", "NOP", "DCP", "CPY", "CMP", "DEC", "DCP",
+    "INY", "CMP", "DEX", "AXS", "CPY", "CMP", "DEC", "DCP",
+    "BNE", "CMP", "KIL", "DCP", "NOP", "CMP", "DEC", "DCP",
+    "CLD", "CMP", "NOP", "DCP", "NOP", "CMP", "DEC", "DCP",
+    "CPX", "SBC", "NOP", "ISC", "CPX", "SBC", "INC", "ISC",
+    "INX", "SBC", "NOP", "SBC", "CPX", "SBC", "INC", "ISC",
+    "BEQ", "SBC", "KIL", "ISC", "NOP", "SBC", "INC", "ISC",
+    "SED", "SBC", "NOP", "ISC", "NOP", "SBC", "INC", "ISC"
   };
 }
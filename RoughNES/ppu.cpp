@@ -1,15 +1,916 @@
 #include "ppu.h"
+#include "nes.h"
+#include "tile_decoder.h"
 
-PPU::PPU()
+#include <algorithm>
+#include <cstring>
+
+PPU::PPU() : m_console(nullptr), m_tile_decodes(0), m_mirroring(Mirroring::Horizontal), m_headless(false),
+  m_headless_next(false), m_frame_skip(1), m_frames_drawn(0), m_sprites_evaluated(false), m_sprite_pixels_line(~0ull),
+  m_regs{}, m_ctrl(0), m_mask(0), m_status(0), m_oam_addr(0), m_buffer(0), m_latch(0), m_dot(0), m_frame_start(0),
+  m_frame(0), m_changes(0)
+{
+  m_palette.resize(0x20);
+  m_nametable.resize(0x1000);
+  m_oam_data.resize(0x100);
+  m_chr.resize(0x2000);
+  m_frame_buffer.resize(ScreenWidth * ScreenHeight);
+  m_background.fill(0);
+  m_tiles.resize(PatternTiles * 64);
+  m_tile_rows.fill(m_tiles.data());
+  m_tile_palette.fill(0);
+  m_sprite_lines.fill(SpriteLine{});
+  m_sprite_pixels.fill(0);
+  m_chr_read.fill(nullptr);
+  m_chr_write.fill(nullptr);
+  map_chr_ram();
+}
+
+PPU::PPU(NES& console) : PPU()
+{
+  m_console = &console;
+}
+
+//  Absolute dot of a point in the current frame, counting the dot an odd frame
+//  skips on the pre-render scanline if it has not been reached yet.
+uint64_t PPU::frame_dot(uint32_t dot) const
+{
+  bool skip = m_dot - m_frame_start < OddFrameDot && m_regs.f && rendering();
+  return m_frame_start + dot - (skip ? 1 : 0);
+}
+
+uint64_t PPU::dot_cycle(uint64_t dot)
+{
+  return (dot + DotsPerCycle - 1) / DotsPerCycle;
+}
+
+void PPU::catch_up(uint64_t cycle)
+{
+  auto target = cycle * DotsPerCycle;
+
+  while (m_dot < target)
+  {
+    auto position = m_dot - m_frame_start;
+    uint32_t next = position < OddFrameDot ? OddFrameDot : position < VBlankDot ? VBlankDot : FrameDots;
+
+    if (m_frame_start + next > target)
+    {
+      render(static_cast<uint32_t>(position), static_cast<uint32_t>(target - m_frame_start));
+      m_dot = target;
+      break;
+    }
+
+    render(static_cast<uint32_t>(position), next);
+    m_dot = m_frame_start + next;
+
+    if (next == OddFrameDot)
+    {
+      //  Odd frames drop a dot from the pre-render scanline while rendering.
+      if (m_regs.f && rendering())
+      {
+        --m_frame_start;
+      }
+    }
+    else if (next == VBlankDot)
+    {
+      m_status |= VBlankStarted;
+    }
+    else
+    {
+      m_frame_start = m_dot;
+      m_status &= ~(VBlankStarted | SpriteZeroHit | SpriteOverflow);
+      m_regs.f ^= 1;
+      m_frames_drawn += m_headless ? 0 : 1;
+      ++m_frame;
+      start_frame_mode();
+    }
+  }
+}
+
+//  Renders the dots between two positions in the frame, a scanline at a time.
+void PPU::render(uint32_t from, uint32_t to)
+{
+  to = std::min(to, RenderedRows * DotsPerScanline - 1);
+
+  while (from < to)
+  {
+    auto row = (from + 1) / DotsPerScanline;
+    auto dot = (from + 1) % DotsPerScanline;
+    auto end = std::min(uint32_t{ DotsPerScanline }, dot + (to - from));
+
+    render_scanline(row, dot, end);
+    from += end - dot;
+  }
+}
+
+//  Dots from up to to of a row. Tiles are fetched on every eighth dot for the
+//  pixels 16 dots on, so a fetch never changes a pixel drawn in the same run
+//  and the fetches can all be done first, then decoded in one go.
+void PPU::render_scanline(uint32_t row, uint32_t from, uint32_t to)
+{
+  if (!rendering())
+  {
+    if (row > 0 && !m_headless)
+    {
+      draw(row - 1, std::max(from, 1u), std::min(to, ScreenWidth + 1));
+    }
+
+    return;
+  }
+
+  //  Overflow is set partway through evaluation, on the line before the
+  //  sprites are drawn.
+  if (row > 0 && !(m_status & SpriteOverflow))
+  {
+    if (!m_sprites_evaluated)
+    {
+      evaluate_sprites();
+    }
+
+    auto overflow = m_sprite_lines[row - 1].overflow;
+
+    if (overflow && from <= overflow && overflow < to)
+    {
+      m_status |= SpriteOverflow;
+    }
+  }
+
+  auto fetches_end = std::min(to, ScreenWidth + 1);
+
+  auto first = std::max(8u, (from + 7) & ~7u);
+  bool fetch = !m_headless || has_sprite_zero(row);
+
+  for (auto dot = first; dot < fetches_end; dot += 8)
+  {
+    if (fetch)
+    {
+      fetch_tile(dot / 8 + 1);
+    }
+
+    increment_x();
+  }
+
+  if (fetch)
+  {
+    place_tiles(first / 8 + 1, (fetches_end + 7) / 8 + 1);
+  }
+
+  if (from <= 256 && to > 256)
+  {
+    increment_y();
+  }
+
+  if (row > 0)
+  {
+    draw(row - 1, std::max(from, 1u), fetches_end);
+  }
+
+  //  Horizontal position goes back to t for the next line, and the pre-render
+  //  line takes the vertical one as well.
+  if (from <= 257 && to > 257)
+  {
+    m_regs.v = (m_regs.v & ~0x041F) | (m_regs.t & 0x041F);
+  }
+
+  if (row == 0 && from < 305 && to > 280)
+  {
+    m_regs.v = (m_regs.v & 0x041F) | (m_regs.t & ~0x041F);
+  }
+
+  //  The first two tiles of the next line. This line's pixels are done.
+  fetch = !m_headless || has_sprite_zero(row + 1);
+
+  if (from <= 328 && to > 328)
+  {
+    if (fetch)
+    {
+      fetch_tile(0);
+    }
+
+    increment_x();
+  }
+
+  if (from <= 336 && to > 336)
+  {
+    if (fetch)
+    {
+      fetch_tile(1);
+    }
+
+    increment_x();
+  }
+
+  if (fetch)
+  {
+    place_tiles(from <= 328 ? 0 : from <= 336 ? 1 : 2, to > 336 ? 2 : to > 328 ? 1 : 0);
+  }
+}
+
+//  Whether sprite 0 is on the visible line drawn on a row, so a headless
+//  frame needs its background.
+bool PPU::has_sprite_zero(uint32_t row)
+{
+  if (row < 2 || row > ScreenHeight)
+  {
+    return false;
+  }
+
+  if (!m_sprites_evaluated)
+  {
+    evaluate_sprites();
+  }
+
+  const auto& sprites = m_sprite_lines[row - 2];
+  return sprites.count && sprites.sprites[0] == 0;
+}
+
+//  Pixels for the dots from up to to of a visible line.
+void PPU::draw(uint32_t line, uint32_t from, uint32_t to)
+{
+  if (from >= to)
+  {
+    return;
+  }
+
+  if (m_headless)
+  {
+    //  Only sprite 0 hit is left to find.
+    if ((m_mask & RenderBackground) && (m_mask & RenderSprites) && !(m_status & SpriteZeroHit) &&
+      sprite_zero_hit(line, from - 1, m_background.data()) < to - 1)
+    {
+      m_status |= SpriteZeroHit;
+    }
+
+    return;
+  }
+
+  auto pixels = &m_frame_buffer[line * ScreenWidth];
+  uint8_t gray = (m_mask & Grayscale) ? 0x30 : 0x3F;
+
+  if (!rendering())
+  {
+    //  With rendering off the backdrop shows, or the palette entry v points
+    //  at if it points into the palette.
+    auto color = palette_color((m_regs.v & 0x3F00) == 0x3F00 ? m_regs.v & 0x1F : 0) & gray;
+    std::fill(pixels + from - 1, pixels + to - 1, color);
+    return;
+  }
+
+  bool background = (m_mask & RenderBackground) != 0;
+  bool sprites = (m_mask & RenderSprites) != 0;
+  uint32_t left = (m_mask & ShowBackgroundLeft) ? 0 : 8;
+  uint32_t sprites_left = (m_mask & ShowSpritesLeft) ? 0 : 8;
+
+  auto key = m_frame * RenderedRows + line;
+
+  if (sprites && m_sprite_pixels_line != key)
+  {
+    build_sprite_pixels(line);
+    m_sprite_pixels_line = key;
+  }
+
+  for (auto x = from - 1; x < to - 1; ++x)
+  {
+    uint8_t index = background && x >= left ? m_background[x + m_regs.x] : 0;
+    uint8_t sprite = sprites && x >= sprites_left ? m_sprite_pixels[x] : 0;
+
+    if (sprite)
+    {
+      //  Sprite 0 hits on any opaque background pixel, whatever the
+      //  priority, but never in the last column.
+      if ((sprite & SpriteZeroPixel) && index && x != ScreenWidth - 1)
+      {
+        m_status |= SpriteZeroHit;
+      }
+
+      if (!(sprite & SpriteBehind) || !index)
+      {
+        index = sprite & 0x1F;
+      }
+    }
+
+    pixels[x] = palette_color(index) & gray;
+  }
+}
+
+void PPU::fetch_tile(size_t index)
+{
+  m_tile_rows[index] = background_row(m_regs.v, m_tile_palette[index]);
+}
+
+//  Nametable and attribute bytes for the tile at v, and its row in the tile
+//  cache in place of the pattern bytes.
+const uint8_t* PPU::background_row(uint16_t v, uint8_t& palette)
+{
+  auto tile = read_vram(0x2000 | (v & 0x0FFF));
+  auto attribute = read_vram(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+  palette = static_cast<uint8_t>(((attribute >> (((v >> 4) & 0x04) | (v & 0x02))) & 0x03) << 2);
+
+  auto address = static_cast<uint16_t>(((m_ctrl & 0x10) << 8) | (tile << 4) | ((v >> 12) & 0x07));
+  return tile_row(address);
+}
+
+//  Eight pixels at a time, adding the palette to the opaque ones. A pixel
+//  is opaque if either of its two bits is set, which leaves a 1 in the low
+//  bit of its byte to multiply the palette by.
+void PPU::place_tiles(size_t first, size_t last)
+{
+  for (auto index = first; index < last; ++index)
+  {
+    uint64_t row;
+    std::memcpy(&row, m_tile_rows[index], sizeof(row));
+
+    auto opaque = (row | (row >> 1)) & 0x0101010101010101ull;
+    row |= opaque * m_tile_palette[index];
+    std::memcpy(&m_background[index * 8], &row, sizeof(row));
+  }
+}
+
+//  Pixels of the pattern table row at address, decoding its tile first if
+//  the cache doesn't have it.
+const uint8_t* PPU::tile_row(uint16_t address)
+{
+  auto tile = (address & 0x1FFF) / TileBytes;
+  auto pixels = &m_tiles[tile * 64];
+
+  if (!m_tile_valid[tile])
+  {
+    static const uint8_t Transparent[8] = {};
+    auto bytes = &m_chr_read[tile / TilesPerBank][(tile % TilesPerBank) * TileBytes];
+
+    decode_tile_rows(bytes, bytes + 8, Transparent, 8, pixels);
+    m_tile_valid[tile] = true;
+    ++m_tile_decodes;
+  }
+
+  return pixels + (address & 0x07) * 8;
+}
+
+//  Coarse X, wrapping into the next nametable across.
+uint16_t PPU::increment_x(uint16_t v)
 {
+  if ((v & 0x001F) == 31)
+  {
+    return static_cast<uint16_t>((v & ~0x001F) ^ 0x0400);
+  }
+
+  return static_cast<uint16_t>(v + 1);
+}
+
+void PPU::increment_x()
+{
+  m_regs.v = increment_x(m_regs.v);
+}
+
+//  Fine Y, then coarse Y, which wraps into the nametable below after row 29.
+//  Rows 30 and 31 are attribute bytes and wrap without switching.
+void PPU::increment_y()
+{
+  if ((m_regs.v & 0x7000) != 0x7000)
+  {
+    m_regs.v += 0x1000;
+    return;
+  }
+
+  m_regs.v &= ~0x7000;
+  auto y = (m_regs.v & 0x03E0) >> 5;
+
+  if (y == 29)
+  {
+    y = 0;
+    m_regs.v ^= 0x0800;
+  }
+  else if (y == 31)
+  {
+    y = 0;
+  }
+  else
+  {
+    ++y;
+  }
+
+  m_regs.v = static_cast<uint16_t>((m_regs.v & ~0x03E0) | (y << 5));
+}
+
+void PPU::evaluate_sprites()
+{
+  for (uint32_t line = 0; line < ScreenHeight; ++line)
+  {
+    evaluate_sprites(line);
+  }
+
+  m_sprites_evaluated = true;
+}
+
+//  Evaluation as the hardware does it: the first eight sprites in range are
+//  copied, then the search goes on for overflow. Past eight it also steps
+//  through the bytes of each entry on a miss, the overflow bug, so it reads
+//  tile numbers and attributes as Y and finds false positives and misses.
+//  Reading a Y takes two dots and copying the rest of a sprite six more.
+void PPU::evaluate_sprites(uint32_t line)
+{
+  auto& result = m_sprite_lines[line];
+  auto height = sprite_height();
+  uint32_t dot = EvaluationDot;
+  size_t n = 0;
+
+  result.count = 0;
+  result.overflow = 0;
+
+  for (; n < 64 && result.count < SpritesPerLine; ++n)
+  {
+    if (line - m_oam_data[n * 4] < height)
+    {
+      result.sprites[result.count++] = static_cast<uint8_t>(n);
+      dot += 8;
+    }
+    else
+    {
+      dot += 2;
+    }
+  }
+
+  for (size_t m = 0; n < 64; dot += 2)
+  {
+    if (line - m_oam_data[n * 4 + m] < height)
+    {
+      result.overflow = static_cast<uint16_t>(dot);
+      break;
+    }
+
+    ++n;
+    m = (m + 1) & 3;
+  }
+}
+
+//  Row of a sprite's pattern for a visible line, left to right before any
+//  horizontal flip. 8x16 sprites take the table from bit 0 of the tile.
+const uint8_t* PPU::sprite_row(uint8_t sprite, uint32_t line)
+{
+  auto entry = &m_oam_data[sprite * 4];
+  auto height = sprite_height();
+  auto row = line - 1 - entry[0];
+
+  if (entry[2] & 0x80)
+  {
+    row = height - 1 - row;
+  }
+
+  uint16_t address;
+
+  if (height == 8)
+  {
+    address = static_cast<uint16_t>(((m_ctrl & 0x08) << 9) | (entry[1] << 4) | row);
+  }
+  else
+  {
+    address = static_cast<uint16_t>(((entry[1] & 0x01) << 12) | ((entry[1] & 0xFE) << 4) | ((row & 0x08) << 1) | (row & 0x07));
+  }
 
+  return tile_row(address);
 }
 
-PPU::PPU(std::shared_ptr<NES> console) : PPU()
+//  Sprites of a visible line in priority order, each filling only the pixels
+//  no earlier sprite is opaque on.
+void PPU::build_sprite_pixels(uint32_t line)
 {
-  m_console = console;
+  m_sprite_pixels.fill(0);
+
+  if (line == 0)
+  {
+    return;
+  }
+
+  if (!m_sprites_evaluated)
+  {
+    evaluate_sprites();
+  }
+
+  const auto& sprites = m_sprite_lines[line - 1];
+
+  for (size_t i = 0; i < sprites.count; ++i)
+  {
+    auto sprite = sprites.sprites[i];
+    auto entry = &m_oam_data[sprite * 4];
+    auto pixels = sprite_row(sprite, line);
+    auto flip = (entry[2] & 0x40) ? 7 : 0;
+    auto flags = static_cast<uint8_t>(0x10 | ((entry[2] & 0x03) << 2) | (entry[2] & SpriteBehind) | (sprite == 0 ? SpriteZeroPixel : 0));
+
+    for (uint32_t column = 0; column < 8 && entry[3] + column < ScreenWidth; ++column)
+    {
+      auto pixel = pixels[column ^ flip];
+      auto& out = m_sprite_pixels[entry[3] + column];
+
+      if (pixel && !out)
+      {
+        out = flags | pixel;
+      }
+    }
+  }
+}
+
+//  First x from on where sprite 0 hits on a visible line, or ScreenWidth.
+//  Without the line's background it is the first x sprite 0 is opaque on.
+uint32_t PPU::sprite_zero_hit(uint32_t line, uint32_t from, const uint8_t* background)
+{
+  if (!has_sprite_zero(line + 1))
+  {
+    return ScreenWidth;
+  }
+
+  bool clipped = !(m_mask & ShowBackgroundLeft) || !(m_mask & ShowSpritesLeft);
+  auto pixels = sprite_row(0, line);
+  auto flip = (m_oam_data[2] & 0x40) ? 7 : 0;
+  from = std::max(from, clipped ? 8u : 0u);
+
+  for (uint32_t column = 0; column < 8; ++column)
+  {
+    auto x = m_oam_data[3] + column;
+
+    if (x >= from && x < ScreenWidth - 1 && pixels[column ^ flip] && (!background || background[x + m_regs.x]))
+    {
+      return x;
+    }
+  }
+
+  return ScreenWidth;
+}
+
+uint64_t PPU::next_sprite_event()
+{
+  if (!rendering())
+  {
+    return Scheduler::Never;
+  }
+
+  if (!m_sprites_evaluated)
+  {
+    evaluate_sprites();
+  }
+
+  auto position = static_cast<uint32_t>(m_dot - m_frame_start);
+  auto row = (position + 1) / DotsPerScanline;
+  auto dot = (position + 1) % DotsPerScanline;
+  uint32_t next = FrameDots;
+
+  if (!(m_status & SpriteOverflow))
+  {
+    for (auto line = std::max(row, 1u) - 1; line < ScreenHeight; ++line)
+    {
+      auto overflow = m_sprite_lines[line].overflow;
+
+      if (overflow && (line + 1 > row || overflow >= dot))
+      {
+        next = (line + 1) * DotsPerScanline + overflow - 1;
+        break;
+      }
+    }
+  }
+
+  if ((m_mask & RenderBackground) && (m_mask & RenderSprites) && !(m_status & SpriteZeroHit))
+  {
+    //  Pixel x of a line is drawn on dot x + 1. The background of the line
+    //  being drawn is read ahead from v for the fetches still to come.
+    std::array<uint8_t, BackgroundTiles * 8> background;
+
+    for (auto line = std::max(row, 2u) - 1; line < ScreenHeight; ++line)
+    {
+      bool current = line + 1 == row;
+
+      if (current)
+      {
+        if (dot > ScreenWidth || !has_sprite_zero(row))
+        {
+          continue;
+        }
+
+        auto v = m_regs.v;
+        background = m_background;
+
+        for (auto fetch = std::max(8u, (dot + 7) & ~7u); fetch <= ScreenWidth; fetch += 8)
+        {
+          uint8_t palette;
+          auto pixels = background_row(v, palette);
+
+          for (size_t i = 0; i < 8; ++i)
+          {
+            background[(fetch / 8 + 1) * 8 + i] = pixels[i] ? pixels[i] | palette : 0;
+          }
+
+          v = increment_x(v);
+        }
+      }
+
+      auto x = sprite_zero_hit(line, current && dot > 0 ? dot - 1 : 0, current ? background.data() : nullptr);
+
+      if (x < ScreenWidth)
+      {
+        next = std::min(next, (line + 1) * DotsPerScanline + x);
+        break;
+      }
+    }
+  }
+
+  return next < FrameDots ? dot_cycle(frame_dot(next) + 1) : Scheduler::Never;
+}
+
+void PPU::set_headless(bool headless)
+{
+  m_headless_next = headless;
+
+  if (m_dot == m_frame_start)
+  {
+    start_frame_mode();
+  }
+}
+
+void PPU::set_frame_skip(uint32_t interval)
+{
+  m_frame_skip = std::max(1u, interval);
+
+  if (m_dot == m_frame_start)
+  {
+    start_frame_mode();
+  }
+}
+
+void PPU::start_frame_mode()
+{
+  m_headless = m_headless_next || m_frame % m_frame_skip != 0;
+}
+
+uint64_t PPU::next_vblank() const
+{
+  if (m_dot - m_frame_start >= VBlankDot)
+  {
+    return Scheduler::Never;
+  }
+
+  return dot_cycle(frame_dot(VBlankDot));
+}
+
+uint64_t PPU::next_frame_end() const
+{
+  return dot_cycle(frame_dot(FrameDots));
+}
+
+uint64_t PPU::scanline_clocks() const
+{
+  //  The pre-render clock comes first, 259 dots into a frame.
+  auto position = m_dot - m_frame_start;
+  auto first = ScanlineClockDot - 1;
+  uint64_t passed = position < first ? 0 : std::min<uint64_t>(ScanlineClocksPerFrame, (position - first) / DotsPerScanline + 1);
+
+  return m_frame * ScanlineClocksPerFrame + passed;
+}
+
+uint64_t PPU::scanline_clock_cycle(uint64_t clock) const
+{
+  auto frames = clock / ScanlineClocksPerFrame - m_frame;
+  auto index = static_cast<uint32_t>(clock % ScanlineClocksPerFrame);
+  auto position = index * DotsPerScanline + ScanlineClockDot - 1;
+
+  //  Frames after this one are taken at full length.
+  if (frames > 0)
+  {
+    return dot_cycle(frame_dot(FrameDots) + (frames - 1) * FrameDots + position);
+  }
+
+  return dot_cycle(index > 0 ? frame_dot(position) : m_frame_start + position);
+}
+
+uint16_t PPU::scanline() const
+{
+  auto line = (m_dot - m_frame_start + 1) / DotsPerScanline;
+  return static_cast<uint16_t>((line + PreRenderScanline) % ScanlinesPerFrame);
+}
+
+uint16_t PPU::dot() const
+{
+  return static_cast<uint16_t>((m_dot - m_frame_start + 1) % DotsPerScanline);
+}
+
+uint16_t PPU::nametable_index(uint16_t address) const
+{
+  auto table = (address >> 10) & 3;
+
+  switch (m_mirroring)
+  {
+  case Mirroring::Horizontal:
+    table >>= 1;
+    break;
+  case Mirroring::Vertical:
+    table &= 1;
+    break;
+  case Mirroring::SingleLow:
+    table = 0;
+    break;
+  case Mirroring::SingleHigh:
+    table = 1;
+    break;
+  default:
+    break;
+  }
+
+  return static_cast<uint16_t>((table << 10) | (address & 0x3FF));
+}
+
+//  $3F10/$3F14/$3F18/$3F1C mirror the background entries below them.
+uint8_t PPU::palette_color(uint8_t index) const
+{
+  return m_palette[(index & 0x13) == 0x10 ? index & 0x0F : index];
+}
+
+uint8_t PPU::read_vram(uint16_t address) const
+{
+  address &= 0x3FFF;
+
+  if (address < 0x2000)
+  {
+    return m_chr_read[address / CHRBankSize][address % CHRBankSize];
+  }
+  else if (address < 0x3F00)
+  {
+    return m_nametable[nametable_index(address)];
+  }
+
+  return palette_color(address & 0x1F);
+}
+
+void PPU::write_vram(uint8_t value, uint16_t address)
+{
+  address &= 0x3FFF;
+
+  if (address < 0x2000)
+  {
+    auto bank = m_chr_write[address / CHRBankSize];
+
+    if (bank)
+    {
+      bank[address % CHRBankSize] = value;
+      m_tile_valid[address / TileBytes] = false;
+    }
+  }
+  else if (address < 0x3F00)
+  {
+    m_nametable[nametable_index(address)] = value;
+  }
+  else
+  {
+    auto index = address & 0x1F;
+    m_palette[(index & 0x13) == 0x10 ? index & 0x0F : index] = value;
+  }
+}
+
+uint8_t PPU::read_register(uint16_t address)
+{
+  switch (address & 7)
+  {
+  case 2:
+  {
+    auto value = static_cast<uint8_t>((m_status & 0xE0) | (m_latch & 0x1F));
+
+    if ((m_status & VBlankStarted) || m_regs.w)
+    {
+      ++m_changes;
+    }
+
+    m_status &= ~VBlankStarted;
+    m_regs.w = 0;
+    return value;
+  }
+  case 4:
+    return m_oam_data[m_oam_addr];
+  case 7:
+  {
+    uint8_t value;
+
+    //  Palette reads are immediate but still refill the buffer with the
+    //  nametable byte underneath.
+    if ((m_regs.v & 0x3FFF) < 0x3F00)
+    {
+      value = m_buffer;
+      m_buffer = read_vram(m_regs.v);
+    }
+    else
+    {
+      value = read_vram(m_regs.v);
+      m_buffer = read_vram(m_regs.v - 0x1000);
+    }
+
+    m_regs.v += (m_ctrl & 0x04) ? 32 : 1;
+    m_latch = value;
+    ++m_changes;
+    return value;
+  }
+  default:
+    return m_latch;
+  }
+}
+
+void PPU::write_register(uint8_t value, uint16_t address)
+{
+  m_latch = value;
+
+  switch (address & 7)
+  {
+  case 0:
+    if ((m_ctrl ^ value) & SpriteSize)
+    {
+      m_sprites_evaluated = false;
+    }
+
+    m_ctrl = value;
+    m_regs.t = (m_regs.t & 0xF3FF) | ((value & 0x03) << 10);
+    break;
+  case 1:
+    m_mask = value;
+    break;
+  case 3:
+    m_oam_addr = value;
+    break;
+  case 4:
+    m_oam_data[m_oam_addr++] = value;
+    m_sprites_evaluated = false;
+    break;
+  case 5:
+    if (!m_regs.w)
+    {
+      m_regs.t = (m_regs.t & 0xFFE0) | (value >> 3);
+      m_regs.x = value & 0x07;
+    }
+    else
+    {
+      m_regs.t = (m_regs.t & 0x8C1F) | ((value & 0x07) << 12) | ((value & 0xF8) << 2);
+    }
+
+    m_regs.w ^= 1;
+    break;
+  case 6:
+    if (!m_regs.w)
+    {
+      m_regs.t = (m_regs.t & 0x00FF) | ((value & 0x3F) << 8);
+    }
+    else
+    {
+      m_regs.t = (m_regs.t & 0xFF00) | value;
+      m_regs.v = m_regs.t;
+    }
+
+    m_regs.w ^= 1;
+    break;
+  case 7:
+    write_vram(value, m_regs.v);
+    m_regs.v += (m_ctrl & 0x04) ? 32 : 1;
+    break;
+  default:
+    break;
+  }
+}
+
+void PPU::write_oam(const std::vector<uint8_t>& data)
+{
+  for (auto value : data)
+  {
+    m_oam_data[m_oam_addr++] = value;
+  }
+
+  m_sprites_evaluated = false;
+}
+
+void PPU::map_chr(uint16_t address, size_t size, const uint8_t* memory)
+{
+  for (size_t offset = 0; offset < size; offset += CHRBankSize)
+  {
+    set_chr_bank((address + offset) / CHRBankSize, memory + offset, nullptr);
+  }
+}
+
+void PPU::map_chr_ram()
+{
+  for (size_t offset = 0; offset < m_chr.size(); offset += CHRBankSize)
+  {
+    set_chr_bank(offset / CHRBankSize, m_chr.data() + offset, m_chr.data() + offset);
+  }
+}
+
+//  Mapping the bank that is already there keeps its decoded tiles, so
+//  mappers that rewrite their bank registers every frame cost nothing.
+void PPU::set_chr_bank(size_t bank, const uint8_t* read, uint8_t* write)
+{
+  if (m_chr_read[bank] != read)
+  {
+    for (auto tile = bank * TilesPerBank; tile < (bank + 1) * TilesPerBank; ++tile)
+    {
+      m_tile_valid[tile] = false;
+    }
+  }
+
+  m_chr_read[bank] = read;
+  m_chr_write[bank] = write;
 }
 
-void PPU::step()
+void PPU::set_mirroring(Mirroring mirroring)
 {
+  m_mirroring = mirroring;
 }
@@ -1,19 +1,124 @@
 #pragma once
 
-#include <memory>
+#include <array>
+#include <bitset>
+#include <cstdint>
 #include <vector>
 
-#include "nes.h"
-
 class NES;
 
+//  The PPU is not clocked dot by dot. It keeps the dot it was last brought up
+//  to and catches up to a CPU cycle in one go whenever its state is looked at,
+//  stepping only over the points where something visible changes.
+//
+//  Rendering catches up the same way, a run of dots at a time. Register
+//  writes catch up first, so a write in the middle of a scanline splits the
+//  run at the dot it happened on, and the renderer only has to get the order
+//  of events within a run right. Without mid-frame writes that is a single
+//  run per scanline.
 class PPU
 {
-  std::shared_ptr<NES> m_console;
+public:
+  static const uint32_t DotsPerCycle = 3;
+  static const uint32_t DotsPerScanline = 341;
+  static const uint32_t ScanlinesPerFrame = 262;
+  static const uint32_t VBlankScanline = 241;
+  static const uint32_t PreRenderScanline = 261;
+  static const size_t CHRBankSize = 0x400;
+  static const uint32_t ScanlineClockDot = 260;
+  static const uint32_t ScreenWidth = 256;
+  static const uint32_t ScreenHeight = 240;
+
+  enum class Mirroring : uint8_t
+  {
+    Horizontal,
+    Vertical,
+    SingleLow,
+    SingleHigh,
+    FourScreen
+  };
+
+private:
+  //  Frames are counted from the second dot of the pre-render scanline, where
+  //  the status flags clear. Dots below are relative to that point.
+  static const uint32_t OddFrameDot = DotsPerScanline - 3;
+  static const uint32_t VBlankDot = DotsPerScanline + VBlankScanline * DotsPerScanline;
+  static const uint32_t FrameDots = ScanlinesPerFrame * DotsPerScanline;
+  static const uint32_t ScanlineClocksPerFrame = 240 + 1;    //  Visible scanlines and the pre-render one
+
+  //  Rendering works on rows counted from the pre-render scanline, so row 0
+  //  is the pre-render line and row 1 is the first visible one.
+  static const uint32_t RenderedRows = ScreenHeight + 1;
+  static const uint32_t BackgroundTiles = 34;   //  Two from the line before and 32 fetched on it
+  static const size_t PatternTiles = 0x200;     //  16 byte tiles in $0000-$1FFF
+  static const size_t TileBytes = 16;
+  static const size_t TilesPerBank = CHRBankSize / TileBytes;
+  static const size_t SpritesPerLine = 8;
+  static const uint32_t EvaluationDot = 65;    //  Sprite evaluation starts after secondary OAM is cleared
+
+  enum Flags : uint8_t
+  {
+    NMIEnable = 0x80,
+    Grayscale = 0x01,
+    ShowBackgroundLeft = 0x02,
+    ShowSpritesLeft = 0x04,
+    RenderBackground = 0x08,
+    RenderSprites = 0x10,
+    VBlankStarted = 0x80,
+    SpriteZeroHit = 0x40,
+    SpriteOverflow = 0x20,
+    SpriteSize = 0x20,
+    SpriteBehind = 0x20,    //  In sprite attributes and the sprite line
+    SpriteZeroPixel = 0x40
+  };
+
+  //  Sprites found by evaluation on a line, drawn on the next one, as OAM
+  //  indices in priority order. Overflow is the dot the flag gets set on,
+  //  or zero if it doesn't.
+  struct SpriteLine
+  {
+    uint8_t count;
+    std::array<uint8_t, SpritesPerLine> sprites;
+    uint16_t overflow;
+  };
+
+  NES* m_console;
 
   std::vector<uint8_t> m_palette;
   std::vector<uint8_t> m_nametable;
   std::vector<uint8_t> m_oam_data;
+  std::vector<uint8_t> m_chr;     //  CHR RAM, used when the cartridge has no CHR ROM
+  std::array<const uint8_t*, 8> m_chr_read;
+  std::array<uint8_t*, 8> m_chr_write;   //  Null for ROM banks
+
+  //  Pattern table tiles decoded to one 2 bit pixel per byte, 64 bytes a
+  //  tile, decoded the first time they're drawn. A tile is dropped when CHR
+  //  RAM under it is written or a different bank is mapped over it.
+  std::vector<uint8_t> m_tiles;
+  std::bitset<PatternTiles> m_tile_valid;
+  uint64_t m_tile_decodes;
+  Mirroring m_mirroring;
+
+  std::vector<uint8_t> m_frame_buffer;
+  bool m_headless;
+  bool m_headless_next;   //  Taken at the start of the next frame
+  uint32_t m_frame_skip;
+  uint64_t m_frames_drawn;
+  std::array<uint8_t, BackgroundTiles * 8> m_background;   //  Palette indices of the tiles fetched for the line
+
+  //  Rows of the tiles fetched in a run, copied into m_background together.
+  std::array<const uint8_t*, BackgroundTiles> m_tile_rows;
+  std::array<uint8_t, BackgroundTiles> m_tile_palette;
+
+  //  Evaluation for the whole frame, redone only after OAM or the sprite size
+  //  changes rather than scanning OAM on every line.
+  std::array<SpriteLine, ScreenHeight> m_sprite_lines;
+  bool m_sprites_evaluated;
+
+  //  Sprite pixels of the line being drawn, built at its first dot: palette
+  //  index, SpriteBehind and SpriteZeroPixel, zero where no sprite is opaque.
+  std::array<uint8_t, ScreenWidth> m_sprite_pixels;
+  uint64_t m_sprite_pixels_line;
 
   struct Registers
   {
@@ -23,10 +128,117 @@ class PPU
     uint8_t w;
     uint8_t f;
   } m_regs;
+
+  uint8_t m_ctrl;
+  uint8_t m_mask;
+  uint8_t m_status;
+  uint8_t m_oam_addr;
+  uint8_t m_buffer;     //  $2007 read buffer
+  uint8_t m_latch;      //  Last value on the register bus
+
+  uint64_t m_dot;
+  uint64_t m_frame_start;
+  uint64_t m_frame;
+  uint32_t m_changes;
+
+  uint64_t frame_dot(uint32_t dot) const;
+  static inline uint64_t dot_cycle(uint64_t dot);
+
+  void render(uint32_t from, uint32_t to);
+  void render_scanline(uint32_t row, uint32_t from, uint32_t to);
+  void draw(uint32_t line, uint32_t from, uint32_t to);
+  void fetch_tile(size_t index);
+  const uint8_t* background_row(uint16_t v, uint8_t& palette);
+  void place_tiles(size_t first, size_t last);
+  const uint8_t* tile_row(uint16_t address);
+  void set_chr_bank(size_t bank, const uint8_t* read, uint8_t* write);
+  static inline uint16_t increment_x(uint16_t v);
+  void increment_x();
+  void increment_y();
+
+  inline uint32_t sprite_height() const { return (m_ctrl & SpriteSize) ? 16 : 8; }
+  void evaluate_sprites();
+  void evaluate_sprites(uint32_t line);
+  void build_sprite_pixels(uint32_t line);
+  const uint8_t* sprite_row(uint8_t sprite, uint32_t line);
+  void start_frame_mode();
+  uint32_t sprite_zero_hit(uint32_t line, uint32_t from, const uint8_t* background);
+  bool has_sprite_zero(uint32_t row);
+
+  uint16_t nametable_index(uint16_t address) const;
+  inline uint8_t palette_color(uint8_t index) const;
+  uint8_t read_vram(uint16_t address) const;
+  void write_vram(uint8_t value, uint16_t address);
 public:
   PPU();
-  explicit PPU(std::shared_ptr<NES> console);
+  explicit PPU(NES& console);
 
-  void step();
-};
+  //  Brings the PPU up to the given CPU cycle.
+  void catch_up(uint64_t cycle);
+
+  //  CPU cycles on which the next VBlank starts and the current frame ends,
+  //  as seen from the current state. Register writes can move them.
+  uint64_t next_vblank() const;
+  uint64_t next_frame_end() const;
+
+  //  CPU cycle by which the sprite 0 hit or overflow flag may next be set,
+  //  for a CPU polling $2002 to see it on time. The hit is exact for the
+  //  current scanline; on later ones it is the first dot sprite 0 could hit
+  //  on, and the event is taken again from there.
+  uint64_t next_sprite_event();
+
+  //  Registers at $2000-$2007. The caller catches up first.
+  uint8_t read_register(uint16_t address);
+  void write_register(uint8_t value, uint16_t address);
+  void write_oam(const std::vector<uint8_t>& data);
+
+  //  Pattern tables are 1K banks mapped by pointer, so switching a bank is a
+  //  pointer swap. Both arguments are multiples of CHRBankSize. CHR ROM is
+  //  mapped read-only; map_chr_ram puts the PPU's own 8K back.
+  void map_chr(uint16_t address, size_t size, const uint8_t* memory);
+  void map_chr_ram();
+  void set_mirroring(Mirroring mirroring);
 
+  inline bool nmi_enabled() const { return (m_ctrl & NMIEnable) != 0; }
+  inline bool rendering() const { return (m_mask & (RenderBackground | RenderSprites)) != 0; }
+  inline bool in_vblank() const { return (m_status & VBlankStarted) != 0; }
+
+  //  Scanline counters on the cartridge (MMC3) are clocked at dot 260 of the
+  //  pre-render and visible scanlines while rendering. Clocks are numbered
+  //  from power on whether rendering was on or not, so a mapper can count
+  //  the ones between two points and find the cycle a future one lands on.
+  uint64_t scanline_clocks() const;
+  uint64_t scanline_clock_cycle(uint64_t clock) const;
+
+  //  ScreenWidth by ScreenHeight colour indices into the NES palette, filled
+  //  in as the frame is caught up.
+  inline const std::vector<uint8_t>& frame_buffer() const { return m_frame_buffer; }
+
+  //  Headless frames skip pixels and the frame buffer keeps the last frame
+  //  drawn, but everything a program can see is the same: status flags,
+  //  sprite 0 hit on the same dot and v, t, x and w. Background tiles are
+  //  only fetched on lines with sprite 0 in them. The switch is made at the
+  //  start of the next frame, or straight away if this one hasn't started.
+  void set_headless(bool headless);
+  inline bool headless() const { return m_headless; }
+
+  //  Draws only frames that are a multiple of interval and runs the others
+  //  headless, switching the same way. 1 draws every frame.
+  void set_frame_skip(uint32_t interval);
+
+  //  Frames completed that were drawn rather than run headless.
+  inline uint64_t frames_drawn() const { return m_frames_drawn; }
+
+  //  Pattern table tiles decoded since power on, for keeping an eye on the
+  //  tile cache.
+  inline uint64_t tile_decodes() const { return m_tile_decodes; }
+
+  //  Frames completed and the current position within a frame.
+  inline uint64_t frame() const { return m_frame; }
+  uint16_t scanline() const;
+  uint16_t dot() const;
+
+  //  Bumped whenever reading a register changes state, so a CPU loop that
+  //  polls the PPU can tell whether its reads are repeatable.
+  inline uint32_t changes() const { return m_changes; }
+};
@@ -79,4 +79,101 @@ struct Registers
     auto output_same_sign = ((value2 ^ output) & 0x80) == 0;
     set_flag(Overflow, values_same_sign && !output_same_sign);
   }
-};
\ No newline at end of file
+};
+
+//  Status flags as the CPU tracks them between instructions. Zero, Negative,
+//  Overflow and Carry are kept as the values that produced them, so an ALU
+//  instruction only stores its result. They are packed back into a status
+//  byte when something needs P as a whole (PHP, BRK, interrupts and
+//  CPU::get_registers).
+class LazyStatus
+{
+  uint8_t m_p;  //  Interrupt, Decimal, Break and Unused
+  uint8_t m_z;  //  Zero is set when this is 0
+  uint8_t m_n;  //  Negative is bit 7
+  uint8_t m_v;  //  Overflow is bit 7
+  uint8_t m_c;  //  Carry is bit 0
+
+public:
+  static const uint8_t Lazy = Zero | Negative | Overflow | Carry;
+
+  LazyStatus()
+  {
+    load(Registers().p);
+  }
+
+  void load(uint8_t p)
+  {
+    m_p = p & ~Lazy;
+    m_z = (p & Zero) ? 0 : 1;
+    m_n = p;
+    m_v = p << 1;
+    m_c = p & Carry;
+  }
+
+  uint8_t pack() const
+  {
+    return m_p
+      | m_c
+      | (m_z == 0) << 1
+      | (m_v & 0x80) >> 1
+      | (m_n & 0x80);
+  }
+
+  void set_flag(Status status, bool value)
+  {
+    switch (status)
+    {
+    case Zero:
+      m_z = !value;
+      break;
+    case Negative:
+      m_n = value << 7;
+      break;
+    case Overflow:
+      m_v = value << 7;
+      break;
+    case Carry:
+      m_c = value;
+      break;
+    default:
+      m_p = (m_p & ~status) | (static_cast<int>(value) * status);
+      break;
+    }
+  }
+
+  bool get_flag(Status status) const
+  {
+    switch (status)
+    {
+    case Zero:
+      return m_z == 0;
+    case Negative:
+      return (m_n & 0x80) > 0;
+    case Overflow:
+      return (m_v & 0x80) > 0;
+    case Carry:
+      return m_c > 0;
+    default:
+      return (m_p & status) > 0;
+    }
+  }
+
+  void set_zn(int8_t value)
+  {
+    m_z = value;
+    m_n = value;
+  }
+
+  void set_nv(int8_t value)
+  {
+    m_n = value;
+    m_v = value << 1;
+  }
+
+  //  Same contract as Registers::set_overflow; only the top bit is kept.
+  void set_overflow(int8_t output, int8_t value1, uint8_t value2)
+  {
+    m_v = ~(value1 ^ value2) & (value2 ^ output);
+  }
+};
@@ -0,0 +1,243 @@
+#include "rom_library.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <ostream>
+#include <thread>
+
+#include "cartridge.h"
+#include "crc32.h"
+#include "mapper.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+  bool has_rom_extension(const std::string& name)
+  {
+    if (name.size() < 4)
+    {
+      return false;
+    }
+
+    auto extension = name.substr(name.size() - 4);
+    std::transform(std::begin(extension), std::end(extension), std::begin(extension), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+    return extension == ".nes";
+  }
+
+  //  Depth first with an explicit stack, so deep trees don't recurse. Paths
+  //  use forward slashes everywhere, which Windows accepts too.
+  void walk(const std::string& root, std::vector<std::string>& files)
+  {
+    std::vector<std::string> directories = { root };
+
+    while (!directories.empty())
+    {
+      auto directory = directories.back();
+      directories.pop_back();
+
+#if defined(_WIN32)
+      WIN32_FIND_DATAA entry;
+      auto search = FindFirstFileA((directory + "/*").c_str(), &entry);
+
+      if (search == INVALID_HANDLE_VALUE)
+      {
+        continue;
+      }
+
+      do
+      {
+        std::string name = entry.cFileName;
+
+        if (name == "." || name == "..")
+        {
+          continue;
+        }
+
+        auto path = directory + "/" + name;
+
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+          directories.push_back(path);
+        }
+        else if (has_rom_extension(name))
+        {
+          files.push_back(path);
+        }
+      } while (FindNextFileA(search, &entry));
+
+      FindClose(search);
+#else
+      auto listing = opendir(directory.c_str());
+
+      if (!listing)
+      {
+        continue;
+      }
+
+      while (auto entry = readdir(listing))
+      {
+        std::string name = entry->d_name;
+
+        if (name == "." || name == "..")
+        {
+          continue;
+        }
+
+        auto path = directory + "/" + name;
+        struct stat info;
+
+        if (stat(path.c_str(), &info) != 0)
+        {
+          continue;
+        }
+
+        if (S_ISDIR(info.st_mode))
+        {
+          directories.push_back(path);
+        }
+        else if (S_ISREG(info.st_mode) && has_rom_extension(name))
+        {
+          files.push_back(path);
+        }
+      }
+
+      closedir(listing);
+#endif
+    }
+  }
+
+  const char* timing_name(NESHeader::Timing timing)
+  {
+    switch (timing)
+    {
+    case NESHeader::Timing::PAL:
+      return "pal";
+    case NESHeader::Timing::Multiple:
+      return "multi";
+    case NESHeader::Timing::Dendy:
+      return "dendy";
+    default:
+      return "ntsc";
+    }
+  }
+}
+
+std::vector<std::string> ROMLibrary::find(const std::string& root)
+{
+  std::vector<std::string> files;
+  walk(root, files);
+  std::sort(std::begin(files), std::end(files));
+  return files;
+}
+
+ROMInfo ROMLibrary::inspect(const std::string& path)
+{
+  ROMInfo info;
+  info.path = path;
+
+  try
+  {
+    Cartridge cart(path);
+    const auto& header = cart.header();
+    auto prg = cart.prg_rom();
+    auto chr = cart.chr_rom();
+
+    info.crc = cart.crc();
+    info.prg_crc = crc32(prg.data, prg.size);
+    info.chr_crc = crc32(chr.data, chr.size);
+    info.prg_size = header.prg_rom_size();
+    info.chr_size = header.chr_rom_size();
+    info.mapper = header.mapper();
+    info.submapper = header.submapper();
+    info.nes2 = header.is_nes2();
+    info.battery = header.battery();
+    info.trainer = header.trainer();
+    info.supported = Mapper::supported(header.mapper());
+    info.timing = header.timing();
+  }
+  catch (const std::exception& e)
+  {
+    info.error = e.what();
+
+    if (info.error.empty())
+    {
+      info.error = "Could not load";
+    }
+  }
+
+  return info;
+}
+
+//  Workers take the next file from a shared counter and fill in its slot, so
+//  the results come back in the order of paths without any sorting or locks.
+std::vector<ROMInfo> ROMLibrary::scan(const std::vector<std::string>& paths, unsigned threads)
+{
+  std::vector<ROMInfo> roms(paths.size());
+  std::atomic<size_t> next(0);
+
+  if (threads == 0)
+  {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, paths.size())));
+
+  auto work = [&]
+  {
+    for (auto index = next++; index < paths.size(); index = next++)
+    {
+      roms[index] = inspect(paths[index]);
+    }
+  };
+
+  std::vector<std::thread> workers;
+
+  for (unsigned i = 1; i < threads; ++i)
+  {
+    workers.emplace_back(work);
+  }
+
+  work();
+
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  return roms;
+}
+
+void ROMLibrary::write_index(std::ostream& out, const std::vector<ROMInfo>& roms)
+{
+  char line[128];
+
+  for (const auto& rom : roms)
+  {
+    if (!rom.valid())
+    {
+      auto reason = rom.error;
+      std::replace(std::begin(reason), std::end(reason), '\t', ' ');
+      out << "error\t" << reason << '\t' << rom.path << '\n';
+      continue;
+    }
+
+    std::string flags;
+    flags += rom.battery ? "B" : "";
+    flags += rom.trainer ? "T" : "";
+    flags += rom.supported ? "S" : "";
+
+    snprintf(line, sizeof(line), "%08x\t%08x\t%08x\t%u.%u\t%s\t%u\t%u\t%s\t%s\t",
+      rom.crc, rom.prg_crc, rom.chr_crc, rom.mapper, rom.submapper, rom.nes2 ? "nes2" : "ines",
+      rom.prg_size, rom.chr_size, flags.empty() ? "-" : flags.c_str(), timing_name(rom.timing));
+
+    out << line << rom.path << '\n';
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "nes_header.h"
+
+//  What a ROM file in the library is, as far as can be told without running
+//  it. Files that don't load keep their path and the reason.
+struct ROMInfo
+{
+  std::string path;
+  std::string error;            //  Empty for a valid ROM
+  uint32_t crc = 0;             //  Everything after the header, as Cartridge::crc()
+  uint32_t prg_crc = 0;
+  uint32_t chr_crc = 0;
+  uint32_t prg_size = 0;
+  uint32_t chr_size = 0;
+  uint16_t mapper = 0;
+  uint8_t submapper = 0;
+  bool nes2 = false;
+  bool battery = false;
+  bool trainer = false;
+  bool supported = false;       //  There is a board for the mapper
+  NESHeader::Timing timing = NESHeader::Timing::NTSC;
+
+  inline bool valid() const { return error.empty(); }
+};
+
+//  Builds an index of a directory tree of ROMs. Files are mapped rather than
+//  read and each one is hashed on a pool of threads, so a scan is bound by
+//  the disk or the cores rather than by copying.
+//
+//  The index is a text file with one ROM per line, tab separated, in path
+//  order:
+//
+//    crc prg_crc chr_crc mapper.submapper format prg_size chr_size flags timing path
+//
+//  CRCs are eight hex digits, sizes are bytes, format is "ines" or "nes2" and
+//  flags are any of B (battery), T (trainer) and S (supported mapper), or "-".
+//  Invalid files are written as "error <reason> <path>" lines so they show up
+//  without being picked.
+class ROMLibrary
+{
+public:
+  //  Every file below root with a .nes extension, sorted.
+  static std::vector<std::string> find(const std::string& root);
+
+  static ROMInfo inspect(const std::string& path);
+
+  //  Inspects files on threads workers, or one per core for zero.
+  static std::vector<ROMInfo> scan(const std::vector<std::string>& paths, unsigned threads = 0);
+
+  static void write_index(std::ostream& out, const std::vector<ROMInfo>& roms);
+};
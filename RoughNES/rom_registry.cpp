@@ -0,0 +1,82 @@
+#include "rom_registry.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+  struct Registry
+  {
+    std::mutex lock;
+    std::unordered_multimap<uint32_t, std::weak_ptr<const MappedFile>> images;
+    size_t sweep_at = 64;
+
+    //  Entries of released images are dropped whenever the table has doubled
+    //  since the last sweep, so loading many games doesn't grow it forever.
+    void sweep()
+    {
+      if (images.size() < sweep_at)
+      {
+        return;
+      }
+
+      for (auto entry = std::begin(images); entry != std::end(images);)
+      {
+        entry = entry->second.expired() ? images.erase(entry) : std::next(entry);
+      }
+
+      sweep_at = std::max<size_t>(64, images.size() * 2);
+    }
+  };
+
+  Registry& registry()
+  {
+    static Registry instance;
+    return instance;
+  }
+
+  bool same_contents(const MappedFile& a, const MappedFile& b)
+  {
+    return a.size() == b.size() && std::equal(a.data(), a.data() + a.size(), b.data());
+  }
+}
+
+std::shared_ptr<const MappedFile> ROMRegistry::share(std::shared_ptr<const MappedFile> image, uint32_t crc)
+{
+  auto& registry = ::registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+
+  auto range = registry.images.equal_range(crc);
+
+  for (auto entry = range.first; entry != range.second;)
+  {
+    auto shared = entry->second.lock();
+
+    if (!shared)
+    {
+      entry = registry.images.erase(entry);
+    }
+    else if (same_contents(*shared, *image))
+    {
+      return shared;
+    }
+    else
+    {
+      ++entry;
+    }
+  }
+
+  registry.sweep();
+  registry.images.emplace(crc, image);
+  return image;
+}
+
+size_t ROMRegistry::size()
+{
+  auto& registry = ::registry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+
+  return std::count_if(std::begin(registry.images), std::end(registry.images),
+    [](const std::pair<const uint32_t, std::weak_ptr<const MappedFile>>& entry) { return !entry.second.expired(); });
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "mapped_file.h"
+
+//  Process-wide set of the ROM images in use, keyed by a CRC32 of their
+//  contents. Loading a game that is already running hands back the image the
+//  other consoles use, so any number of them keep one read-only copy and only
+//  carry their own RAM. An image is released with its last cartridge.
+class ROMRegistry
+{
+public:
+  //  Returns the registered image with the same contents, or registers and
+  //  returns this one. Equal hashes are compared byte for byte.
+  static std::shared_ptr<const MappedFile> share(std::shared_ptr<const MappedFile> image, uint32_t crc);
+
+  //  Images currently shared.
+  static size_t size();
+};
@@ -0,0 +1,257 @@
+#include "save_file.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  //  Unit the flusher compares and writes in
+  const size_t FlushPage = 0x100;
+}
+
+//  Writes snapshots of a buffered save from its own thread. Only pages that
+//  differ from what was last written go to the file, and a snapshot that
+//  arrives while one is being written simply replaces the pending one.
+class SaveFile::Flusher
+{
+  std::string m_filename;
+  std::vector<uint8_t> m_pending;
+  std::vector<uint8_t> m_written;
+  bool m_has_pending;
+  bool m_stop;
+
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+  std::thread m_thread;
+
+  void run()
+  {
+    std::vector<uint8_t> contents;
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    while (true)
+    {
+      m_wake.wait(lock, [this] { return m_has_pending || m_stop; });
+
+      if (!m_has_pending)
+      {
+        return;
+      }
+
+      contents.swap(m_pending);
+      m_has_pending = false;
+
+      lock.unlock();
+      write(contents);
+      lock.lock();
+    }
+  }
+
+  void write(const std::vector<uint8_t>& contents)
+  {
+    std::fstream file(m_filename, std::ios::in | std::ios::out | std::ios::binary);
+
+    if (!file)
+    {
+      return;
+    }
+
+    for (size_t offset = 0; offset < contents.size(); offset += FlushPage)
+    {
+      auto length = std::min(FlushPage, contents.size() - offset);
+
+      if (m_written.size() != contents.size() || std::memcmp(&m_written[offset], &contents[offset], length) != 0)
+      {
+        file.seekp(offset);
+        file.write(reinterpret_cast<const char*>(&contents[offset]), length);
+      }
+    }
+
+    //  Once it's with the OS it survives the process going away.
+    file.flush();
+
+    if (file)
+    {
+      m_written = contents;
+    }
+  }
+public:
+  Flusher(std::string filename, std::vector<uint8_t> written) :
+    m_filename(std::move(filename)), m_written(std::move(written)), m_has_pending(false), m_stop(false)
+  {
+    m_thread = std::thread([this] { run(); });
+  }
+
+  //  Writes out whatever is still pending before returning.
+  ~Flusher()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_stop = true;
+    }
+
+    m_wake.notify_one();
+    m_thread.join();
+  }
+
+  void queue(const std::vector<uint8_t>& contents)
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_pending = contents;
+      m_has_pending = true;
+    }
+
+    m_wake.notify_one();
+  }
+};
+
+SaveFile::SaveFile(const std::string& filename, size_t size, bool mapped) : m_data(nullptr), m_size(size), m_view(nullptr)
+{
+  if (mapped && map(filename))
+  {
+    m_data = static_cast<uint8_t*>(m_view);
+    return;
+  }
+
+  read(filename);
+  m_data = m_buffer.data();
+  m_snapshot = m_buffer;
+}
+
+SaveFile::~SaveFile()
+{
+  if (m_view)
+  {
+#if defined(_WIN32)
+    UnmapViewOfFile(m_view);
+#else
+    munmap(m_view, m_size);
+#endif
+  }
+  else
+  {
+    flush();
+  }
+}
+
+//  Grows the file to size if it's shorter, but never shrinks it, so a save
+//  written by an emulator that stores more than the RAM isn't cut short.
+bool SaveFile::map(const std::string& filename)
+{
+#if defined(_WIN32)
+  auto file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    throw std::invalid_argument("Could not open save file");
+  }
+
+  LARGE_INTEGER size;
+
+  if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size))
+  {
+    auto length = std::max<ULONGLONG>(size.QuadPart, m_size);
+    auto mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(length >> 32), static_cast<DWORD>(length), nullptr);
+
+    if (mapping)
+    {
+      m_view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, m_size);
+      CloseHandle(mapping);
+    }
+  }
+
+  CloseHandle(file);
+#else
+  auto file = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+
+  if (file < 0)
+  {
+    throw std::invalid_argument("Could not open save file");
+  }
+
+  struct stat info;
+
+  if (fstat(file, &info) == 0 && S_ISREG(info.st_mode) &&
+      (static_cast<size_t>(info.st_size) >= m_size || ftruncate(file, m_size) == 0))
+  {
+    auto view = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    m_view = view != MAP_FAILED ? view : nullptr;
+  }
+
+  close(file);
+#endif
+
+  return m_view != nullptr;
+}
+
+void SaveFile::read(const std::string& filename)
+{
+  m_buffer.assign(m_size, 0);
+
+  std::vector<uint8_t> written;
+
+  {
+    std::ifstream file(filename, std::ios::binary);
+
+    if (file)
+    {
+      file.read(reinterpret_cast<char*>(m_buffer.data()), m_size);
+
+      //  A short or missing file is written in full the first time.
+      if (static_cast<size_t>(file.gcount()) == m_size)
+      {
+        written = m_buffer;
+      }
+    }
+    else
+    {
+      std::ofstream create(filename, std::ios::binary);
+
+      if (!create)
+      {
+        throw std::invalid_argument("Could not open save file");
+      }
+    }
+  }
+
+  m_flusher.reset(new Flusher(filename, std::move(written)));
+}
+
+std::string SaveFile::path_for(const std::string& rom_filename)
+{
+  auto separator = rom_filename.find_last_of("/\\");
+  auto dot = rom_filename.find_last_of('.');
+
+  if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+  {
+    return rom_filename + ".sav";
+  }
+
+  return rom_filename.substr(0, dot) + ".sav";
+}
+
+void SaveFile::flush()
+{
+  if (!m_flusher || std::equal(std::begin(m_buffer), std::end(m_buffer), std::begin(m_snapshot)))
+  {
+    return;
+  }
+
+  m_snapshot = m_buffer;
+  m_flusher->queue(m_snapshot);
+}
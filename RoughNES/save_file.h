@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//  Battery backed RAM kept in a save file. The file is normally mapped shared,
+//  so writes land straight in the OS's copy of it and reach the disk without
+//  the emulator's help, even if it crashes. Where that isn't possible the RAM
+//  is a buffer and a background thread writes back the pages that changed
+//  whenever flush() hands it a snapshot, so emulation never waits on I/O.
+class SaveFile
+{
+  class Flusher;
+
+  uint8_t* m_data;
+  size_t m_size;
+  void* m_view;                   //  Start of the mapping, null when buffered
+  std::vector<uint8_t> m_buffer;
+  std::vector<uint8_t> m_snapshot;
+  std::unique_ptr<Flusher> m_flusher;
+
+  bool map(const std::string& filename);
+  void read(const std::string& filename);
+public:
+  //  Opens or creates filename, at least size bytes long. New files start
+  //  out zeroed.
+  SaveFile(const std::string& filename, size_t size, bool mapped = true);
+  ~SaveFile();
+
+  SaveFile(const SaveFile&) = delete;
+  SaveFile& operator=(const SaveFile&) = delete;
+
+  //  The save file next to a ROM, with its extension replaced by .sav.
+  static std::string path_for(const std::string& rom_filename);
+
+  inline uint8_t* data() { return m_data; }
+  inline size_t size() const { return m_size; }
+  inline bool mapped() const { return m_view != nullptr; }
+
+  //  Queues the current contents to be written if they changed. Returns
+  //  without waiting; mapped files need nothing.
+  void flush();
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+//  Console events ordered by the CPU cycle they fall due on. Every kind of
+//  event is pending at most once, so the queue is a small table of timestamps
+//  and the earliest one is kept cached for the run loop.
+class Scheduler
+{
+public:
+  enum Event : uint8_t
+  {
+    VBlank,       //  VBlank flag set, NMI if enabled
+    SpriteZero,   //  Sprite 0 hit or overflow flag set
+    MapperIRQ,    //  Cartridge raises IRQ
+    DMA,          //  OAM DMA finished
+    FrameEnd,     //  Status flags cleared on the pre-render scanline
+    None
+  };
+
+  static const uint64_t Never = ~0ull;
+
+  Scheduler()
+  {
+    clear();
+  }
+
+  inline void schedule(Event event, uint64_t cycle)
+  {
+    m_due[event] = cycle;
+    update();
+  }
+
+  inline void cancel(Event event)
+  {
+    schedule(event, Never);
+  }
+
+  //  Cycle of the earliest pending event, or Never.
+  inline uint64_t next() const
+  {
+    return m_next;
+  }
+
+  inline uint64_t due(Event event) const
+  {
+    return m_due[event];
+  }
+
+  //  Removes and returns the earliest event due at or before cycle. Events due
+  //  on the same cycle come out in declaration order.
+  Event pop(uint64_t cycle)
+  {
+    if (m_next > cycle)
+    {
+      return None;
+    }
+
+    auto event = static_cast<Event>(std::min_element(std::begin(m_due), std::end(m_due)) - std::begin(m_due));
+    cancel(event);
+    return event;
+  }
+
+  void clear()
+  {
+    m_due.fill(Never);
+    m_next = Never;
+  }
+
+private:
+  std::array<uint64_t, None> m_due;
+  uint64_t m_next;
+
+  inline void update()
+  {
+    m_next = *std::min_element(std::begin(m_due), std::end(m_due));
+  }
+};
@@ -0,0 +1,220 @@
+#include "tile_decoder.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ROUGHNES_TILES_SIMD
+#endif
+
+#if defined(ROUGHNES_TILES_SIMD)
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ROUGHNES_AVX2_TARGET
+#else
+#include <cpuid.h>
+#define ROUGHNES_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+  //  Each bit of a byte spread out to a byte of its own, leftmost first.
+  std::array<uint64_t, 256> make_spread()
+  {
+    std::array<uint64_t, 256> table;
+
+    for (unsigned value = 0; value < table.size(); ++value)
+    {
+      uint8_t bytes[8];
+
+      for (int column = 0; column < 8; ++column)
+      {
+        bytes[column] = (value >> (7 - column)) & 1;
+      }
+
+      std::memcpy(&table[value], bytes, sizeof(bytes));
+    }
+
+    return table;
+  }
+
+  const std::array<uint64_t, 256> Spread = make_spread();
+
+  //  Both planes and the palette in one 64 bit word. The palette is multiplied
+  //  by a byte per pixel that is 1 where it's opaque, which can't carry.
+  inline void decode_scalar(const uint8_t* low, const uint8_t* high, const uint8_t* palettes, size_t count, uint8_t* pixels)
+  {
+    for (size_t tile = 0; tile < count; ++tile)
+    {
+      auto plane0 = Spread[low[tile]];
+      auto plane1 = Spread[high[tile]];
+      auto row = plane0 | (plane1 << 1) | ((plane0 | plane1) * palettes[tile]);
+
+      std::memcpy(pixels + tile * 8, &row, sizeof(row));
+    }
+  }
+
+#if defined(ROUGHNES_TILES_SIMD)
+  const uint64_t Broadcast = 0x0101010101010101ull;
+
+  bool has_avx2()
+  {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+
+    if (info[0] < 7)
+    {
+      return false;
+    }
+
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x06) == 0x06;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#else
+    unsigned eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0, nullptr) < 7 || !__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 27)))
+    {
+      return false;
+    }
+
+    unsigned xcr0_low, xcr0_high;
+    __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+
+    if ((xcr0_low & 0x06) != 0x06)
+    {
+      return false;
+    }
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1u << 5)) != 0;
+#endif
+  }
+
+  const bool HasAVX2 = has_avx2();
+
+  inline __m128i load_tiles(const uint8_t* bytes)
+  {
+    return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bytes));
+  }
+
+  //  Eight tiles' bytes, each repeated across its tile's eight lanes, two
+  //  tiles to a register.
+  inline void spread_tiles(__m128i bytes, __m128i* spread)
+  {
+    auto pairs = _mm_unpacklo_epi8(bytes, bytes);
+    auto low = _mm_unpacklo_epi16(pairs, pairs);
+    auto high = _mm_unpackhi_epi16(pairs, pairs);
+
+    spread[0] = _mm_unpacklo_epi32(low, low);
+    spread[1] = _mm_unpackhi_epi32(low, low);
+    spread[2] = _mm_unpacklo_epi32(high, high);
+    spread[3] = _mm_unpackhi_epi32(high, high);
+  }
+
+  //  Each lane tests a different bit of its tile's plane bytes.
+  inline __m128i decode_pair(__m128i plane0, __m128i plane1, __m128i palette)
+  {
+    const __m128i bits = _mm_set1_epi64x(0x0102040810204080ll);
+
+    plane0 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(plane0, bits), bits), _mm_set1_epi8(1));
+    plane1 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(plane1, bits), bits), _mm_set1_epi8(2));
+
+    auto row = _mm_or_si128(plane0, plane1);
+    auto transparent = _mm_cmpeq_epi8(row, _mm_setzero_si128());
+    return _mm_or_si128(row, _mm_andnot_si128(transparent, palette));
+  }
+
+  void decode_sse2(const uint8_t* low, const uint8_t* high, const uint8_t* palettes, size_t count, uint8_t* pixels)
+  {
+    size_t tile = 0;
+
+    for (; tile + 8 <= count; tile += 8)
+    {
+      __m128i plane0[4], plane1[4], palette[4];
+      spread_tiles(load_tiles(low + tile), plane0);
+      spread_tiles(load_tiles(high + tile), plane1);
+      spread_tiles(load_tiles(palettes + tile), palette);
+
+      for (int pair = 0; pair < 4; ++pair)
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + (tile + pair * 2) * 8), decode_pair(plane0[pair], plane1[pair], palette[pair]));
+      }
+    }
+
+    decode_scalar(low + tile, high + tile, palettes + tile, count - tile, pixels + tile * 8);
+  }
+
+  //  Eight tiles to a pair of registers, four tiles each. The tiles' bytes are
+  //  broadcast to both halves and shuffled out to the lanes of their tiles.
+  ROUGHNES_AVX2_TARGET inline __m256i decode_quad(__m256i plane0, __m256i plane1, __m256i palette, __m256i spread)
+  {
+    const __m256i bits = _mm256_set1_epi64x(0x0102040810204080ll);
+
+    plane0 = _mm256_shuffle_epi8(plane0, spread);
+    plane1 = _mm256_shuffle_epi8(plane1, spread);
+    palette = _mm256_shuffle_epi8(palette, spread);
+
+    plane0 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(plane0, bits), bits), _mm256_set1_epi8(1));
+    plane1 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(plane1, bits), bits), _mm256_set1_epi8(2));
+
+    auto row = _mm256_or_si256(plane0, plane1);
+    auto transparent = _mm256_cmpeq_epi8(row, _mm256_setzero_si256());
+    return _mm256_or_si256(row, _mm256_andnot_si256(transparent, palette));
+  }
+
+  ROUGHNES_AVX2_TARGET void decode_avx2(const uint8_t* low, const uint8_t* high, const uint8_t* palettes, size_t count, uint8_t* pixels)
+  {
+    const __m256i first = _mm256_setr_epi64x(0x0000000000000000ll, 0x0101010101010101ll, 0x0202020202020202ll, 0x0303030303030303ll);
+    const __m256i second = _mm256_setr_epi64x(0x0404040404040404ll, 0x0505050505050505ll, 0x0606060606060606ll, 0x0707070707070707ll);
+
+    size_t tile = 0;
+
+    for (; tile + 8 <= count; tile += 8)
+    {
+      auto plane0 = _mm256_broadcastq_epi64(load_tiles(low + tile));
+      auto plane1 = _mm256_broadcastq_epi64(load_tiles(high + tile));
+      auto palette = _mm256_broadcastq_epi64(load_tiles(palettes + tile));
+
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + tile * 8), decode_quad(plane0, plane1, palette, first));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + tile * 8 + 32), decode_quad(plane0, plane1, palette, second));
+    }
+
+    decode_scalar(low + tile, high + tile, palettes + tile, count - tile, pixels + tile * 8);
+  }
+#endif
+}
+
+void decode_tile_rows(const uint8_t* low, const uint8_t* high, const uint8_t* palettes, size_t count, uint8_t* pixels)
+{
+#if defined(ROUGHNES_TILES_SIMD)
+  if (HasAVX2)
+  {
+    decode_avx2(low, high, palettes, count, pixels);
+  }
+  else
+  {
+    decode_sse2(low, high, palettes, count, pixels);
+  }
+#else
+  decode_scalar(low, high, palettes, count, pixels);
+#endif
+}
+
+void decode_tile_rows_reference(const uint8_t* low, const uint8_t* high, const uint8_t* palettes, size_t count, uint8_t* pixels)
+{
+  for (size_t tile = 0; tile < count; ++tile)
+  {
+    for (int column = 0; column < 8; ++column)
+    {
+      auto bit = 7 - column;
+      auto pixel = static_cast<uint8_t>(((low[tile] >> bit) & 1) | (((high[tile] >> bit) & 1) << 1));
+      pixels[tile * 8 + column] = pixel ? palettes[tile] | pixel : 0;
+    }
+  }
+}
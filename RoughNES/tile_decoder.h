@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//  Pattern table rows to palette indices. A tile row is a byte from each
+//  bitplane, leftmost pixel in bit 7, and a palette number already shifted
+//  into bits 2-3 (0, 4, 8 or 12). Each tile becomes eight indices into the
+//  background half of palette RAM, and a pixel with both bits clear is 0
+//  whatever its palette, so it shows the backdrop.
+//
+//  Decodes count tiles from the three arrays into 8 * count bytes of pixels.
+//  Uses AVX2 where the processor has it, SSE2 on other x86-64 processors and
+//  a table elsewhere.
+void decode_tile_rows(const uint8_t* low, const uint8_t* high, const uint8_t* palettes, size_t count, uint8_t* pixels);
+
+//  The same a bit at a time, to check and measure the above against.
+void decode_tile_rows_reference(const uint8_t* low, const uint8_t* high, const uint8_t* palettes, size_t count, uint8_t* pixels);